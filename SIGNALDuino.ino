@@ -43,7 +43,12 @@
 #define PROGNAME               " SIGNALduino "
 
 #define BAUDRATE               57600 // 500000 //57600
-#define FIFO_LENGTH			   90 //150
+#define FIFO_LENGTH			   128 // Must be a power of two, max 128 on AVR
+#define FIFO_BATCH			   16  // Number of pulses passed to the decoder at once
+#ifdef TX_QUEUE
+#define TX_QUEUE_SIZE		   128 // Must be a power of two, messages waiting for the UART
+#define TX_DROP_POLICY		   txDropMU // txBlock: wait for the UART, txDropMU: drop MU messages if the queue is full
+#endif
 
 // EEProm Address
 #define EE_MAGIC_OFFSET      0
@@ -67,13 +72,29 @@ size_t writeCallback(const uint8_t *buf, uint8_t len = 1);
 #include "output.h"
 #include "bitstore.h"
 #include "signalDecoder.h"
+#ifndef PULSE_CAPTURE
 #include "TimerOne.h"  // Timer for LED Blinking
+#endif
 #include "commands.h"
 #include "functions.h"
 #include "send.h"
-#include "SimpleFIFO.h"
-SimpleFIFO<int,FIFO_LENGTH> FiFo; //store FIFO_LENGTH # ints
-SignalDetectorClass musterDec;
+#include "SPSCFifo.h"
+#include "receiverChannel.h"
+ReceiverChannel<FIFO_LENGTH, FIFO_BATCH> rxChannel[RECEIVER_CHANNELS]; // pulse timing, FIFO and decoder of every receiver
+SignalDetectorClass &musterDec = rxChannel[0].decoder;
+#ifdef PULSE_CAPTURE
+#include "captureSource.h"
+CaptureSource<ReceiverChannel<FIFO_LENGTH, FIFO_BATCH>> pulseSource(rxChannel[0], PIN_RECEIVE); // edges timestamped by Timer1
+ISR(TIMER1_CAPT_vect) { pulseSource.capture(); }
+ISR(TIMER1_OVF_vect) { cronjob(); } // every 65536 Timer1 ticks: 32.768 ms at 16 MHz, 65.536 ms at 8 MHz
+#else
+#include "pinChangeSource.h"
+PinChangeSource<ReceiverChannel<FIFO_LENGTH, FIFO_BATCH>> pulseSource(rxChannel[0], PIN_RECEIVE, handleInterrupt);
+#endif
+#ifdef TX_QUEUE
+#include "txQueue.h"
+TxQueue<TX_QUEUE_SIZE, decltype(MSG_PRINTER)> txQueue(MSG_PRINTER, TX_DROP_POLICY); // decoded messages waiting for the UART
+#endif
 
 
 #include <EEPROM.h>
@@ -81,9 +102,11 @@ SignalDetectorClass musterDec;
 
 volatile bool blinkLED = false;
 //String cmdstring = "";
-volatile unsigned long lastTime = micros();
 bool hasCC1101 = false;
 char IB_1[14]; // Input Buffer one - capture commands
+#if decoderCounters
+unsigned long maxLoopLatency = 0; // see command c
+#endif
 
 
 
@@ -130,15 +153,20 @@ void setup() {
 	DBG_PRINTLN(F("Starting timerjob"));
 	delay(50);
 
+#ifdef PULSE_CAPTURE
+	pulseSource.startTimer(); // Timer1 laeuft frei, der Ueberlauf ruft cronjob auf
+#else
 	Timer1.initialize(32001); //Interrupt wird jede 32001 Millisekunden ausgeloest
 	Timer1.attachInterrupt(cronjob);
+#endif
 
 	/*MSG_PRINT("MS:"); 	MSG_PRINTLN(musterDec.MSenabled);
 	MSG_PRINT("MU:"); 	MSG_PRINTLN(musterDec.MUenabled);
 	MSG_PRINT("MC:"); 	MSG_PRINTLN(musterDec.MCenabled);*/
 	//cmdstring.reserve(40);
 
-	musterDec.setStreamCallback(&writeCallback);
+	rxChannel[0].begin(0, &writeCallback);
+	rxChannel[0].setSource(&pulseSource);
 
 
 #ifdef CMP_CC1101
@@ -161,20 +189,17 @@ void setup() {
 void cronjob() {
 	static uint8_t cnt = 0;
 	cli();
-	const unsigned long  duration = micros() - lastTime;
+#ifdef PULSE_CAPTURE
+	rxChannel[0].idle(); // Timer1 runs free, cronjob is called on every overflow
+#else
+	const unsigned long  duration = rxChannel[0].idle(); //Auf Maximalwert pruefen.
 
 	Timer1.setPeriod(32001);
 	
-	if (duration >= maxPulse) { //Auf Maximalwert pruefen.
-		int sDuration = maxPulse;
-		if (isLow(PIN_RECEIVE)) { // Wenn jetzt low ist, ist auch weiterhin low
-			sDuration = -sDuration;
-		}
-		FiFo.enqueue(sDuration);
-		lastTime = micros();
-	 } else if (duration > 10000) {
+	if (duration > 10000) {
 		Timer1.setPeriod(maxPulse-duration+16);
 	 }
+#endif
 	 digitalWrite(PIN_LED, blinkLED);
 	 blinkLED = false;
 
@@ -187,17 +212,23 @@ void cronjob() {
 
 
 void loop() {
-	static int aktVal=0;
-	bool state;
+	int16_t found;
+#if decoderCounters
+	measureLoop();
+#endif
 #ifdef __AVR_ATmega32U4__	
 	serialEvent();
 #endif
 	//wdt_reset();
-	while (FiFo.count()>0 ) { //Puffer auslesen und an Dekoder uebergeben
-		aktVal=FiFo.dequeue();
-		state = musterDec.decode(&aktVal); 
-		if (state) blinkLED=true; //LED blinken, wenn Meldung dekodiert
+	while ((found = rxChannel[0].processBatch()) >= 0) { //Puffer auslesen und an Dekoder uebergeben
+		if (found) blinkLED=true; //LED blinken, wenn Meldung dekodiert
+#ifdef TX_QUEUE
+		txQueue.drain(); // Ausgabe nur soweit die UART sie ohne Warten annimmt
+#endif
 	}
+#ifdef TX_QUEUE
+	txQueue.drain();
+#endif
 
  }
 
@@ -209,16 +240,14 @@ void loop() {
 //============================== Write callback =========================================
 size_t writeCallback(const uint8_t *buf, uint8_t len = 1)
 {
+#ifdef TX_QUEUE
+	return txQueue.push(buf, len); // Decoding never waits for the UART, see TX_DROP_POLICY
+#else
 	while (!MSG_PRINTER.availableForWrite() )
 		yield();
-	//DBG_PRINTLN("Called writeCallback");
 
-	//MSG_PRINT(*buf);
-	//MSG_WRITE(buf, len);
 	return MSG_PRINTER.write(buf,len);
-	
-	//serverClient.write("test");
-
+#endif
 }
 
 
@@ -241,6 +270,9 @@ void serialEvent()
 	{
 		if (idx == 14) {
 			// Short buffer is now full
+#ifdef TX_QUEUE
+			txQueue.finishMessage();
+#endif
 			MSG_PRINT("Command to long: ");
 			MSG_PRINTLN(IB_1);
 			idx = 0;
@@ -255,12 +287,18 @@ void serialEvent()
 				case '\0':
 				case '#':
 					//wdt_reset();
+#ifdef TX_QUEUE
+					txQueue.finishMessage(); // Reply must not end up inside a message
+#endif
 					commands::HandleShortCommand();  // Short command received and can be processed now
 					idx = 0;
 					return; //Exit function
 				case ';':
 					DBG_PRINT("send cmd detected ");
 					DBG_PRINTLN(idx);
+#ifdef TX_QUEUE
+					txQueue.finishMessage();
+#endif
 					send_cmd();
 					idx =  0; // increments to 1
 					return; //Exit function
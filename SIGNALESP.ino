@@ -6,7 +6,8 @@
 #define VERSION_1              0x33
 #define VERSION_2              0x1d
 #define BAUDRATE               115200
-#define FIFO_LENGTH			   200
+#define FIFO_LENGTH			   256 // Must be a power of two
+#define FIFO_BATCH			   32  // Number of pulses passed to the decoder at once
 
 #define ETHERNET_PRINT
 #define WIFI_MANAGER_OVERRIDE_STRINGS
@@ -15,6 +16,7 @@
 #define EE_MAGIC_OFFSET      0
 #define addr_features        0xff
 #define MAX_SRV_CLIENTS 2
+#define HUB_BUFFER_SIZE      4096 // Must be a power of two, messages waiting for the network clients
 
 #include "compile_config.h"
 
@@ -27,7 +29,6 @@ inline void ethernetEvent();
 //void getFunctions(bool *ms, bool *mu, bool *mc);
 //void initEEPROM(void);
 uint8_t rssiCallback() { return 0; }; // Dummy return if no rssi value can be retrieved from receiver
-size_t writeCallback(const uint8_t *buf, uint8_t len);
 void ICACHE_RAM_ATTR sosBlink(void *pArg);
 
 #if defined(ESP8266)
@@ -50,33 +51,70 @@ extern "C" {
 
 #include "output.h"
 #include "bitstore.h"  // Die wird aus irgend einem Grund zum Compilieren benoetigt.
-#include "SimpleFIFO.h"
+#include "SPSCFifo.h"
 
 #ifdef CMP_CC1101
 #include "cc1101.h"
 #include <SPI.h>      // prevent travis errors
 #endif
 
-SimpleFIFO<int, FIFO_LENGTH> FiFo; //store FIFO_LENGTH # ints
 #include "signalDecoder.h"
+#include "receiverChannel.h"
+ReceiverChannel<FIFO_LENGTH, FIFO_BATCH> rxChannel[RECEIVER_CHANNELS]; // pulse timing, FIFO and decoder of every receiver
+SignalDetectorClass &musterDec = rxChannel[0].decoder;
+
+// Telnet client with its own command input, fed by the output hub
+struct TcpPort
+{
+	WiFiClient client;
+	char ib[14];		// Command input
+	uint8_t idx;
+
+	bool connected() { return client.connected(); }
+#ifdef ESP8266
+	int availableForWrite() { return client.availableForWrite(); }
+#else
+	int availableForWrite() { return client.connected() ? 1436 : 0; }	// No send buffer query, one TCP segment
+#endif
+	size_t write(const uint8_t *buf, size_t len) { return client.write(buf, len); }
+};
+
+#include "outputHub.h"
+TcpPort tcpClient[MAX_SRV_CLIENTS];
+OutputHub<HUB_BUFFER_SIZE, MAX_SRV_CLIENTS, TcpPort> outputHub; // one buffer for the messages of all clients
+uint8_t commandClient = 0;	// Client which sent the command in IB_1, replies go to serverClient
 #include "commands.h"
 #include "functions.h"
 #include "send.h"
 #include "FastDelegate.h" 
+#ifdef PULSE_CAPTURE
+#include "captureSource.h"
+CaptureSource<ReceiverChannel<FIFO_LENGTH, FIFO_BATCH>> pulseSource[RECEIVER_CHANNELS] = { // pulses measured by the RMT
+	{ rxChannel[0], PIN_RECEIVE, RMT_CHANNEL_0 },
+#if RECEIVER_CHANNELS > 1
+	{ rxChannel[1], PIN_RECEIVE_2, RMT_CHANNEL_4 },
+#endif
+};
+#else
+#include "pinChangeSource.h"
+PinChangeSource<ReceiverChannel<FIFO_LENGTH, FIFO_BATCH>> pulseSource[RECEIVER_CHANNELS] = {
+	{ rxChannel[0], PIN_RECEIVE, handleInterrupt },
+#if RECEIVER_CHANNELS > 1
+	{ rxChannel[1], PIN_RECEIVE_2, handleInterrupt2 },
+#endif
+};
+#endif
 #define WIFI_MANAGER_OVERRIDE_STRINGS
 #include "wifi-config.h"
 #include "WiFiManager.h"          //https://github.com/tzapu/WiFiManager
 
 
 WiFiServer Server(23);  //  port 23 = telnet
-WiFiClient serverClient;
-
-SignalDetectorClass musterDec;
+WiFiClient serverClient;	// Client the command replies (MSG_PRINT) go to
 
 #define pulseMin  90
 volatile bool blinkLED = false;
 String cmdstring = "";
-volatile unsigned long lastTime = micros();
 
 /*
 #define digitalLow(P) digitalWrite(P,LOW)
@@ -98,6 +136,9 @@ os_timer_t blinksos;
 
 bool hasCC1101 = false;
 char IB_1[14]; // Input Buffer one - capture commands
+#if decoderCounters
+unsigned long maxLoopLatency = 0; // see command c
+#endif
 
 
 
@@ -156,6 +197,9 @@ void setup() {
 	Serial.println("\n\n");
 
 	pinMode(PIN_RECEIVE, INPUT);
+#if RECEIVER_CHANNELS > 1
+	pinMode(PIN_RECEIVE_2, INPUT);
+#endif
 	pinMode(PIN_LED, OUTPUT);
   
 	#ifdef CMP_CC1101
@@ -372,7 +416,13 @@ void setup() {
 #endif
 
 
-	musterDec.setStreamCallback(writeCallback);
+	rxChannel[0].begin(0, fastdelegate::MakeDelegate(&outputHub, &decltype(outputHub)::push), RECEIVER_CHANNELS > 1);
+#if RECEIVER_CHANNELS > 1
+	rxChannel[1].begin(1, fastdelegate::MakeDelegate(&outputHub, &decltype(outputHub)::push), true);
+	rxChannel[1].decoder.setRSSICallback(&rssiCallback);
+#endif
+	for (uint8_t c = 0; c < RECEIVER_CHANNELS; c++)
+		rxChannel[c].setSource(&pulseSource[c]);
 #ifdef CMP_CC1101
 	if (!hasCC1101 || cc1101::regCheck()) {
 #endif
@@ -408,7 +458,11 @@ void ICACHE_RAM_ATTR cronjob(void *pArg) {
 	cli();
 	static uint8_t cnt = 0;
 
-	const unsigned long  duration = micros() - lastTime;
+	unsigned long duration = rxChannel[0].idle(); //Auf Maximalwert pruefen.
+#if RECEIVER_CHANNELS > 1
+	const unsigned long duration2 = rxChannel[1].idle();
+	if (duration2 > duration) duration = duration2;	// next run when the first channel reaches maxPulse
+#endif
 #ifdef ESP32
 	esp_timer_stop(cronTimer_handle);
 	esp_timer_start_periodic(cronTimer_handle, (maxPulse - duration + 1000) / 1000);
@@ -418,19 +472,6 @@ void ICACHE_RAM_ATTR cronjob(void *pArg) {
 	os_timer_arm(&cronTimer, (maxPulse - duration + 1000) / 1000, true);
 #endif
 
-
-	if (duration > maxPulse) { //Auf Maximalwert pruefen.
-		int sDuration = maxPulse;
-		if (isLow(PIN_RECEIVE)) { // Wenn jetzt low ist, ist auch weiterhin low
-			sDuration = -sDuration;
-		}
-		FiFo.enqueue(sDuration);
-		lastTime = micros();
-	}
-	else if (duration > 10000) {
-		//os_timer_disarm(&cronTimer);
-		//os_timer_arm(&cronTimer, 20, true);
-	}
 	digitalWrite(PIN_LED, blinkLED);
 	blinkLED = false;
 
@@ -443,145 +484,123 @@ void ICACHE_RAM_ATTR cronjob(void *pArg) {
 
 
 void loop() {
+#if decoderCounters
+	measureLoop();
+#endif
 	wifiManager.process();
 	
-	static int aktVal = 0;
-	bool state;
+	bool busy;
 	serialEvent();
 	ethernetEvent();
 
-	while (FiFo.count()>0) { //Puffer auslesen und an Dekoder uebergeben
-		aktVal = FiFo.dequeue();
-		state = musterDec.decode(&aktVal);
-		if (state) blinkLED = true; //LED blinken, wenn Meldung dekodiert
-		if (FiFo.count()<120) yield();
-	}
-
-}
-
-//============================== Write callback =========================================
-
-#define _USE_WRITE_BUFFER
-
-#ifdef _USE_WRITE_BUFFER
-const size_t writeBufferSize = 128;
-size_t writeBufferCurrent = 0;
-uint8_t writeBuffer[writeBufferSize];
-#endif;
-size_t writeCallback(const uint8_t *buf, uint8_t len = 1)
-{
-#ifdef _USE_WRITE_BUFFER
-	if (!serverClient || !serverClient.connected())
-		return 0;
-
-	size_t result = 0;
-
-	while (len > 0) {
-		size_t copy = (len > writeBufferSize - writeBufferCurrent ? writeBufferSize - writeBufferCurrent : len);
-		if (copy > 0)
-		{
-			memcpy(writeBuffer + writeBufferCurrent, buf, copy);
-			writeBufferCurrent = writeBufferCurrent + copy;
-		}
-		// Buffer full or \n detected - force send
-		if ((len == 1 && *buf == char(0xA)) || (writeBufferCurrent == writeBufferSize))
-		{
-			size_t byteswritten = 0;
-			if (serverClient && serverClient.connected()) {
-				byteswritten = serverClient.write(writeBuffer, writeBufferCurrent);
-			}
-
-			if (byteswritten < writeBufferCurrent) {
-				memmove(writeBuffer, writeBuffer + byteswritten, writeBufferCurrent - byteswritten);
-				writeBufferCurrent -= byteswritten;
-			}
-			else {
-				writeBufferCurrent = 0;
-			}
-			result += byteswritten;
-		}
-		// buffer full
-		len = len - copy;
-		if (len > 0)
-		{
-			memmove((void*)buf, buf + copy, len);
+	outputHub.defaultFormat = musterDec.defaultFormat();
+	for (uint8_t c = 0; c < RECEIVER_CHANNELS; c++)
+		rxChannel[c].decoder.outputFormats = outputHub.formats(); // Jede Meldung in den Formaten aller Clients
+
+	do { //Puffer aller Kanaele abwechselnd auslesen und an Dekoder uebergeben
+		busy = false;
+		bool backlog = false;
+		for (uint8_t c = 0; c < RECEIVER_CHANNELS; c++) {
+			const int16_t found = rxChannel[c].processBatch();
+			if (found < 0) continue;
+			busy = true;
+			if (found) blinkLED = true; //LED blinken, wenn Meldung dekodiert
+			if (rxChannel[c].fifo.count() >= 120) backlog = true;
 		}
-	}
-	return len;
-#else
-
-	while (!serverClient.available()) {
-		yield();
-		if (!serverClient.connected()) return 0;
-	}
-	DBG_PRINTLN("Called writeCallback");
+		outputHub.drain(); // Jeder Client nur soweit er ohne Warten annimmt
+		if (busy && !backlog) yield();
+	} while (busy);
 
-	memccpy()
-
-		return serverClient.write(buf, len);
-	//serverClient.write("test");
-#endif
 }
 
+//============================== Network clients =========================================
 
 inline void ethernetEvent()
 {
+	for (uint8_t i = 0; i < MAX_SRV_CLIENTS; i++) {
+		if (outputHub.isAttached(i) && !tcpClient[i].client.connected()) {
+			outputHub.detach(i);
+			tcpClient[i].client.stop();
+			DBG_PRINT("Client disconnected: ");
+			DBG_PRINTLN(i);
+		}
+	}
 	//check if there are any new clients
 	if (Server.hasClient()) {
-		if (!serverClient || !serverClient.connected()) {
-			if (serverClient) serverClient.stop();
-			serverClient = Server.available();
-			DBG_PRINTLN("New client: ");
-			DBG_PRINTLN(serverClient.remoteIP());
-			return;
+		for (uint8_t i = 0; i < MAX_SRV_CLIENTS; i++) {
+			if (!outputHub.isAttached(i)) {
+				tcpClient[i].client = Server.available();
+				tcpClient[i].idx = 0;
+				outputHub.attach(i, &tcpClient[i]);
+				DBG_PRINTLN("New client: ");
+				DBG_PRINTLN(tcpClient[i].client.remoteIP());
+				return;
+			}
 		}
 		//no free/disconnected spot so reject
-//		WiFiClient newClient = Server.available();
-//		newClient.stop();
+		WiFiClient newClient = Server.available();
+		newClient.stop();
 	}
 	//yield();
 }
 
+// Command of client c is complete: replies go to it and must not end up inside a message
+void selectClient(const uint8_t c)
+{
+	outputHub.finishMessage(c);
+	memcpy(IB_1, tcpClient[c].ib, sizeof(IB_1));
+	serverClient = tcpClient[c].client;
+	commandClient = c;
+}
+
 void serialEvent()
 {
-	static uint8_t idx = 0;
-	while (MSG_PRINTER.available())
+	for (uint8_t c = 0; c < MAX_SRV_CLIENTS; c++)
 	{
-		if (idx == 14) {
-			// Short buffer is now full
-			MSG_PRINT("Command to long: ");
-			MSG_PRINTLN(IB_1);
-			idx = 0;
-			return;
-		}
-		else {
-			IB_1[idx] = (char)MSG_PRINTER.read();
-			switch (IB_1[idx])
-			{
-			case '\n':
-			case '\r':
-			case '\0':
-			case '#':
+		if (!outputHub.isAttached(c))
+			continue;
+		TcpPort &port = tcpClient[c];
+		while (port.client.available())
+		{
+			if (port.idx == 14) {
+				// Short buffer is now full
+				selectClient(c);
+				MSG_PRINT("Command to long: ");
+				MSG_PRINTLN(IB_1);
+				port.idx = 0;
+				return;
+			}
+			else {
+				port.ib[port.idx] = (char)port.client.read();
+				switch (port.ib[port.idx])
+				{
+				case '\n':
+				case '\r':
+				case '\0':
+				case '#':
 #ifdef ESP32
-				esp_task_wdt_reset();
-				yield();
+					esp_task_wdt_reset();
+					yield();
 #elif defined(ESP8266)
-				wdt_reset();
+					wdt_reset();
 #endif
-				commands::HandleShortCommand();  // Short command received and can be processed now
-				idx = 0;
-				return; //Exit function
-			case ';':
-				DBG_PRINT("send cmd detected ");
-				DBG_PRINTLN(idx);
-				IB_1[idx + 1] = '\0';
-				send_cmd();
-				idx = 0; // increments to 1
-				return; //Exit function
+					selectClient(c);
+					commands::HandleShortCommand();  // Short command received and can be processed now
+					port.idx = 0;
+					return; //Exit function
+				case ';':
+					DBG_PRINT("send cmd detected ");
+					DBG_PRINTLN(port.idx);
+					selectClient(c);
+					IB_1[port.idx + 1] = '\0';
+					send_cmd();
+					port.idx = 0; // increments to 1
+					return; //Exit function
+				}
+				port.idx++;
 			}
-			idx++;
+			yield();
 		}
-		yield();
 	}
 }
 
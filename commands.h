@@ -16,11 +16,21 @@
 #include "cc1101.h"
 #include "functions.h"
 #include "signalDecoder.h"
+#include "decoderProfile.h"
 
 extern char IB_1[14];
 extern bool hasCC1101;
-extern SignalDetectorClass musterDec;
+extern SignalDetectorClass &musterDec;
 extern volatile bool blinkLED;
+#ifdef TX_QUEUE
+#include "txQueue.h"
+extern TxQueue<TX_QUEUE_SIZE, decltype(MSG_PRINTER)> txQueue;
+#endif
+#ifdef HUB_BUFFER_SIZE
+#include "outputHub.h"
+extern OutputHub<HUB_BUFFER_SIZE, MAX_SRV_CLIENTS, TcpPort> outputHub;
+extern uint8_t commandClient;
+#endif
 
 
 
@@ -65,7 +75,11 @@ namespace commands {
 		MSG_PRINT(FPSTR(TXT_FSEP)); MSG_PRINT(FPSTR(TXT_MC)); MSG_PRINT(FPSTR(TXT_EQ));
 		MSG_PRINT(musterDec.MCenabled, DEC);
 		MSG_PRINT(FPSTR(TXT_FSEP)); MSG_PRINT("Mred"); MSG_PRINT(FPSTR(TXT_EQ));
-		MSG_PRINTLN(musterDec.MredEnabled, DEC);
+		MSG_PRINT(musterDec.MredEnabled, DEC);
+		MSG_PRINT(FPSTR(TXT_FSEP)); MSG_PRINT("Mbin"); MSG_PRINT(FPSTR(TXT_EQ));
+		MSG_PRINT(musterDec.MbinEnabled, DEC);
+		MSG_PRINT(FPSTR(TXT_FSEP)); MSG_PRINT("Mdedup"); MSG_PRINT(FPSTR(TXT_EQ));
+		MSG_PRINTLN(musterDec.MdedupEnabled, DEC);
 	}
 
 
@@ -87,6 +101,14 @@ namespace commands {
 			case 'R' : //Mreduce
 				bptr = &musterDec.MredEnabled;
 				break;
+			case 'B' : //Mbinary
+				bptr = &musterDec.MbinEnabled;
+				break;
+#if repeatSlots > 0
+			case 'F' : //Mdedup, fold repeats
+				bptr = &musterDec.MdedupEnabled;
+				break;
+#endif
 			default:
 				return;
 		}
@@ -104,8 +126,180 @@ namespace commands {
 		}
 
 
-		storeFunctions(musterDec.MSenabled, musterDec.MUenabled, musterDec.MCenabled, musterDec.MredEnabled);
+		storeFunctions(musterDec.MSenabled, musterDec.MUenabled, musterDec.MCenabled, musterDec.MredEnabled, musterDec.MbinEnabled, musterDec.MdedupEnabled);
+		syncChannelConfig();
+	}
+
+#if decoderCounters
+	/*
+	*	c: counters of every receiver channel and the longest loop latency, cr: resets them after printing,
+	*	cb: binary, MSG_BIN, length of the bytes from type up to the crc, type 'N', number of channels, for every
+	*	channel uint32 pulses, uint16 dropped pulses, uint16 FIFO high watermark, uint32 merged glitches, MS, MU, MC messages,
+	*	processMessage calls, buffer moves, invalid sequence resets, noise gate resets, pulses dropped by them, matches of
+	*	every msFingerprints entry, then uint32 loop latency and the crc16 like the binary messages. All values little endian.
+	*/
+	inline void addCounter(uint8_t *buf, uint8_t &n, uint32_t val, const uint8_t bytes)
+	{
+		for (uint8_t i = 0; i < bytes; i++, val >>= 8)
+			buf[n++] = uint8_t(val);
+	}
+
+	// Counters the receive ISR writes, read with interrupts off so a multi byte value cannot change halfway
+	struct ChannelCounters
+	{
+		uint32_t pulses;
+		uint16_t dropped;
+		uint16_t fifoMax;
+		uint32_t glitches;
+	};
+
+	inline ChannelCounters readChannelCounters(const uint8_t c)
+	{
+		ChannelCounters cc;
+#ifdef __AVR__
+		const uint8_t oldSREG = SREG;
+		cli();
+#endif
+		cc.pulses = rxChannel[c].received();
+		cc.dropped = rxChannel[c].fifo.overflows();
+		cc.fifoMax = rxChannel[c].fifo.highWatermark();
+		cc.glitches = rxChannel[c].glitches;
+#ifdef __AVR__
+		SREG = oldSREG;
+#endif
+		return cc;
+	}
+
+	inline void getCounters()
+	{
+		if (IB_1[1] == 'b') {
+			uint8_t buf[4 + 2 + RECEIVER_CHANNELS * (44 + msFingerprintCount * 4) + 4];
+			uint8_t n = 0;
+			buf[n++] = MSG_BIN;
+			buf[n++] = sizeof(buf) - 4;
+			buf[n++] = 'N';
+			buf[n++] = RECEIVER_CHANNELS;
+			for (uint8_t c = 0; c < RECEIVER_CHANNELS; c++) {
+				const DecoderCounters &dc = rxChannel[c].decoder.counters;
+				const ChannelCounters cc = readChannelCounters(c);
+				addCounter(buf, n, cc.pulses, 4);
+				addCounter(buf, n, cc.dropped, 2);
+				addCounter(buf, n, cc.fifoMax, 2);
+				addCounter(buf, n, cc.glitches, 4);
+				addCounter(buf, n, dc.msMsgs, 4);
+				addCounter(buf, n, dc.muMsgs, 4);
+				addCounter(buf, n, dc.mcMsgs, 4);
+				addCounter(buf, n, dc.processCalls, 4);
+				addCounter(buf, n, dc.moves, 4);
+				addCounter(buf, n, dc.invalidResets, 4);
+				addCounter(buf, n, dc.noiseResets, 4);
+				addCounter(buf, n, dc.noisePulses, 4);
+				for (uint8_t f = 0; f < msFingerprintCount; f++)
+					addCounter(buf, n, dc.fingerprints[f], 4);
+			}
+			addCounter(buf, n, maxLoopLatency, 4);
+			uint16_t crc = 0xFFFF;
+			for (uint8_t i = 1; i < n; i++)
+				crc = crc16(crc, buf[i]);
+			buf[n++] = highByte(crc);
+			buf[n++] = lowByte(crc);
+			MSG_WRITE(buf, n);
+		}
+		else {
+			for (uint8_t c = 0; c < RECEIVER_CHANNELS; c++) {
+				const DecoderCounters &dc = rxChannel[c].decoder.counters;
+				const ChannelCounters cc = readChannelCounters(c);
+				MSG_PRINT(F("CH=")); MSG_PRINT(c);
+				MSG_PRINT(FPSTR(TXT_FSEP)); MSG_PRINT(F("pulses=")); MSG_PRINT(cc.pulses);
+				MSG_PRINT(FPSTR(TXT_FSEP)); MSG_PRINT(F("dropped=")); MSG_PRINT(cc.dropped);
+				MSG_PRINT(FPSTR(TXT_FSEP)); MSG_PRINT(F("fifoMax=")); MSG_PRINT(cc.fifoMax);
+				MSG_PRINT(FPSTR(TXT_FSEP)); MSG_PRINT(F("glitches=")); MSG_PRINT(cc.glitches);
+				MSG_PRINT(FPSTR(TXT_FSEP)); MSG_PRINT(FPSTR(TXT_MS)); MSG_PRINT(FPSTR(TXT_EQ)); MSG_PRINT(dc.msMsgs);
+				MSG_PRINT(FPSTR(TXT_FSEP)); MSG_PRINT(FPSTR(TXT_MU)); MSG_PRINT(FPSTR(TXT_EQ)); MSG_PRINT(dc.muMsgs);
+				MSG_PRINT(FPSTR(TXT_FSEP)); MSG_PRINT(FPSTR(TXT_MC)); MSG_PRINT(FPSTR(TXT_EQ)); MSG_PRINT(dc.mcMsgs);
+				MSG_PRINT(FPSTR(TXT_FSEP)); MSG_PRINT(F("process=")); MSG_PRINT(dc.processCalls);
+				MSG_PRINT(FPSTR(TXT_FSEP)); MSG_PRINT(F("moves=")); MSG_PRINT(dc.moves);
+				MSG_PRINT(FPSTR(TXT_FSEP)); MSG_PRINT(F("invalid=")); MSG_PRINT(dc.invalidResets);
+				MSG_PRINT(FPSTR(TXT_FSEP)); MSG_PRINT(F("noise=")); MSG_PRINT(dc.noiseResets);
+				MSG_PRINT(FPSTR(TXT_FSEP)); MSG_PRINT(F("noisePulses=")); MSG_PRINT(dc.noisePulses);
+				MSG_PRINT(FPSTR(TXT_FSEP)); MSG_PRINT(F("fp="));
+				for (uint8_t f = 0; f < msFingerprintCount; f++) {
+					if (f > 0) MSG_PRINT(",");
+					MSG_PRINT(dc.fingerprints[f]);
+				}
+				MSG_PRINT(FPSTR(TXT_FSEP));
+			}
+			MSG_PRINT(F("loopMax=")); MSG_PRINTLN(maxLoopLatency);
+		}
+		if (IB_1[1] == 'r' || IB_1[2] == 'r') {		// cr, cbr reset the counters after printing them
+#ifdef __AVR__
+			const uint8_t oldSREG = SREG;
+			cli();
+#endif
+			for (uint8_t c = 0; c < RECEIVER_CHANNELS; c++)
+				rxChannel[c].resetCounters();
+#ifdef __AVR__
+			SREG = oldSREG;
+#endif
+			maxLoopLatency = 0;
+		}
+	}
+#endif
+
+#ifdef PROFILE
+	inline size_t profileWrite(const uint8_t *buf, uint8_t len)
+	{
+		MSG_WRITE(buf, len);
+		return len;
+	}
+
+	// p: stage profiler table of the decoders, pr resets it after printing
+	inline void getProfile()
+	{
+		DecoderProfile::dump(&profileWrite);
+		if (IB_1[1] == 'r')
+			DecoderProfile::clear();
+	}
+#endif
+
+#ifdef TX_QUEUE
+	inline void getTxQueue()
+	{
+		MSG_PRINT(F("queued=")); MSG_PRINT(txQueue.queuedBytes);
+		MSG_PRINT(FPSTR(TXT_FSEP)); MSG_PRINT(F("dropped=")); MSG_PRINT(txQueue.droppedBytes);
+		MSG_PRINT(FPSTR(TXT_FSEP)); MSG_PRINT(F("droppedMsg=")); MSG_PRINT(txQueue.droppedMsgs);
+		MSG_PRINT(FPSTR(TXT_FSEP)); MSG_PRINT(F("stalls=")); MSG_PRINT(txQueue.stalls);
+		MSG_PRINT(FPSTR(TXT_FSEP)); MSG_PRINT(F("max=")); MSG_PRINT(txQueue.maxCount);
+		MSG_PRINT(FPSTR(TXT_FSEP)); MSG_PRINT(F("size=")); MSG_PRINTLN(TX_QUEUE_SIZE);
+		if (IB_1[1] == 'r')		// qr resets the counters after printing them
+			txQueue.resetCounters();
 	}
+#endif
+
+#ifdef HUB_BUFFER_SIZE
+	// COV, COR, COB: verbose, reduced or binary output for the client which sent the command, COA: like CE / CD
+	inline void configFormat()
+	{
+		switch (IB_1[2])
+		{
+			case 'V':
+				outputHub.setFormat(commandClient, fmtVerbose);
+				break;
+			case 'R':
+				outputHub.setFormat(commandClient, fmtReduced);
+				break;
+			case 'B':
+				outputHub.setFormat(commandClient, fmtBinary);
+				break;
+			case 'A':
+				outputHub.setFormat(commandClient, fmtAuto);
+				break;
+		}
+		const uint8_t format = outputHub.getFormat(commandClient);
+		MSG_PRINT(F("CO=")); MSG_PRINT(format == fmtAuto ? 'A' : "VRB"[format]);
+		MSG_PRINT(FPSTR(TXT_FSEP)); MSG_PRINT(F("dropped=")); MSG_PRINTLN(outputHub.dropped(commandClient));
+	}
+#endif
 
 	inline void configSET()
 	{
@@ -113,6 +307,7 @@ namespace commands {
 		if (strstr(&IB_1[2],"mcmbl=") != NULL)   // mc min bit len
 		{
 			musterDec.mcMinBitLen = strtol(&IB_1[8], NULL,10);
+			syncChannelConfig();
 			MSG_PRINT(musterDec.mcMinBitLen); MSG_PRINT(" bits set");
 		}
 	}
@@ -134,6 +329,9 @@ namespace commands {
 		#define  cmd_space ' '
 		#define  cmd_send 'S'
 		#define  cmd_status 's'
+		#define  cmd_txQueue 'q'    // output queue counters, qr resets them
+		#define  cmd_counters 'c'   // receiver and decoder counters, cr resets them, cb binary
+		#define  cmd_profile 'p'    // stage profiler (build flag PROFILE), pr resets it
 
 		switch (IB_1[0])
 		{
@@ -149,6 +347,15 @@ namespace commands {
 			MSG_PRINT(cmd_read); MSG_PRINT(FPSTR(TXT_BLANK));
 			MSG_PRINT(cmd_write); MSG_PRINT(FPSTR(TXT_BLANK));
 			MSG_PRINT(cmd_status); MSG_PRINT(FPSTR(TXT_BLANK));
+#if decoderCounters
+			MSG_PRINT(cmd_counters); MSG_PRINT(FPSTR(TXT_BLANK));
+#endif
+#ifdef PROFILE
+			MSG_PRINT(cmd_profile); MSG_PRINT(FPSTR(TXT_BLANK));
+#endif
+#ifdef TX_QUEUE
+			MSG_PRINT(cmd_txQueue); MSG_PRINT(FPSTR(TXT_BLANK));
+#endif
 #ifdef CMP_CC1101
 			if (hasCC1101) {
 				MSG_PRINT(cmd_patable); MSG_PRINT(FPSTR(TXT_BLANK));
@@ -210,6 +417,21 @@ namespace commands {
 		case cmd_changeReceiver:
 			changeReceiver();
 			break;
+#ifdef TX_QUEUE
+		case cmd_txQueue:
+			getTxQueue();
+			break;
+#endif
+#if decoderCounters
+		case cmd_counters:
+			getCounters();
+			break;
+#endif
+#ifdef PROFILE
+		case cmd_profile:
+			getProfile();
+			break;
+#endif
 		case cmd_config:
 			switch (IB_1[1])
 			{
@@ -223,6 +445,11 @@ namespace commands {
 				case 'S':
 					configSET();
 					break;
+#ifdef HUB_BUFFER_SIZE
+				case 'O':
+					configFormat();
+					break;
+#endif
 	#ifdef CMP_CC1101
 				default:
 					if (isxdigit(IB_1[1]) && isxdigit(IB_1[2]) && hasCC1101) {
@@ -8,9 +8,24 @@
 //#define OTHER_BOARD_WITH_CC1101  1
 
 
+// Second receiver (e.g. 868 MHz next to 433 MHz) with demodulated data on its own pin, ESP32 only.
+// Messages of both receivers get a CH=0; / CH=1; field
+//#define PIN_RECEIVE_2          4
+
+// Queue decoded messages for the UART instead of waiting for it, see command q.
+// Needs about 160 bytes of RAM, so it is off by default on the 328p
+//#define TX_QUEUE
+
+// Edges timestamped by the timer hardware instead of the pin change interrupt with micros() (pulseSource.h):
+// AVR: Timer1 input capture, the receiver must be wired to the ICP1 pin (D8, D4 on the ATmega32U4). ESP32: RMT receiver
+//#define PULSE_CAPTURE
+
 //Enable debug option here:
 //#define DEBUG
 
+// Stage profiler of the decoder (command p) is a build flag, it must be set for all sources incl. the libraries:
+// -DPROFILE, e.g. in compiler.cpp.extra_flags
+
 
 
 
@@ -41,6 +56,16 @@
 
 #endif
 
+#if defined(PIN_RECEIVE_2) && defined(ESP32)
+#define RECEIVER_CHANNELS      2
+#else
+#define RECEIVER_CHANNELS      1
+#endif
+
+#if defined(PULSE_CAPTURE) && defined(ESP8266)
+#error "PULSE_CAPTURE: the ESP8266 has no capture hardware"
+#endif
+
 #ifdef CMP_CC1101
 	#ifdef ARDUINO_RADINOCC1101
 		#define PIN_LED               13
@@ -77,6 +102,13 @@
 	#endif
 #endif
 
-
-
-
+#if defined(PULSE_CAPTURE) && defined(__AVR__)
+	#undef PIN_RECEIVE
+	#ifdef ARDUINO_RADINOCC1101
+		#error "PULSE_CAPTURE: the receiver of the radino is not wired to ICP1"
+	#elif defined(__AVR_ATmega32U4__)
+		#define PIN_RECEIVE           4 // ICP1
+	#else
+		#define PIN_RECEIVE           8 // ICP1
+	#endif
+#endif
@@ -12,13 +12,16 @@
 #include "compile_config.h"
 #include <EEPROM.h>
 #include "output.h"
-#include "SimpleFIFO.h"
+#include "SPSCFifo.h"
+#include "receiverChannel.h"
 #include "cc1101.h"
 
-extern volatile unsigned long lastTime;
-extern SimpleFIFO<int, FIFO_LENGTH> FiFo; //store FIFO_LENGTH # ints
-extern SignalDetectorClass musterDec;
+extern ReceiverChannel<FIFO_LENGTH, FIFO_BATCH> rxChannel[RECEIVER_CHANNELS];
+extern SignalDetectorClass &musterDec;	// decoder of the first channel
 extern bool hasCC1101;
+#if decoderCounters
+extern unsigned long maxLoopLatency;
+#endif
 
 #define pulseMin  90
 
@@ -32,62 +35,85 @@ extern os_timer_t cronTimer;
 
 
 //========================= Pulseauswertung ================================================
+// Receive ISR of the pin change source (PinChangeSource), with PULSE_CAPTURE the timer captures the edges
 void ICACHE_RAM_ATTR handleInterrupt() {
 
 	cli();
-	const unsigned long Time = micros();
-	const unsigned long  duration = Time - lastTime;
-	lastTime = Time;
-	if (duration >= pulseMin) {//kleinste zulaessige Pulslaenge
-		int sDuration;
-		if (duration < maxPulse) {//groesste zulaessige Pulslaenge, max = 32000
-			sDuration = int(duration); //das wirft bereits hier unnoetige Nullen raus und vergroessert den Wertebereich
-		}
-		else {
-			sDuration = maxPulse; // Maximalwert set to maxPulse defined in lib.
-		}
-		if (isHigh(PIN_RECEIVE)) { // Wenn jetzt high ist, dann muss vorher low gewesen sein, und dafuer gilt die gemessene Dauer.
-			sDuration = -sDuration;
-		}
-		FiFo.enqueue(sDuration);
-	} // else => trash
+	rxChannel[0].edge(micros(), isHigh(PIN_RECEIVE));
+	sei();
+}
+
+#if RECEIVER_CHANNELS > 1
+void ICACHE_RAM_ATTR handleInterrupt2() {
+
+	cli();
+	rxChannel[1].edge(micros(), isHigh(PIN_RECEIVE_2));
 	sei();
 }
+#endif
+
+// The decoder settings are stored once and used by all channels
+void syncChannelConfig() {
+	for (uint8_t c = 1; c < RECEIVER_CHANNELS; c++) {
+		rxChannel[c].decoder.MSenabled = musterDec.MSenabled;
+		rxChannel[c].decoder.MUenabled = musterDec.MUenabled;
+		rxChannel[c].decoder.MCenabled = musterDec.MCenabled;
+		rxChannel[c].decoder.MredEnabled = musterDec.MredEnabled;
+		rxChannel[c].decoder.MbinEnabled = musterDec.MbinEnabled;
+		rxChannel[c].decoder.MdedupEnabled = musterDec.MdedupEnabled;
+		rxChannel[c].decoder.mcMinBitLen = musterDec.mcMinBitLen;
+	}
+}
 
+// Longest time between two passes of loop() in us, pulses may wait that long in the FIFO. Call at the start of loop()
+#if decoderCounters
+void measureLoop() {
+	static unsigned long lastLoop = micros();
+	const unsigned long now = micros();
+	if (now - lastLoop > maxLoopLatency)
+		maxLoopLatency = now - lastLoop;
+	lastLoop = now;
+}
+#endif
 
 void enableReceive() {
-	attachInterrupt(digitalPinToInterrupt(PIN_RECEIVE), handleInterrupt, CHANGE);
+	for (uint8_t c = 0; c < RECEIVER_CHANNELS; c++)
+		rxChannel[c].enable();
 #ifdef CMP_CC1101
 	if (hasCC1101) cc1101::setReceiveMode();
 #endif
 }
 
 void disableReceive() {
-	detachInterrupt(digitalPinToInterrupt(PIN_RECEIVE));
+	for (uint8_t c = 0; c < RECEIVER_CHANNELS; c++)
+		rxChannel[c].disable();
 
 #ifdef CMP_CC1101
 	if (hasCC1101) cc1101::setIdleMode();
 #endif
-	FiFo.flush();
+	for (uint8_t c = 0; c < RECEIVER_CHANNELS; c++)
+		rxChannel[c].fifo.flush();
 
 }
 
 //================================= EEProm commands ======================================
 
-void storeFunctions(const int8_t ms, int8_t mu, int8_t mc, int8_t red)
+void storeFunctions(const int8_t ms, int8_t mu, int8_t mc, int8_t red, int8_t bin, int8_t dedup)
 {
 	mu = mu << 1;
 	mc = mc << 2;
 	red = red << 3;
+	bin = bin << 4;
+	dedup = dedup << 5;
 
-	int8_t dat = ms | mu | mc | red;
+	int8_t dat = ms | mu | mc | red | bin | dedup;
 	EEPROM.write(addr_features, dat);
 	#ifdef ESP8266
 	EEPROM.commit();
 	#endif
 }
 
-void getFunctions(bool *ms, bool *mu, bool *mc, bool *red)
+void getFunctions(bool *ms, bool *mu, bool *mc, bool *red, bool *bin, bool *dedup)
 {
 	int8_t dat = EEPROM.read(addr_features);
 
@@ -95,6 +121,8 @@ void getFunctions(bool *ms, bool *mu, bool *mc, bool *red)
 	*mu = bool(dat &(1 << 1));
 	*mc = bool(dat &(1 << 2));
 	*red = bool(dat &(1 << 3));
+	*bin = bool(dat &(1 << 4));
+	*dedup = bool(dat &(1 << 5));
 
 
 }
@@ -123,7 +151,7 @@ void initEEPROM(void) {
 		DBG_PRINT(F("Reading values from "));	DBG_PRINT(FPSTR(TXT_EEPROM)); DBG_PRINT(FPSTR(TXT_DOT)); DBG_PRINT(FPSTR(TXT_DOT));
 	}
 	else {
-		storeFunctions(1, 1, 1, 1);    // Init EEPROM with all flags enabled
+		storeFunctions(1, 1, 1, 1, 0, 0);    // Init EEPROM with all flags enabled, text output, every repeat
 		//hier fehlt evtl ein getFunctions()
 		MSG_PRINTLN(F("Init eeprom to defaults after flash"));
 		EEPROM.write(EE_MAGIC_OFFSET, VERSION_1);
@@ -135,7 +163,8 @@ void initEEPROM(void) {
 		EEPROM.commit();
 #endif
 	}
-	getFunctions(&musterDec.MSenabled, &musterDec.MUenabled, &musterDec.MCenabled, &musterDec.MredEnabled);
+	getFunctions(&musterDec.MSenabled, &musterDec.MUenabled, &musterDec.MCenabled, &musterDec.MredEnabled, &musterDec.MbinEnabled, &musterDec.MdedupEnabled);
+	syncChannelConfig();
 	DBG_PRINTLN(F("done"));
 	dumpEEPROM();
 }
@@ -303,8 +303,8 @@ void send_cmd()
 	}
 	DBG_PRINT(IB_1);
 	MSG_PRINTLN(buf); // echo data of command
-	musterDec.reset();
-	FiFo.flush();
+	for (uint8_t c = 0; c < RECEIVER_CHANNELS; c++)
+		rxChannel[c].reset();
 	enableReceive();	// enable the receiver
 }
 
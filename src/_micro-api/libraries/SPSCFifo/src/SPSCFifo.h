@@ -0,0 +1,123 @@
+/*
+*   Lock free single producer / single consumer ring buffer
+*   Copyright (C) 2026  SIGNALduino contributors
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SPSCFIFO_H
+#define SPSCFIFO_H
+
+#include "Arduino.h"
+
+/*
+*	The producer (receive ISR) only writes head, the consumer (loop) only writes tail.
+*	Both indices run freely and are masked on access, so there is no shared counter and the consumer needs no cli() / sei().
+*	Indices must be read and written atomically: uint8_t on AVR (fifoSize <= 128), uint16_t is fine on 32 bit targets.
+*/
+
+#if defined(ESP32)
+#define SPSC_BARRIER() __sync_synchronize()						// ISR and loop may run on different cores
+#elif defined(_MSC_VER)
+#include <intrin.h>
+#define SPSC_BARRIER() _ReadWriteBarrier()
+#else
+#define SPSC_BARRIER() __asm__ __volatile__("" ::: "memory")	// Single core, keep the compiler from reordering
+#endif
+
+template<uint16_t fifoSize, bool small = (fifoSize <= 128)>
+struct SPSCFifoIndex { typedef uint16_t type; };
+
+template<uint16_t fifoSize>
+struct SPSCFifoIndex<fifoSize, true> { typedef uint8_t type; };
+
+
+template<typename T, uint16_t fifoSize, typename IndexT = typename SPSCFifoIndex<fifoSize>::type>
+class SPSCFifo
+{
+	static_assert(fifoSize > 0 && (fifoSize & (fifoSize - 1)) == 0, "fifoSize must be a power of two");
+	static_assert(fifoSize <= (IndexT(~IndexT(0)) / 2 + 1), "IndexT is too small for fifoSize");
+
+public:
+	SPSCFifo() { flush(); resetCounters(); }
+
+	// Producer side
+	inline bool enqueue(const T element);
+
+	// Consumer side
+	inline T dequeue();									// Caller must check count() before
+	inline IndexT dequeue(T *out, IndexT n);			// Copies up to n elements, returns number of copied elements
+	inline T peek() const { return raw[tail & mask]; }
+	inline IndexT count() const { return IndexT(head - tail); }
+	inline bool isEmpty() const { return head == tail; }
+	void flush() { tail = head; }						// Drops all pending elements, safe while the producer is running
+
+	// Statistics, written by the producer
+	uint16_t overflows() const { return overflowCnt; }
+	IndexT highWatermark() const { return maxCount; }
+	void resetCounters() { overflowCnt = 0; maxCount = 0; }
+
+private:
+	static const IndexT mask = fifoSize - 1;
+
+	T raw[fifoSize];
+	volatile IndexT head;		// Next write position, owned by the producer
+	volatile IndexT tail;		// Next read position, owned by the consumer
+	volatile uint16_t overflowCnt;
+	volatile IndexT maxCount;
+};
+
+
+template<typename T, uint16_t fifoSize, typename IndexT>
+bool SPSCFifo<T, fifoSize, IndexT>::enqueue(const T element)
+{
+	const IndexT h = head;
+	const IndexT used = IndexT(h - tail);
+	if (used >= fifoSize) {
+		overflowCnt++;
+		return false;
+	}
+	raw[h & mask] = element;
+	SPSC_BARRIER();			// Element must be stored before it is published
+	head = IndexT(h + 1);
+	if (used >= maxCount) maxCount = IndexT(used + 1);
+	return true;
+}
+
+template<typename T, uint16_t fifoSize, typename IndexT>
+T SPSCFifo<T, fifoSize, IndexT>::dequeue()
+{
+	const IndexT t = tail;
+	SPSC_BARRIER();
+	const T element = raw[t & mask];
+	SPSC_BARRIER();			// Element must be read before the slot is released
+	tail = IndexT(t + 1);
+	return element;
+}
+
+template<typename T, uint16_t fifoSize, typename IndexT>
+IndexT SPSCFifo<T, fifoSize, IndexT>::dequeue(T *out, IndexT n)
+{
+	const IndexT t = tail;
+	const IndexT available = IndexT(head - t);
+	SPSC_BARRIER();			// Read head before the elements it publishes
+	if (n > available) n = available;
+	for (IndexT i = 0; i < n; i++)
+		out[i] = raw[IndexT(t + i) & mask];
+	SPSC_BARRIER();
+	tail = IndexT(t + n);
+	return n;
+}
+
+#endif // SPSCFIFO_H
@@ -1,7 +0,0 @@
-// 
-// 
-// 
-
-#include "SimpleFIFO.h"
-
-
@@ -22,342 +22,418 @@
 #include "Arduino.h"
 
 
+/*
+*   Forward iterator over the values of a BitStore or RingBitStore
+*/
+template<class Store>
+class BitStoreIterator
+{
+public:
+	BitStoreIterator(const Store *store, const uint16_t pos) : store(store), pos(pos) {}
+
+	uint8_t operator*() const { return store->getValue(pos); }
+	BitStoreIterator &operator++() { ++pos; return *this; }
+	bool operator!=(const BitStoreIterator &other) const { return pos != other.pos; }
+	bool operator==(const BitStoreIterator &other) const { return pos == other.pos; }
+	uint16_t position() const { return pos; }
+
+private:
+	const Store *store;
+	uint16_t pos;
+};
+
+
+/*
+*   Type of a byte index into a datastore of bufSize bytes, uint8_t as long as an index plus the ring start fits
+*/
+template<bool wide>
+struct BitStoreIndex { typedef uint8_t type; };
+template<>
+struct BitStoreIndex<true> { typedef uint16_t type; };
+
+
+/*
+*   Replaces every value packed into byte b by map[value]
+*/
+template<uint8_t bitsPerValue>
+inline uint8_t bitStoreRemapByte(const uint8_t b, const uint8_t *map)
+{
+	if (bitsPerValue == 4)
+		return (map[b >> 4] << 4) | (map[b & 0xF] & 0xF);
+
+	const uint8_t vmask = (1 << bitsPerValue) - 1;
+	uint8_t r = 0;
+	for (uint8_t shift = 0; shift < 8; shift += bitsPerValue)
+		r |= (map[(b >> shift) & vmask] & vmask) << shift;
+	return r;
+}
 
-template<uint8_t bufSize>
+/*
+*   Stores values of bitsPerValue bits, (8 / bitsPerValue) values in one byte, the first value in the upper bits.
+*   The width is a template parameter, so all masks and shifts are constants, 1, 2 and 4 bit accesses compile
+*   down to a shift and a mask.
+*/
+template<uint16_t bufSize, uint8_t bitsPerValue>
 class BitStore
 {
 public:
-	/** Default constructor */
-	BitStore(uint8_t bitlength);
-	//~BitStore();
+	static constexpr uint8_t valuelen = bitsPerValue;						// Number of bits for every value
+	static constexpr uint8_t valuesPerByte = 8 / bitsPerValue;
+	static constexpr uint8_t vmask = (1 << bitsPerValue) - 1;				// Mask for one value, right aligned
+	static constexpr uint16_t capacity = uint16_t(bufSize) * valuesPerByte;	// Number of values which fit into datastore
+	static_assert(bitsPerValue == 1 || bitsPerValue == 2 || bitsPerValue == 4, "bitsPerValue must be 1, 2 or 4");
+	static_assert(capacity <= 0x7FFF, "valcount is an int16_t");
+
+	typedef typename BitStoreIndex<(bufSize > 127)>::type byteidx_t;
+	typedef BitStoreIterator<BitStore> const_iterator;
+
+	BitStore() { reset(); }
 	bool addValue(byte value);
-	int8_t getValue(const uint16_t pos);
+	uint16_t addValues(const uint8_t *values, const uint16_t count);
+	int8_t getValue(const uint16_t pos) const;
+	uint16_t getValues(const uint16_t pos, uint8_t *dest, const uint16_t count) const;
 	bool moveLeft(const uint16_t begin);
 	bool changeValue(const uint16_t pos, byte value);
+	void remapValues(const uint8_t *map);	// Replaces every value v by map[v], map needs (1 << bitsPerValue) entries
 
-	const uint16_t getSize();
-	//unsigned char *datastore;  // Reserve 40 Bytes for our store. Should be edited to aa dynamic way
+	const uint16_t getSize() const { return valcount; }
 	unsigned char datastore[bufSize];
 	void reset();
-	bool getByte(const uint8_t idx, uint8_t *retvalue);
-	uint8_t bytecount;  // Number of stored bytes
+	bool getByte(const byteidx_t idx, uint8_t *retvalue) const;
+	byteidx_t bytecount;  // Index of the last used byte
 	int16_t valcount;  // Number of total values stored
 
-	int8_t operator[](const uint16_t pos) {
-		getValue(pos);
-		return _rval;
+	int8_t operator[](const uint16_t pos) const {
+		return getValue(pos);
 	}
 	BitStore &operator+=(const byte value) {
 		addValue(value);
 		return *this;
 	}
-
-
+	const_iterator begin() const { return const_iterator(this, 0); }
+	const_iterator end() const { return const_iterator(this, valcount); }
 
 #ifndef UNITTEST
 protected:
 
 private:
 #endif
-	uint8_t valuelen;   // Number of bits for every value
-	uint8_t bmask;
-	uint8_t bcnt;
-	const uint8_t buffsize;
-	byte _rval;
+	// Shift of the value at pos inside of its byte
+	static uint8_t shiftOf(const uint16_t pos) { return (valuesPerByte - 1 - pos % valuesPerByte) * bitsPerValue; }
 };
 
 
 /*
-*   Library for storing and retrieving multibple bits in one byte
-*   Copyright (C) 2014  S.Butzek
-*
-*   This program is free software: you can redistribute it and/or modify
-*   it under the terms of the GNU General Public License as published by
-*   the Free Software Foundation, either version 3 of the License, or
-*   (at your option) any later version.
+*   Ring addressed variant of BitStore
 *
-*   This program is distributed in the hope that it will be useful,
-*   but WITHOUT ANY WARRANTY; without even the implied warranty of
-*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
-*   GNU General Public License for more details.
-*
-*   You should have received a copy of the GNU General Public License
-*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*   Values are addressed relative to a logical start position inside of datastore, so removing values
+*   from the front (moveLeft) only moves the start position instead of shifting the whole buffer.
+*   getValue, changeValue and getByte use logical positions, getByte combines two bytes if the logical
+*   start is not byte aligned or a byte wraps around the buffer end.
 */
-
-template<uint8_t bufSize>
-BitStore<bufSize>::BitStore(uint8_t bitlength) :buffsize(bufSize)
+template<uint16_t bufSize, uint8_t bitsPerValue>
+class RingBitStore
 {
-	valuelen = bitlength; // How many bits shoudl be reserved for one value added ?
-	bmask = 0;
-	//buffsize = bufsize;
-	//datastore= (unsigned char*) calloc(bufsize,sizeof(char)); // Speicher allokieren und 0 zuweisen
-	//bytecount = bufSize;
-	reset();
-	for (uint8_t x = 7; x>(7 - valuelen); x--)
-	{
-		bmask = bmask | (1 << x);
-	}
-}
+public:
+	static constexpr uint8_t valuelen = bitsPerValue;
+	static constexpr uint8_t valuesPerByte = 8 / bitsPerValue;
+	static constexpr uint8_t vmask = (1 << bitsPerValue) - 1;
+	static constexpr uint16_t capacity = uint16_t(bufSize) * valuesPerByte;
+	static_assert(bitsPerValue == 1 || bitsPerValue == 2 || bitsPerValue == 4, "bitsPerValue must be 1, 2 or 4");
+	static_assert(capacity <= 0x7FFF, "valcount is an int16_t");
 
-/** @brief (one liner)
-*
-* (documentation goes here)
-*/
-/*template<uint8_t bufSize>
-BitStore<bufSize>::~BitStore()
-{
-//free(datastore);
-}
-*/
-template<uint8_t bufSize>
-bool BitStore<bufSize>::addValue(byte value)
-{
-	//byte crcval = value;
+	typedef typename BitStoreIndex<(bufSize > 127)>::type byteidx_t;
+	typedef BitStoreIterator<RingBitStore> const_iterator;
 
+	RingBitStore() { reset(); }
+	bool addValue(byte value);
+	uint16_t addValues(const uint8_t *values, const uint16_t count);
+	int8_t getValue(const uint16_t pos) const;
+	uint16_t getValues(const uint16_t pos, uint8_t *dest, const uint16_t count) const;
+	bool moveLeft(const uint16_t begin);
+	bool changeValue(const uint16_t pos, byte value);
+	void remapValues(const uint8_t *map);	// Replaces every value v by map[v], map needs (1 << bitsPerValue) entries
 
-	if (bcnt == 7 && valcount > 0)
-	{
-		if (bytecount >= buffsize - 1) {
-			//Serial.println("OOB");
-			//MSG_PRINT(F("bcnt=")); MSG_PRINT(bcnt);
+	const uint16_t getSize() const { return valcount; }
+	unsigned char datastore[bufSize];
+	void reset();
+	bool getByte(const byteidx_t idx, uint8_t *retvalue) const;
+	byteidx_t bytecount;  // Logical index of the last used byte
+	int16_t valcount;  // Number of total values stored
 
-			return false; // Out of Buffer
-		}
-		bytecount++;
-		datastore[bytecount] = 0;
+	int8_t operator[](const uint16_t pos) const {
+		return getValue(pos);
+	}
+	RingBitStore &operator+=(const byte value) {
+		addValue(value);
+		return *this;
 	}
+	const_iterator begin() const { return const_iterator(this, 0); }
+	const_iterator end() const { return const_iterator(this, valcount); }
 
-	//Serial.print(" av c: ");   Serial.print(valcount, DEC);
-	//Serial.print(" av b: ");   Serial.println(bytecount, DEC);
+#ifndef UNITTEST
+protected:
 
-	//Serial.print("Adding value:");   Serial.print(value, DEC);
-	//Serial.print(" (");   Serial.print(value, BIN); Serial.print(") ");
-	//store[bytecount]=datastore[bytecount] | (value<<bcnt)
-	if (bcnt + 1 - valuelen >0 )
-		value <<= (bcnt + 1 - valuelen);
+private:
+#endif
+	uint16_t start;     // Position of logical value 0 in datastore, counted in values
+	byteidx_t startbyte;  // Byte and bit offset of start, used by getByte
+	uint8_t startshift;
+
+	uint16_t physPos(const uint16_t pos) const {
+		uint16_t p = start + pos;
+		if (p >= capacity) p -= capacity;
+		return p;
+	}
+	void setValue(const uint16_t p, byte value);
+	static uint8_t shiftOf(const uint16_t p) { return (valuesPerByte - 1 - p % valuesPerByte) * bitsPerValue; }
+};
 
-	datastore[bytecount] = datastore[bytecount] | value;  // (valcount*valuelen%8)
-														  /*
-														  Serial.print(" at byte: ");   Serial.print(bytecount, DEC);
-														  Serial.print(" at bitpos: ");   Serial.print(bcnt, DEC);
-														  Serial.print("  datastore is (bin)");   Serial.print(datastore[bytecount], BIN);
-														  Serial.print("  (dec)");   Serial.print(datastore[bytecount], DEC);
-														  Serial.print(" : ");
-														  Serial.print("  (valuelen)");   Serial.print(valuelen, DEC);
-														  */
-	
 
+//========================= BitStore ===================================================
+
+template<uint16_t bufSize, uint8_t bitsPerValue>
+bool BitStore<bufSize, bitsPerValue>::addValue(byte value)
+{
+	if (valcount >= capacity) return false; // Out of Buffer
 
+	const byteidx_t bytepos = valcount / valuesPerByte;
+	if (valcount % valuesPerByte == 0)
+		datastore[bytepos] = 0;		// First value in a new byte
+	datastore[bytepos] |= (value & vmask) << shiftOf(valcount);
+	bytecount = bytepos;
 	valcount++;
-	if (int8_t(bcnt) - valuelen >= 0)  // Soalnge nicht 8 Bit gepeichert wurden, erhoehen wir den counter zum verschieben
-	{
-		bcnt = bcnt - valuelen; //+valuelen
-	}
-	else {
-		bcnt = 7;
-	}
-		return true;
-	//Serial.println("");
+	return true;
 }
 
-
-template<uint8_t bufSize>
-bool BitStore<bufSize>::changeValue(const uint16_t pos, byte value)
+template<uint16_t bufSize, uint8_t bitsPerValue>
+uint16_t BitStore<bufSize, bitsPerValue>::addValues(const uint8_t *values, const uint16_t count)
 {
+	uint16_t i = 0;
+	for (; i < count && addValue(values[i]); i++) {}
+	return i;
+}
 
-	uint8_t bytepos = pos*valuelen / 8;
-	/*
-	Serial.print("Changing value:");   Serial.print(value, DEC);
-	Serial.print(" (");   Serial.print(value, BIN); Serial.print(")@valpos:");
-	Serial.print(pos, DEC);
-	Serial.print(" @byte: ");   Serial.print(bytepos, DEC);
-	Serial.print("  datastore is (bin)");   Serial.print(datastore[bytepos], BIN);
-	Serial.print(" (dec)");   Serial.print(datastore[bytepos], DEC);
-	*/
-	if ((bytepos) >= buffsize ) return false; // Out of Buffer
-												 // Serial.print("Pos:");   Serial.print(pos, DEC);
-												 // 01 11 11 00    10
-
-	value <<= (8 - (pos*valuelen % 8) - valuelen);									// shift bits in value to new positon
-																					//Serial.print(" new_value(bin)");   Serial.print(value, BIN);
-
-	datastore[bytepos] = datastore[bytepos] & ~(bmask >> (pos*valuelen % 8));  // Clear bits to be changed 
-	datastore[bytepos] = datastore[bytepos] | value;						    // Apply new bits
-
-																				/*
-																				Serial.print(" -> ");
-																				Serial.print("  datastore to (bin)");   Serial.print(datastore[bytepos], BIN);
-																				Serial.print(" (valuelen)");   Serial.println(valuelen, DEC);
-																				*/
+template<uint16_t bufSize, uint8_t bitsPerValue>
+bool BitStore<bufSize, bitsPerValue>::changeValue(const uint16_t pos, byte value)
+{
+	if (pos >= capacity) return false; // Out of Buffer
 
+	const byteidx_t bytepos = pos / valuesPerByte;
+	const uint8_t shift = shiftOf(pos);
+	datastore[bytepos] = (datastore[bytepos] & ~(vmask << shift)) | ((value & vmask) << shift);
 	return true;
 }
 
-/** @brief (return the last position with a value)
-*
-* (returns the variable valcount. This represents the number of values )
-*/
-
-template<uint8_t bufSize>
-const uint16_t BitStore<bufSize>::getSize()
+template<uint16_t bufSize, uint8_t bitsPerValue>
+void BitStore<bufSize, bitsPerValue>::remapValues(const uint8_t *map)
 {
-	return valcount;
+	if (valcount == 0) return;
+	for (byteidx_t i = 0; i <= bytecount; ++i)
+		datastore[i] = bitStoreRemapByte<bitsPerValue>(datastore[i], map);
 }
 
-template<uint8_t bufSize>
-bool BitStore<bufSize>::moveLeft(const uint16_t begin)
+template<uint16_t bufSize, uint8_t bitsPerValue>
+bool BitStore<bufSize, bitsPerValue>::moveLeft(const uint16_t begin)
 {
 	if (begin == 0 || begin >= valcount) return false;
 	if (begin == valcount - 1)
-	 {
+	{
 		reset();
 		return true;
 	}
-	uint8_t startbyte = begin*valuelen / 8;
-	//byte crcval = this->getValue(begin);
-	
-	//uint8_t offset = 0;
-
-	/*
-	Serial.print("moveleft startbyte:"); Serial.print(startbyte, DEC); Serial.print("@valpos");  Serial.print(begin, DEC);
-	Serial.print(" bytecount:"); Serial.print(bytecount, DEC);
-	Serial.print(" valcount:"); Serial.print(valcount, DEC);
-	Serial.print(" vlen:"); Serial.print(valuelen, DEC);
-	*/
-
-	if (begin % (8 / valuelen) != 0) {
-		uint8_t shift_left = (begin % (8 / valuelen))*valuelen;
-		uint8_t shift_right = 8 - shift_left;
-		//Serial.print(" sleft ");   Serial.print(shift_left, DEC);  Serial.print(" sright"); Serial.print(shift_right, DEC);
-
-		uint8_t i = startbyte;
-		uint8_t z = 0;
-		for (; i < bytecount; ++i, ++z)
-		{
-			/*
-			Serial.println("");
-			Serial.print("@[");  Serial.print(i, DEC); Serial.print("]");
-			Serial.print("->[");  Serial.print(z, DEC); Serial.print("] ");
+	const byteidx_t startbyte = begin / valuesPerByte;
 
-			Serial.print("z="); Serial.print(datastore[z], BIN);
-			Serial.print(" ileft="); Serial.print(char(datastore[i] << shift_left), BIN);
-			Serial.print(" iright="); Serial.print(char(datastore[i + 1] >> shift_right), BIN);
-			*/
-			datastore[z] = char(datastore[i] << shift_left) | char(datastore[i + 1] >> shift_right);;
+	if (begin % valuesPerByte != 0) {
+		const uint8_t shift_left = (begin % valuesPerByte) * bitsPerValue;
+		const uint8_t shift_right = 8 - shift_left;
 
-		}
-		if (valcount % 2 == 0) //Wenn valcount auf eine gerade Zahl fllt, brauchen wir noch eine Zuweisung
+		byteidx_t i = startbyte;
+		byteidx_t z = 0;
+		for (; i < bytecount; ++i, ++z)
 		{
-			datastore[z] = datastore[i] << shift_left;
-			/*
-			Serial.println("");
-			Serial.print("@[");  Serial.print(i, DEC); Serial.print("]");
-			Serial.print("->[");  Serial.print(z, DEC); Serial.print("] ");
-			Serial.print("z="); Serial.print(datastore[z], BIN);
-			*/
+			datastore[z] = char(datastore[i] << shift_left) | char(datastore[i + 1] >> shift_right);
 		}
-		valcount = valcount - begin;
-		uint8_t val_bcnt = (valcount*valuelen) % 8;
-		if (val_bcnt > 0)
-			bcnt = 7 - val_bcnt;
-		else
-			bcnt = 7;
-		bytecount = (valcount - 1)*valuelen / 8;
-
-		//bcnt = 7-shift_left;
-
-		//bcnt = bcnt - valuelen;  // Todo: Klren ob dies bentigt wird
-		//offset = 1;
+		datastore[z] = datastore[i] << shift_left;	// Remaining values of the last byte
 	}
 	else {
-		/*
-		Serial.println(" memmove: ");
-		Serial.print(" begin="); Serial.print(begin, DEC);
-		Serial.print(" bc=");  Serial.print(bytecount, DEC);  
-		Serial.print(" vc="); Serial.print(valcount, DEC);
-		*/
-		bytecount = bytecount - startbyte;
-		memmove(datastore, datastore + startbyte, sizeof(datastore[0]) * (bytecount + 1));
-		//bcnt = 7;
-		valcount = valcount - (8 / valuelen*startbyte); 
-		/*
-		Serial.print(" after: bc=");  Serial.print(bytecount, DEC);
-		Serial.print(" vc="); Serial.print(valcount, DEC);
-		*/
+		memmove(datastore, datastore + startbyte, sizeof(datastore[0]) * (bytecount - startbyte + 1));
+	}
+	valcount = valcount - begin;
+	bytecount = (valcount - 1) / valuesPerByte;
+	return true;
+}
 
+template<uint16_t bufSize, uint8_t bitsPerValue>
+int8_t BitStore<bufSize, bitsPerValue>::getValue(const uint16_t pos) const
+{
+	if (pos >= capacity) return -1; // Out of Buffer
+	return (datastore[pos / valuesPerByte] >> shiftOf(pos)) & vmask;
+}
 
+template<uint16_t bufSize, uint8_t bitsPerValue>
+uint16_t BitStore<bufSize, bitsPerValue>::getValues(const uint16_t pos, uint8_t *dest, const uint16_t count) const
+{
+	if (pos >= valcount) return 0;
+	const uint16_t n = count < valcount - pos ? count : valcount - pos;
+	uint16_t i = 0;
+	uint16_t p = pos;
+	for (; i < n && p % valuesPerByte != 0; ++i, ++p)	// Up to the next byte boundary
+		dest[i] = getValue(p);
+	for (; i + valuesPerByte <= n; p += valuesPerByte)	// Whole bytes
+	{
+		const uint8_t b = datastore[p / valuesPerByte];
+		for (uint8_t k = 0; k < valuesPerByte; ++k)
+			dest[i++] = (b >> ((valuesPerByte - 1 - k) * bitsPerValue)) & vmask;
 	}
-	/*
-	Serial.print(" after moveLeft "); Serial.print(" vc: ");   Serial.print(valcount, DEC);
-	Serial.print(" bytec: ");   Serial.print(bytecount, DEC);
-	Serial.print(" bitpos: ");   Serial.print(bcnt, DEC);
-	Serial.print("  datastore is (bin)");   Serial.print(datastore[bytecount], BIN);
-	Serial.print("  (dec)");   Serial.print(datastore[bytecount], DEC);
-	*/
-	/*
-	if (crcval != this->getValue(0)) {
-		Serial.print("  ");  Serial.print(crcval, DEC); Serial.print(" <> ");  Serial.print(this->getValue(0), DEC);
-	}
-	*/
-	/*
-	Serial.print(" bcnt: ");		 Serial.print(bcnt, DEC);
-	Serial.print(" valcount: ");     Serial.print(valcount, DEC);
-	Serial.print(" bytecount: ");    Serial.print(bytecount, DEC);
-	Serial.println(" ");
-	*/
-
+	for (; i < n; ++i, ++p)
+		dest[i] = getValue(p);
+	return n;
+}
 
+template<uint16_t bufSize, uint8_t bitsPerValue>
+bool BitStore<bufSize, bitsPerValue>::getByte(const byteidx_t idx, uint8_t *retvalue) const
+{
+	if (idx >= bufSize) return false; // Out of buffer range
+	*retvalue = datastore[idx];
 	return true;
+}
 
+template<uint16_t bufSize, uint8_t bitsPerValue>
+void BitStore<bufSize, bitsPerValue>::reset()
+{
+	datastore[0] = 0;
+	bytecount = 0;
+	valcount = 0;
+}
+
+
+//========================= RingBitStore ===============================================
+
+template<uint16_t bufSize, uint8_t bitsPerValue>
+void RingBitStore<bufSize, bitsPerValue>::setValue(const uint16_t p, byte value)
+{
+	const byteidx_t bytepos = p / valuesPerByte;
+	const uint8_t shift = shiftOf(p);
+	datastore[bytepos] = (datastore[bytepos] & ~(vmask << shift)) | ((value & vmask) << shift);
 }
 
-template<uint8_t bufSize>
-int8_t BitStore<bufSize>::getValue(const uint16_t pos)
+template<uint16_t bufSize, uint8_t bitsPerValue>
+bool RingBitStore<bufSize, bitsPerValue>::addValue(byte value)
 {
-	int16_t bytepos = pos*valuelen / 8;
-	if ((bytepos) >= buffsize ) return -1; // Out of Buffer
-											  //Serial.print("getValue Pos:");   Serial.print(pos, DEC);
+	if (valcount >= capacity) return false; // Out of Buffer
 
-	uint8_t mask; // Local modified bitmask
-				  //ret= (datastore[pos*valuelen/8]>>(pos*valuelen%8))&bmask;
-	mask = bmask >> (pos*valuelen % 8);            //Mask the position we want to retrieve
-												   //Serial.print(" Bitmask:");   Serial.print(mask, BIN);
+	setValue(physPos(valcount), value);
+	bytecount = valcount / valuesPerByte;
+	valcount++;
+	return true;
+}
 
-	_rval = datastore[bytepos] & mask;         // Combine the mask with our store to extract the bit
+template<uint16_t bufSize, uint8_t bitsPerValue>
+uint16_t RingBitStore<bufSize, bitsPerValue>::addValues(const uint8_t *values, const uint16_t count)
+{
+	uint16_t i = 0;
+	for (; i < count && addValue(values[i]); i++) {}
+	return i;
+}
 
-	byte scnt = 8 - (valuelen*(pos) % 8) - valuelen;// ((pos + 1)*valuelen % 8);         //      pos*valuelen    0*1/1*1/2*1/../7*1    7/6/5/0    8-1  8-2  8-3 8-8   
-													//byte scnt = ((pos+1)*valuelen % 8);								  //                       0*4/1*4              
-													//Serial.print(" datastore[bytepos]: ("); Serial.print(_rval, DEC); Serial.print(") ");  Serial.println(_rval, BIN);
-													//Serial.print(" shift:");   Serial.print(scnt, DEC);
+template<uint16_t bufSize, uint8_t bitsPerValue>
+bool RingBitStore<bufSize, bitsPerValue>::changeValue(const uint16_t pos, byte value)
+{
+	if (pos >= capacity) return false; // Out of Buffer
+	setValue(physPos(pos), value);
+	return true;
+}
 
-													//_rval = _rval >> abs(8 - (pos + 1)*valuelen) % 8;//(pos + 1)*valuelen % 8;
-	_rval = _rval >> scnt;
-	//Serial.print(" return: ("); Serial.print(_rval, DEC); Serial.print(") ");  Serial.println(_rval, BIN);
+template<uint16_t bufSize, uint8_t bitsPerValue>
+void RingBitStore<bufSize, bitsPerValue>::remapValues(const uint8_t *map)
+{
+	if (valcount == 0) return;
 
-	return _rval;
+	// Translate the physical bytes holding the values, a full store wraps onto its first byte
+	uint16_t n = (startshift + uint16_t(valcount) * bitsPerValue + 7) / 8;
+	if (n > bufSize) n = bufSize;
+	byteidx_t bytepos = startbyte;
+	for (; n > 0; --n)
+	{
+		datastore[bytepos] = bitStoreRemapByte<bitsPerValue>(datastore[bytepos], map);
+		if (++bytepos == bufSize) bytepos = 0;
+	}
 }
 
-template<uint8_t bufSize>
-bool BitStore<bufSize>::getByte(const uint8_t idx,uint8_t *retvalue)
+template<uint16_t bufSize, uint8_t bitsPerValue>
+bool RingBitStore<bufSize, bitsPerValue>::moveLeft(const uint16_t begin)
 {
-	if (idx >= buffsize ) return false; // Out of buffer range
-	*retvalue =datastore[idx];
+	if (begin == 0 || begin >= valcount) return false;
+	if (begin == valcount - 1)	// Same as BitStore, the last value is dropped too
+	{
+		reset();
+		return true;
+	}
+	start = physPos(begin);
+	startbyte = start / valuesPerByte;
+	startshift = (start % valuesPerByte) * bitsPerValue;
+	valcount -= begin;
+	bytecount = (valcount - 1) / valuesPerByte;
 	return true;
 }
 
-template<uint8_t bufSize>
-void BitStore<bufSize>::reset()
+template<uint16_t bufSize, uint8_t bitsPerValue>
+int8_t RingBitStore<bufSize, bitsPerValue>::getValue(const uint16_t pos) const
 {
-	/*for (uint8_t i = 0; i < bytecount; i++)
+	if (pos >= capacity) return -1; // Out of Buffer
+
+	const uint16_t p = physPos(pos);
+	return (datastore[p / valuesPerByte] >> shiftOf(p)) & vmask;
+}
+
+template<uint16_t bufSize, uint8_t bitsPerValue>
+uint16_t RingBitStore<bufSize, bitsPerValue>::getValues(const uint16_t pos, uint8_t *dest, const uint16_t count) const
+{
+	if (pos >= valcount) return 0;
+	const uint16_t n = count < valcount - pos ? count : valcount - pos;
+	uint16_t p = physPos(pos);
+	for (uint16_t i = 0; i < n; ++i)
 	{
-	datastore[i] = 0;
-	}*/
-	datastore[0] = 0;
+		dest[i] = (datastore[p / valuesPerByte] >> shiftOf(p)) & vmask;
+		if (++p == capacity) p = 0;
+	}
+	return n;
+}
+
+template<uint16_t bufSize, uint8_t bitsPerValue>
+bool RingBitStore<bufSize, bitsPerValue>::getByte(const byteidx_t idx, uint8_t *retvalue) const
+{
+	if (idx >= bufSize) return false; // Out of buffer range
+	if (valcount == 0 || idx > bytecount) {
+		*retvalue = 0;
+		return true;
+	}
+
+	byteidx_t bytepos = startbyte + idx;
+	if (bytepos >= bufSize) bytepos -= bufSize;
+	if (startshift == 0) {
+		*retvalue = datastore[bytepos];
+	} else {
+		const byteidx_t next = bytepos + 1 < bufSize ? bytepos + 1 : 0;
+		*retvalue = (datastore[bytepos] << startshift) | (datastore[next] >> (8 - startshift));
+	}
+
+	if (idx == bytecount) {
+		// Bits behind the last value are zero, like in BitStore
+		const uint8_t used = (valcount % valuesPerByte) * bitsPerValue;
+		if (used > 0) *retvalue &= 0xFF << (8 - used);
+	}
+	return true;
+}
+
+template<uint16_t bufSize, uint8_t bitsPerValue>
+void RingBitStore<bufSize, bitsPerValue>::reset()
+{
+	start = 0;
+	startbyte = 0;
+	startshift = 0;
 	bytecount = 0;
 	valcount = 0;
-	bcnt = 7;
-
-	//Serial.print("_bsres:"); Serial.print(valuelen); Serial.print("_");
 }
 #endif // BITSTORE_H
@@ -0,0 +1,324 @@
+/*
+*   Output fan-out, passes every message from one shared buffer to several clients
+*   Copyright (C) 2026  SIGNALduino contributors
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef OUTPUTHUB_H
+#define OUTPUTHUB_H
+
+#include "Arduino.h"
+#include "signalDecoder.h"
+
+/*
+*	push() is the format stream callback of the decoders (setFormatStreamCallback). Every part is stored once:
+*	length, flags (formats, continuation, more), reference count, data. The reference count is the number of
+*	clients which want the part in their format, parts nobody wants are not stored.
+*	Every client has its own cursor and writes from the shared buffer as much as its port takes (drain()), the
+*	space of a part is reused as soon as all clients have written it.
+*	If the buffer is full, the oldest message is dropped for the clients which did not start writing it yet, so a
+*	slow client loses messages but never blocks the others.
+*
+*	Port needs availableForWrite(), write(buf, len) and connected().
+*	The decoders must print every format a client wants: outputFormats = formats().
+*/
+
+constexpr const uint8_t fmtAuto = 0xFF;		// Client gets defaultFormat, follows the MS / MU / MC config
+
+template<uint16_t bufSize, uint8_t maxClients, class Port>
+class OutputHub
+{
+	static_assert(bufSize > 0 && (bufSize & (bufSize - 1)) == 0, "bufSize must be a power of two");
+	static_assert(bufSize <= 32768, "bufSize is too big");
+	static_assert(bufSize >= 2 * (maxFrameSize + 3), "bufSize must hold at least two parts");
+
+public:
+	OutputHub() : defaultFormat(fmtVerbose), droppedMsgs(0), maxCount(0), head(0), tail(0), pushOpen(false), pushDropping(false) {
+		for (uint8_t i = 0; i < maxClients; i++)
+			client[i].port = nullptr;
+	}
+
+	void attach(const uint8_t slot, Port *port);			// Client gets messages pushed from now on, format fmtAuto
+	void detach(const uint8_t slot);
+	bool isAttached(const uint8_t slot) const { return client[slot].port != nullptr; }
+	void setFormat(const uint8_t slot, const uint8_t format) { client[slot].format = format; }	// fmtAuto or MessageFormat, used from the next message on
+	uint8_t getFormat(const uint8_t slot) const { return client[slot].format; }
+	uint16_t dropped(const uint8_t slot) const { return client[slot].dropped; }	// Messages the client has lost
+	uint8_t formats() const;								// Formats wanted by the clients, bit n for MessageFormat n
+
+	size_t push(const uint8_t *buf, uint8_t len, uint8_t formats);
+	void drain();											// Writes without blocking
+	void finishMessage(const uint8_t slot);					// Waits until the client is not within a message, call before writing to it directly
+	uint16_t count() const { return uint16_t(head - tail); }
+
+	uint8_t defaultFormat;
+
+	// Statistics
+	uint16_t droppedMsgs;		// Messages not stored, because even dropping did not free enough space
+	uint16_t maxCount;			// High watermark in bytes, including headers
+
+private:
+	static const uint16_t mask = bufSize - 1;
+	static const uint8_t hdrSize = 3;
+	static const uint8_t flagCont = 0x40;		// Part continues the message of the part before
+	static const uint8_t fmtMask = 0x3F;
+
+	struct Client {
+		Port *port;
+		uint16_t cursor;		// Next part to write
+		uint8_t sent;			// Bytes of this part already written
+		uint8_t format;			// Configured format
+		uint8_t current;		// Format the references are counted for, follows format at message boundaries
+		bool skipCont;			// Attached within a message, skip its remaining parts
+		uint16_t dropped;
+	};
+
+	inline uint8_t at(const uint16_t idx) const { return raw[idx & mask]; }
+	inline uint8_t &at(const uint16_t idx) { return raw[idx & mask]; }
+	inline uint16_t next(const uint16_t idx) const { return idx + hdrSize + at(idx); }
+	inline uint16_t rel(const uint16_t idx) const { return uint16_t(idx - tail); }
+	uint8_t target(const Client &c) const { return c.format == fmtAuto ? defaultFormat : c.format; }
+	static bool wants(const uint8_t format, const uint8_t flags) { return (flags & (1 << format)) != 0; }
+	void retarget(Client &c);
+	void release(Client &c);
+	void drain(Client &c);
+	bool dropOldest();
+	void reclaim();
+
+	Client client[maxClients];
+	uint8_t raw[bufSize];
+	uint16_t head;			// Next write position
+	uint16_t tail;			// Oldest part still referenced
+	bool pushOpen;			// Last pushed message continues in the next part
+	bool pushDropping;		// Rest of the open message is dropped
+};
+
+
+template<uint16_t bufSize, uint8_t maxClients, class Port>
+void OutputHub<bufSize, maxClients, Port>::attach(const uint8_t slot, Port *port)
+{
+	if (isAttached(slot)) detach(slot);
+	Client &c = client[slot];
+	c.cursor = head;
+	c.sent = 0;
+	c.format = fmtAuto;
+	c.current = defaultFormat;
+	c.skipCont = pushOpen;
+	c.dropped = 0;
+	c.port = port;
+}
+
+template<uint16_t bufSize, uint8_t maxClients, class Port>
+void OutputHub<bufSize, maxClients, Port>::detach(const uint8_t slot)
+{
+	Client &c = client[slot];
+	if (c.port == nullptr) return;
+	release(c);
+	c.port = nullptr;
+	reclaim();
+}
+
+template<uint16_t bufSize, uint8_t maxClients, class Port>
+uint8_t OutputHub<bufSize, maxClients, Port>::formats() const
+{
+	uint8_t f = 0;
+	for (uint8_t i = 0; i < maxClients; i++) {
+		if (client[i].port != nullptr)
+			f |= (1 << target(client[i])) | (1 << client[i].current);
+	}
+	return f;
+}
+
+// Drops the references of all parts the client has not written yet
+template<uint16_t bufSize, uint8_t maxClients, class Port>
+void OutputHub<bufSize, maxClients, Port>::release(Client &c)
+{
+	for (uint16_t idx = c.cursor; idx != head; idx = next(idx)) {
+		const uint8_t flags = at(idx + 1);
+		if (wants(c.current, flags))
+			at(idx + 2)--;
+	}
+	c.cursor = head;
+	c.sent = 0;
+}
+
+// Switches the client to its configured format, must be called at a message boundary
+template<uint16_t bufSize, uint8_t maxClients, class Port>
+void OutputHub<bufSize, maxClients, Port>::retarget(Client &c)
+{
+	const uint8_t format = target(c);
+	for (uint16_t idx = c.cursor; idx != head; idx = next(idx)) {
+		const uint8_t flags = at(idx + 1);
+		if (wants(c.current, flags)) at(idx + 2)--;
+		if (wants(format, flags)) at(idx + 2)++;
+	}
+	c.current = format;
+}
+
+template<uint16_t bufSize, uint8_t maxClients, class Port>
+size_t OutputHub<bufSize, maxClients, Port>::push(const uint8_t *buf, uint8_t len, uint8_t formats)
+{
+	const bool cont = pushOpen;
+	const bool more = (formats & fmtMore) != 0;
+	if (!cont)
+		pushDropping = false;
+
+	uint8_t refs = 0;
+	for (uint8_t i = 0; i < maxClients; i++) {
+		if (client[i].port != nullptr && wants(client[i].current, formats))
+			refs++;
+	}
+	const uint16_t need = hdrSize + len;
+	while (!pushDropping && refs > 0 && uint16_t(bufSize - count()) < need) {
+		if (!dropOldest()) {	// Only messages which are partially written are left, bufSize is too small for maxClients
+			droppedMsgs++;
+			pushDropping = true;
+		}
+	}
+	pushOpen = more;
+	if (pushDropping || refs == 0 || len == 0) {
+		pushDropping = pushDropping && more;
+		return len;
+	}
+
+	at(head) = len;
+	at(head + 1) = (formats & fmtMask) | (cont ? flagCont : 0);
+	at(head + 2) = refs;
+	for (uint8_t i = 0; i < len; i++)
+		at(head + hdrSize + i) = buf[i];
+	head += need;
+	if (count() > maxCount) maxCount = count();
+	return len;
+}
+
+/*
+*	Removes the oldest message no client has started to write, with all its parts, and moves the parts behind it
+*	down. Clients which wanted it and had not written it yet count it as dropped. Returns false if there is none.
+*/
+template<uint16_t bufSize, uint8_t maxClients, class Port>
+bool OutputHub<bufSize, maxClients, Port>::dropOldest()
+{
+	uint16_t start = tail;
+	while (start != head)
+	{
+		uint16_t end = next(start);
+		while (end != head && (at(end + 1) & flagCont))
+			end = next(end);
+
+		bool locked = false;
+		for (uint8_t i = 0; i < maxClients; i++) {
+			const Client &c = client[i];
+			if (c.port == nullptr) continue;
+			if ((c.cursor == start && c.sent > 0) || (rel(c.cursor) > rel(start) && rel(c.cursor) < rel(end)))
+				locked = true;
+		}
+		if (!locked) {
+			const uint8_t flags = at(start + 1);
+			const uint16_t size = end - start;
+			for (uint8_t i = 0; i < maxClients; i++) {
+				Client &c = client[i];
+				if (c.port == nullptr) continue;
+				if (rel(c.cursor) <= rel(start) && wants(c.current, flags))
+					c.dropped++;
+				if (rel(c.cursor) >= rel(end))
+					c.cursor -= size;
+			}
+			if (end == head && pushOpen)
+				pushDropping = true;		// Message push() is adding a part to, the rest is dropped as well
+			uint16_t dst = start;
+			while (end != head)
+				at(dst++) = at(end++);
+			head = dst;
+			return true;
+		}
+		start = end;
+	}
+	return false;
+}
+
+template<uint16_t bufSize, uint8_t maxClients, class Port>
+void OutputHub<bufSize, maxClients, Port>::drain(Client &c)
+{
+	while (true)
+	{
+		if (c.sent == 0 && !pushOpen && c.current != target(c) && (c.cursor == head || !(at(c.cursor + 1) & flagCont)))
+			retarget(c);
+		if (c.cursor == head)
+			return;
+		const uint8_t len = at(c.cursor);
+		const uint8_t flags = at(c.cursor + 1);
+		if (!(flags & flagCont))
+			c.skipCont = false;
+		if (!wants(c.current, flags) || (c.skipCont && (flags & flagCont))) {
+			if (wants(c.current, flags)) at(c.cursor + 2)--;
+			c.cursor = next(c.cursor);
+			continue;
+		}
+		const int avail = c.port->availableForWrite();
+		if (avail <= 0)
+			return;
+		const uint16_t start = (c.cursor + hdrSize + c.sent) & mask;
+		uint16_t n = len - c.sent;
+		if (n > uint16_t(avail)) n = avail;
+		if (n > bufSize - start) n = bufSize - start;		// Part up to the end of the buffer, the rest follows
+		n = c.port->write(&raw[start], n);
+		if (n == 0)
+			return;
+		c.sent += n;
+		if (c.sent == len) {
+			at(c.cursor + 2)--;
+			c.cursor = next(c.cursor);
+			c.sent = 0;
+		}
+	}
+}
+
+// Frees the written parts at the tail, but not beyond a client which has not looked at them yet
+template<uint16_t bufSize, uint8_t maxClients, class Port>
+void OutputHub<bufSize, maxClients, Port>::reclaim()
+{
+	while (tail != head && at(tail + 2) == 0) {
+		for (uint8_t i = 0; i < maxClients; i++) {
+			if (client[i].port != nullptr && client[i].cursor == tail)
+				return;
+		}
+		tail = next(tail);
+	}
+}
+
+template<uint16_t bufSize, uint8_t maxClients, class Port>
+void OutputHub<bufSize, maxClients, Port>::drain()
+{
+	for (uint8_t i = 0; i < maxClients; i++) {
+		if (client[i].port != nullptr)
+			drain(client[i]);
+	}
+	reclaim();
+}
+
+template<uint16_t bufSize, uint8_t maxClients, class Port>
+void OutputHub<bufSize, maxClients, Port>::finishMessage(const uint8_t slot)
+{
+	Client &c = client[slot];
+	if (c.port == nullptr) return;
+	while (c.port->connected() && (c.sent > 0 || (c.cursor != head && (at(c.cursor + 1) & flagCont) && !c.skipCont)))
+	{
+		drain(c);
+		yield();
+	}
+	reclaim();
+}
+
+#endif // OUTPUTHUB_H
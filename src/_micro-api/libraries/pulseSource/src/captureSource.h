@@ -0,0 +1,186 @@
+/*
+*   Pulse source with edges timestamped by the timer hardware
+*   Copyright (C) 2026  SIGNALduino contributors
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CAPTURESOURCE_H
+#define CAPTURESOURCE_H
+
+#include "pulseSource.h"
+
+#if defined(__AVR__) && defined(TIMER1_CAPT_vect)
+
+#ifdef TimerOne_h_
+#error "PULSE_CAPTURE runs Timer1 itself, TimerOne must not be used with it"
+#endif
+
+/*
+*	Timer1 input capture (ICP1): the timer latches the time of every edge, the pulse widths do not depend on the ISR entry time
+*	and have a resolution of 0.5 us (16 MHz) / 1 us (8 MHz). The receiver must be wired to the ICP1 pin (D8 on the ATmega328P).
+*
+*	The source owns Timer1, startTimer() lets it run free with prescaler 8. The sketch provides both interrupts:
+*	ISR(TIMER1_CAPT_vect) { pulseSource.capture(); } and ISR(TIMER1_OVF_vect) { cronjob(); }, the cronjob must call idle().
+*	The overflow comes every 65536 ticks, the cronjob period is 32.768 ms at 16 MHz and 65.536 ms at 8 MHz.
+*/
+template<class Channel>
+class CaptureSource : public PulseSource
+{
+public:
+	CaptureSource(Channel &rxChannel, const uint8_t receivePin) : channel(rxChannel), pin(receivePin), base(0) {}
+
+	// Call once in setup(), the overflow interrupt runs the cronjob from then on
+	void startTimer()
+	{
+		uint8_t oldSREG = SREG;
+		cli();
+		TCCR1A = 0;										// Normal mode, ICR1 is free for the capture
+		TCCR1B = _BV(ICNC1) | _BV(CS11);				// Noise canceler, prescaler 8
+		TCNT1 = 0;
+		TIFR1 = _BV(TOV1);
+		TIMSK1 |= _BV(TOIE1);
+		SREG = oldSREG;
+	}
+
+	bool begin()
+	{
+		uint8_t oldSREG = SREG;
+		cli();
+		if (isLow(pin))									// Next edge
+			TCCR1B |= _BV(ICES1);
+		else
+			TCCR1B &= ~_BV(ICES1);
+		TIFR1 = _BV(ICF1);
+		TIMSK1 |= _BV(ICIE1);
+		SREG = oldSREG;
+		return true;
+	}
+
+	void end() { TIMSK1 &= ~_BV(ICIE1); }				// The overflow keeps running the cronjob
+
+	// Called by ISR(TIMER1_CAPT_vect)
+	inline void capture()
+	{
+		const uint16_t icr = ICR1;
+		const bool rising = TCCR1B & _BV(ICES1);
+		TCCR1B ^= _BV(ICES1);							// Next edge has the other direction
+		TIFR1 = _BV(ICF1);								// Changing the edge may set the flag
+		unsigned long now = base + (icr >> tickShift);
+		if ((TIFR1 & _BV(TOV1)) && icr < 0x8000)		// Overflow before the edge, its interrupt did not run yet
+			now += overflowTime;
+		channel.edge(now, rising);
+	}
+
+	// Called by the cronjob on every Timer1 overflow
+	unsigned long idle()
+	{
+		base += overflowTime;
+		return channel.timeout(base + (TCNT1 >> tickShift), TCCR1B & _BV(ICES1));	// Waiting for a rising edge, the level is low
+	}
+
+private:
+	static const uint8_t tickShift = F_CPU >= 16000000L ? 1 : 0;		// Timer ticks per us: 2 at 16 MHz, 1 at 8 MHz
+	static const unsigned long overflowTime = 65536UL >> tickShift;	// us per overflow
+
+	Channel &channel;
+	const uint8_t pin;
+	volatile unsigned long base;							// Time of the last overflow in us
+};
+
+#elif defined(ESP32)
+
+#include "driver/rmt.h"
+
+/*
+*	RMT receiver: the RMT peripheral records the durations of both levels with 1 us resolution, no interrupt per edge.
+*	A level which does not change for maxPulse ends a frame, the driver passes the frame to its ring buffer and
+*	poll() (main loop) moves it into the FIFO, followed by maxPulse of the idle level. Spikes below ~3 us are filtered
+*	by the RMT. One channel uses 4 memory blocks (256 items), a frame is limited to 512 pulses.
+*	A second receiver needs an RMT channel 4 blocks apart (RMT_CHANNEL_0 and RMT_CHANNEL_4).
+*/
+template<class Channel>
+class CaptureSource : public PulseSource
+{
+public:
+	CaptureSource(Channel &rxChannel, const uint8_t receivePin, const rmt_channel_t rmtChannel) : channel(rxChannel), pin(receivePin), rmt(rmtChannel), ringbuf(nullptr) {}
+
+	bool begin()
+	{
+		if (ringbuf == nullptr) {
+			rmt_config_t config = {};
+			config.rmt_mode = RMT_MODE_RX;
+			config.channel = rmt;
+			config.gpio_num = gpio_num_t(pin);
+			config.clk_div = 80;							// 1 us per tick from the 80 MHz APB clock
+			config.mem_block_num = 4;
+			config.rx_config.filter_en = true;
+			config.rx_config.filter_ticks_thresh = 250;		// APB ticks
+			config.rx_config.idle_threshold = maxPulse;
+			if (rmt_config(&config) != ESP_OK || rmt_driver_install(rmt, 4096, 0) != ESP_OK)
+				return false;
+			rmt_get_ringbuf_handle(rmt, &ringbuf);
+			if (ringbuf == nullptr)
+				return false;
+		}
+		return rmt_rx_start(rmt, true) == ESP_OK;
+	}
+
+	void end()
+	{
+		if (ringbuf == nullptr)
+			return;
+		rmt_rx_stop(rmt);
+		size_t len;
+		void *items;
+		while ((items = xRingbufferReceive(ringbuf, &len, 0)) != nullptr)	// Frames received before are outdated
+			vRingbufferReturnItem(ringbuf, items);
+	}
+
+	unsigned long idle() { return 0; }					// The RMT ends the frame itself
+
+	void poll()
+	{
+		if (ringbuf == nullptr)
+			return;
+		size_t len;
+		rmt_item32_t *items;
+		while ((items = (rmt_item32_t *)xRingbufferReceive(ringbuf, &len, 0)) != nullptr) {
+			const size_t n = len / sizeof(rmt_item32_t);
+			bool high = false;
+			for (size_t i = 0; i < n; i++) {
+				if (items[i].duration0 == 0) break;
+				high = items[i].level0;
+				channel.pulse(items[i].duration0, high);
+				if (items[i].duration1 == 0) break;
+				high = items[i].level1;
+				channel.pulse(items[i].duration1, high);
+			}
+			channel.pulse(maxPulse, !high);				// The level after the last edge ended the frame
+			vRingbufferReturnItem(ringbuf, items);
+		}
+	}
+
+private:
+	Channel &channel;
+	const uint8_t pin;
+	const rmt_channel_t rmt;
+	RingbufHandle_t ringbuf;
+};
+
+#else
+#error "PULSE_CAPTURE: no capture hardware on this board, use the pin change interrupt"
+#endif
+
+#endif // CAPTURESOURCE_H
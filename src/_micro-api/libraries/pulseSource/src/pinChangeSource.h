@@ -0,0 +1,48 @@
+/*
+*   Pulse source with the receive interrupt of a pin
+*   Copyright (C) 2026  SIGNALduino contributors
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PINCHANGESOURCE_H
+#define PINCHANGESOURCE_H
+
+#include "pulseSource.h"
+
+/*
+*	Pin change interrupt: the receive ISR (handleInterrupt) calls channel.edge(micros(), level), micros() has a resolution of 4 us on AVR.
+*	The ISR is passed in, it is plain code of the sketch.
+*/
+template<class Channel>
+class PinChangeSource : public PulseSource
+{
+public:
+	PinChangeSource(Channel &rxChannel, const uint8_t receivePin, void (*receiveIsr)()) : channel(rxChannel), pin(receivePin), isr(receiveIsr) {}
+
+	bool begin()
+	{
+		attachInterrupt(digitalPinToInterrupt(pin), isr, CHANGE);
+		return true;
+	}
+	void end() { detachInterrupt(digitalPinToInterrupt(pin)); }
+	unsigned long ICACHE_RAM_ATTR idle() { return channel.timeout(micros(), isLow(pin)); }
+
+private:
+	Channel &channel;
+	const uint8_t pin;
+	void (*const isr)();
+};
+
+#endif // PINCHANGESOURCE_H
@@ -0,0 +1,107 @@
+/*
+*   Pulse sources, deliver the level changes of a receiver to its channel
+*   Copyright (C) 2026  SIGNALduino contributors
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PULSESOURCE_H
+#define PULSESOURCE_H
+
+#include "Arduino.h"
+#include "signalDecoder.h"
+
+#ifndef ICACHE_RAM_ATTR
+#define ICACHE_RAM_ATTR
+#endif
+
+/*
+*	A pulse source measures the pulses of one receiver and puts them into the FIFO of its channel (ReceiverChannel::edge / pulse / timeout).
+*	The channel calls poll() before it reads the FIFO, the timer calls idle() (cronjob) to flush a level which did not change for maxPulse.
+*
+*	Backends:
+*	  PinChangeSource	receive ISR on every level change, timestamps from micros() (pinChangeSource.h, default)
+*	  CaptureSource		edges timestamped by the timer hardware, Timer1 input capture on AVR / RMT on ESP32 (captureSource.h, PULSE_CAPTURE)
+*	  ReplaySource		recorded or synthetic pulses with a simulated clock, for tests and benchmarks on the host
+*/
+class PulseSource
+{
+public:
+	virtual bool begin() = 0;				// Starts receiving, false if the backend is not available
+	virtual void end() = 0;					// Stops receiving
+	virtual unsigned long idle() = 0;		// Adds maxPulse if the level did not change for maxPulse. Returns the time since the last edge in us
+	virtual void poll() {}					// Moves pulses buffered by the backend into the FIFO
+};
+
+/*
+*	Host backend: replays pulses (positive = high, negative = low, e.g. a block of a pulse trace) as edges with a simulated clock.
+*	poll() passes up to pulsesPerPoll pulses, like the receive ISR between two passes of the main loop. Once all pulses are passed,
+*	every idle() call lets maxPulse of the last level pass, like the timer does while the receiver is silent.
+*/
+template<class Channel>
+class ReplaySource : public PulseSource
+{
+public:
+	ReplaySource(Channel &rxChannel, const uint16_t pulsesPerPoll = 8) : channel(rxChannel), chunk(pulsesPerPoll), pulses(nullptr), count(0), pos(0), simClock(0), low(true), running(false) {}
+
+	// Replays the pulses after the ones loaded before, the buffer must stay valid until done()
+	void load(const int16_t *data, const size_t n)
+	{
+		pulses = data;
+		count = n;
+		pos = 0;
+	}
+	bool done() const { return pos >= count; }
+
+	bool begin()
+	{
+		running = true;
+		return true;
+	}
+	void end() { running = false; }
+
+	unsigned long idle()
+	{
+		if (!running || !done())
+			return 0;
+		simClock += maxPulse;
+		return channel.timeout(simClock, low);
+	}
+
+	void poll()
+	{
+		if (!running)
+			return;
+		for (uint16_t i = 0; i < chunk && pos < count; i++, pos++) {
+			const int16_t p = pulses[pos];
+			simClock += (unsigned long)(p < 0 ? -p : p);
+			low = p > 0;						// Level after the edge at the end of the pulse
+			channel.edge(simClock, !low);
+		}
+	}
+
+	unsigned long now() const { return simClock; }	// Simulated time in us
+
+private:
+	Channel &channel;
+	const uint16_t chunk;
+	const int16_t *pulses;
+	size_t count;
+	size_t pos;
+	unsigned long simClock;
+	bool low;
+	bool running;
+};
+
+#endif // PULSESOURCE_H
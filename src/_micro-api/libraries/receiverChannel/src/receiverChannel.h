@@ -0,0 +1,238 @@
+/*
+*   Receiver channel, bundles pulse timing, pulse FIFO and pattern decoder of one receiver
+*   Copyright (C) 2026  SIGNALduino contributors
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef RECEIVERCHANNEL_H
+#define RECEIVERCHANNEL_H
+
+#include "Arduino.h"
+#include "SPSCFifo.h"
+#include "signalDecoder.h"
+#include "pulseSource.h"
+
+#ifndef ICACHE_RAM_ATTR
+#define ICACHE_RAM_ATTR
+#endif
+
+#ifndef pulseMin
+#define pulseMin  90
+#endif
+
+#if defined(ESP32)
+// The pin ISR and the cron timer task may run on different cores, both change the held pulse
+#define RX_LOCK_INIT , lock(portMUX_INITIALIZER_UNLOCKED)
+#define RX_LOCK() portENTER_CRITICAL_SAFE(&lock)
+#define RX_UNLOCK() portEXIT_CRITICAL_SAFE(&lock)
+#else
+// Single core, the receive ISR and the timer ISR do not interrupt each other
+#define RX_LOCK_INIT
+#define RX_LOCK()
+#define RX_UNLOCK()
+#endif
+
+/*
+*	One receiver: its pulse source (setSource) passes every level change to edge() or every pulse to pulse(), the timer calls idle().
+*	All of them put the pulses into the FIFO, the main loop passes them in batches to the decoder (processBatch).
+*	Several channels can run side by side, every channel has its own FIFO, decoder and timing. If a channel is
+*	tagged, every message it outputs gets a "CH=<id>;" field in front of the message end (decoder message tag).
+*
+*	Glitch filter: a pulse shorter than glitchMin is a spike of the receiver, it is added to the pulse before. If the pulse
+*	after it has the same level as the one before, both are merged, high 500, low 50, high 1000 gives high 1550. For this the
+*	last pulse is held back until the next one arrives, a pulse of maxPulse is passed at once.
+*	edge(), pulse() and timeout() change the held pulse from the receive ISR and from the timer, on ESP32 they take a lock.
+*/
+template<uint16_t fifoSize, uint8_t batchSize>
+class ReceiverChannel
+{
+public:
+	typedef SignalDetectorClass::Func2pRetuint8t WriteCallback;
+
+	ReceiverChannel() : id(0), tagged(false), pulseCount(0), messageCount(0), glitchMin(pulseMin), glitches(0), source(nullptr), lastTime(0), held(0), heldHigh(false), glitched(false) RX_LOCK_INIT {}
+
+	void begin(const uint8_t channelId, WriteCallback output, const bool tagOutput = false)
+	{
+		id = channelId;
+		tagged = tagOutput;
+		decoder.setStreamCallback(output);
+		if (tagged) {
+			sprintf(tag, "CH=%u;", id);
+			decoder.setMessageTag(tag);
+		}
+		else
+			decoder.setMessageTag(nullptr);
+	}
+
+	// Output which gets the formats of every part, for clients which want different formats (decoder.outputFormats)
+	void begin(const uint8_t channelId, MessageFrame::FormatOutput output, const bool tagOutput = false)
+	{
+		begin(channelId, WriteCallback(), tagOutput);
+		decoder.setFormatStreamCallback(output);
+	}
+
+	void reset()
+	{
+		decoder.reset();
+		fifo.flush();
+		RX_LOCK();
+		held = 0;
+		glitched = false;
+		RX_UNLOCK();
+	}
+
+	//========================= Pulse source =============================================
+
+	void setSource(PulseSource *pulseSource) { source = pulseSource; }
+	bool enable() { return source != nullptr && source->begin(); }
+	void disable() { if (source != nullptr) source->end(); }
+	unsigned long ICACHE_RAM_ATTR idle() { return source != nullptr ? source->idle() : 0; }	// Called by the timer, see PulseSource::idle
+
+	//========================= Receive ISR / timer ======================================
+
+	// Level change at time now (micros), high is the level after the change
+	void ICACHE_RAM_ATTR edge(const unsigned long now, const bool high)
+	{
+		RX_LOCK();
+		const unsigned long duration = now - lastTime;
+		lastTime = now;
+		addPulse(duration, !high); // Wenn jetzt high ist, dann muss vorher low gewesen sein, und dafuer gilt die gemessene Dauer.
+		RX_UNLOCK();
+	}
+
+	// Pulse of the given duration (us) and level, for sources which measure the pulses themselves
+	void ICACHE_RAM_ATTR pulse(const unsigned long duration, const bool high)
+	{
+		RX_LOCK();
+		addPulse(duration, high);
+		RX_UNLOCK();
+	}
+
+	// Called by the timer, adds maxPulse if the level did not change for maxPulse. Returns the time since the last edge
+	unsigned long ICACHE_RAM_ATTR timeout(const unsigned long now, const bool low)
+	{
+		RX_LOCK();
+		unsigned long duration = now - lastTime;
+		if (duration >= maxPulse) {
+			addPulse(maxPulse, !low); // Wenn jetzt low ist, ist auch weiterhin low
+			lastTime = now;
+			duration = 0;
+		}
+		RX_UNLOCK();
+		return duration;
+	}
+
+	//========================= Main loop ================================================
+
+	// Passes up to batchSize pulses to the decoder. Returns the number of decoded messages or -1 if the FIFO was empty
+	int16_t processBatch()
+	{
+		if (source != nullptr) source->poll();
+		const uint16_t n = fifo.dequeue(batch, batchSize);
+		if (n == 0) {
+			decoder.passRepeats();		// Folded repeats are passed while the channel is idle
+			return -1;
+		}
+		const int16_t found = int16_t(decoder.decode(batch, n));
+		pulseCount += n;
+		messageCount += found;
+		return found;
+	}
+
+	//========================= Statistics ===============================================
+
+	uint32_t received() const { return pulseCount + fifo.count(); }	// Pulses stored in the FIFO, without the dropped ones
+	void resetCounters()
+	{
+		pulseCount = 0;
+		messageCount = 0;
+		RX_LOCK();
+		glitches = 0;
+		RX_UNLOCK();
+		fifo.resetCounters();
+#if decoderCounters
+		decoder.counters.clear();
+#endif
+	}
+
+	SPSCFifo<int, fifoSize> fifo;
+	SignalDetectorClass decoder;
+	uint8_t id;
+	bool tagged;
+	uint32_t pulseCount;		// Pulses passed to the decoder
+	uint32_t messageCount;		// Decoded messages
+	uint16_t glitchMin;			// Pulses shorter than this (us) are merged into the pulses around them
+	volatile uint32_t glitches;	// Merged spikes
+	PulseSource *source;
+
+private:
+	ReceiverChannel(const ReceiverChannel&);
+	ReceiverChannel &operator=(const ReceiverChannel&);
+
+	// Glitch filter, called with the lock held
+	inline void ICACHE_RAM_ATTR addPulse(const unsigned long duration, const bool high)
+	{
+		if (duration < glitchMin) {//kleinste zulaessige Pulslaenge
+			if (held > 0) {		// Spike, belongs to the pulse before
+				held += duration;
+				glitched = true;
+				glitches++;
+			} // else => trash
+			return;
+		}
+		if (held > 0) {
+			if (glitched && high == heldHigh) {		// Same level as before the spike, one pulse
+				held += duration;
+				glitched = false;
+				if (held >= maxPulse) passHeld();
+				return;
+			}
+			passHeld();
+		}
+		held = duration;
+		heldHigh = high;
+		glitched = false;
+		if (held >= maxPulse) passHeld();		// Nothing to merge with, the pause ends the message
+	}
+
+	// Passes the held pulse to the FIFO
+	inline void ICACHE_RAM_ATTR passHeld()
+	{
+		int sDuration;
+		if (held < maxPulse) {//groesste zulaessige Pulslaenge, max = 32000
+			sDuration = int(held);
+		}
+		else {
+			sDuration = maxPulse; // Maximalwert set to maxPulse defined in lib.
+		}
+		if (!heldHigh) {
+			sDuration = -sDuration;
+		}
+		fifo.enqueue(sDuration);
+		held = 0;
+	}
+
+	volatile unsigned long lastTime;
+	unsigned long held;			// Last pulse, not passed yet, 0: none
+	bool heldHigh;
+	bool glitched;				// A spike was added to held
+	char tag[9];
+	int batch[batchSize];
+#if defined(ESP32)
+	portMUX_TYPE lock;
+#endif
+};
+
+#endif // RECEIVERCHANNEL_H
@@ -0,0 +1,99 @@
+/*
+*   Stage profiler for the pattern decoder
+*   Copyright (C) 2026  SIGNALduino contributors
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _DECODERPROFILE_h
+#define _DECODERPROFILE_h
+
+/*
+*	Enabled with the build flag PROFILE (-DPROFILE for all sources), without it PROFILE_STAGE is empty.
+*	PROFILE_STAGE(stage) measures the time up to the end of its scope and adds it to count, total and max of the
+*	stage. Stages nest, the time of processMessage includes compress_pattern, getClock, ... of the same call.
+*	Times are micros() on the target and steady clock nanoseconds on the host (DecoderProfile::unit).
+*	On the host every thread has its own table, decoders running in parallel threads do not share it.
+*/
+
+#ifdef PROFILE
+
+#include "Arduino.h"
+#include "FastDelegate.h"
+
+#if defined(WIN32) || defined(__linux__)
+#include <chrono>
+typedef uint64_t ProfileTicks;
+#define PROFILE_TLS thread_local
+#else
+typedef uint32_t ProfileTicks;
+#define PROFILE_TLS
+#endif
+
+enum ProfileStage : uint8_t { prfDetect, prfProcess, prfCompress, prfClock, prfSync, prfManchester, prfMcDecode, prfOutput, prfStageCnt };
+
+struct ProfileEntry
+{
+	uint32_t count;
+	ProfileTicks total;
+	ProfileTicks max;
+};
+
+class DecoderProfile
+{
+public:
+	typedef fastdelegate::FastDelegate2<const uint8_t*, uint8_t, size_t> Output;
+
+	static inline ProfileTicks now()
+	{
+#if defined(WIN32) || defined(__linux__)
+		return ProfileTicks(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+#else
+		return micros();
+#endif
+	}
+	static inline void add(const ProfileStage stage, const ProfileTicks ticks)
+	{
+		ProfileEntry &e = table[stage];
+		e.count++;
+		e.total += ticks;
+		if (ticks > e.max) e.max = ticks;
+	}
+	static void clear();
+	static void dump(Output out);			// One line per stage: "<stage>: count=..;total=..;max=..;unit=..;"
+
+	static PROFILE_TLS ProfileEntry table[prfStageCnt];
+	static const char *const stageName[prfStageCnt];
+	static const char *const unit;
+};
+
+class ProfileScope
+{
+public:
+	explicit ProfileScope(const ProfileStage s) : stage(s), start(DecoderProfile::now()) {}
+	~ProfileScope() { DecoderProfile::add(stage, DecoderProfile::now() - start); }
+private:
+	const ProfileStage stage;
+	const ProfileTicks start;
+};
+
+#define PROFILE_STAGE(stage) ProfileScope profileScope(stage)
+
+#else
+
+#define PROFILE_STAGE(stage)
+
+#endif // PROFILE
+
+#endif // _DECODERPROFILE_h
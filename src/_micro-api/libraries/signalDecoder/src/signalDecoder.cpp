@@ -29,6 +29,7 @@
 
 */
 #include "signalDecoder.h"
+#include "decoderProfile.h"
 
 // TODO: Update lib with this content to to src\_micro-api\libraries\signalDecoder and use this one instead of a local copy for testing!
 
@@ -43,9 +44,10 @@
 #endif
 
 //Helper function to check buffer for bad data
-const bool SignalDetectorClass::checkMBuffer(const uint8_t begin)
+template<uint16_t msgSize, uint8_t numPattern, class Index>
+const bool SignalDetector<msgSize, numPattern, Index>::checkMBuffer(const Index begin)
 {
-	for (uint8_t i = begin; i < messageLen-1; i++)
+	for (Index i = begin; i < messageLen-1; i++)
 	{
 		if ( (pattern[message[i]] ^ pattern[message[i+1]]) >= 0) 
 		{
@@ -55,10 +57,12 @@ const bool SignalDetectorClass::checkMBuffer(const uint8_t begin)
 	return true;
 }
 
-void SignalDetectorClass::bufferMove(const uint8_t start)
+template<uint16_t msgSize, uint8_t numPattern, class Index>
+void SignalDetector<msgSize, numPattern, Index>::bufferMove(const Index start)
 {
 	m_truncated = false;
 	if (start == 0 || messageLen == 0) 	return;
+	COUNT_DECODER(moves);
 
 	if (start > messageLen - 1) {
 
@@ -68,20 +72,32 @@ void SignalDetectorClass::bufferMove(const uint8_t start)
 	{
 	
 	}
-	else if (message.moveLeft(start))
+	else
 	{
+		// Keep histo up to date, either remove the counts of the dropped part or count the remaining part, whatever is shorter
+		const bool subtract = start <= messageLen - start;
+		Index removed[numPattern];
+		if (subtract) calcHisto(removed, 0, start);
+
+		if (!message.moveLeft(start)) {
+			DBG_PRINT(__FUNCTION__); DBG_PRINT(" move error "); 	DBG_PRINT(start);
+			return;
+		}
 		m_truncated = true; 
 		//DBG_PRINT(__FUNCTION__); DBG_PRINT(" -> "); 	DBG_PRINT(start);  DBG_PRINT(" "); DBG_PRINT(messageLen);
 		//DBG_PRINT(" "); DBG_PRINT(message.bytecount);
 		//messageLen = messageLen - start;
 		messageLen = message.valcount;
+		if (subtract && messageLen > 0) {
+			for (uint8_t i = 0; i < numPattern; ++i)
+				histo[i] -= removed[i];
+		} else {
+			calcHisto();
+		}
 		if (messageLen > 0)
 			last = &pattern[message[messageLen - 1]]; //Eventuell wird last auf einen nicht mehr vorhandenen Wert gesetzt, da der Puffer komplett gelöscht wurde
 		else
 			last = nullptr;
-	} else {
-		DBG_PRINT(__FUNCTION__); DBG_PRINT(" move error "); 	DBG_PRINT(start);
-		//printOut();
 	}
 
 
@@ -89,7 +105,8 @@ void SignalDetectorClass::bufferMove(const uint8_t start)
 }
 
 
-void SignalDetectorClass::addData(const int8_t value)
+template<uint16_t msgSize, uint8_t numPattern, class Index>
+void SignalDetector<msgSize, numPattern, Index>::addData(const int8_t value)
 {
 	//message += value;
 	/*if (message.valcount >= 254)
@@ -103,6 +120,8 @@ void SignalDetectorClass::addData(const int8_t value)
 	{
 		messageLen=message.valcount;
 		m_truncated = false; // Clear truncated flag
+		histo[value]++;
+		last = &pattern[value]; // Keep last valid for the next pulse, so decode does not need to read it back from the message buffer
 		return;
 /*		if (messageLen > 1 && checkMBuffer(messageLen-2))
 		{
@@ -127,29 +146,81 @@ void SignalDetectorClass::addData(const int8_t value)
 	SDC_PRINT(" state="); SDC_PRINT(state);
 	SDC_PRINT(" success="); 
 	SDC_PRINTLN(success);
-
+	last = (messageLen > 0) ? &pattern[message[messageLen - 1]] : nullptr;
 }
 
-inline void SignalDetectorClass::addPattern()
+template<uint16_t msgSize, uint8_t numPattern, class Index>
+inline void SignalDetector<msgSize, numPattern, Index>::addPattern()
 {
 	pattern[pattern_pos] = *first;						//Store pulse in pattern array
+	updPatternWindow(pattern_pos);
 	pattern_pos++;
 }
 
-inline void SignalDetectorClass::updPattern( const uint8_t ppos)
+template<uint16_t msgSize, uint8_t numPattern, class Index>
+inline void SignalDetector<msgSize, numPattern, Index>::updPattern( const uint8_t ppos)
 {
 	pattern[ppos] = (long(pattern[ppos]) + *first) / 2; // Moving average
+	updPatternWindow(ppos);
+}
+
+/*
+	A pulse val matches pattern p if abs(val - p) <= abs(val) / 5. For p > 0 this is exactly the window p - p/6 <= val <= p + p/4,
+	so findpatt needs only two integer compares. p/6 is calculated as (p/2)/3 with a multiplication, avoiding a division on AVR.
+*/
+template<uint16_t msgSize, uint8_t numPattern, class Index>
+inline void SignalDetector<msgSize, numPattern, Index>::updPatternWindow(const uint8_t idx)
+{
+	const bool neg = pattern[idx] < 0;
+	const uint16_t a = uint16_t(sd_min(neg ? -long(pattern[idx]) : long(pattern[idx]), 32767L));
+	const uint16_t lo = a - uint16_t((uint32_t(a >> 1) * 21846U) >> 16);
+	const uint16_t hi = sd_min(uint16_t(a + (a >> 2)), 32767);
+	if (neg) {
+		patternLo[idx] = -int(hi);
+		patternHi[idx] = -int(lo);
+	} else {
+		patternLo[idx] = lo;
+		patternHi[idx] = hi;
+	}
 }
 
+template<uint16_t msgSize, uint8_t numPattern, class Index>
+void SignalDetector<msgSize, numPattern, Index>::calcPatternIndex()
+{
+	for (uint8_t idx = 0; idx < patternLen; ++idx)
+		updPatternWindow(idx);
+	updPatternIndex();
+}
 
-inline void SignalDetectorClass::doDetect()
+template<uint16_t msgSize, uint8_t numPattern, class Index>
+void SignalDetector<msgSize, numPattern, Index>::updPatternIndex()
 {
+	uint8_t neg[numPattern];
+	uint8_t negCnt = 0;
+	patternPosCnt = 0;
+	for (uint8_t idx = 0; idx < patternLen; ++idx)
+	{
+		if (pattern[idx] > 0) patternIdx[patternPosCnt++] = idx;
+		else if (pattern[idx] < 0) neg[negCnt++] = idx;
+	}
+	patternIdxCnt = patternPosCnt;
+	for (uint8_t i = 0; i < negCnt; ++i)
+		patternIdx[patternIdxCnt++] = neg[i];
+}
+
+
+template<uint16_t msgSize, uint8_t numPattern, class Index>
+inline void SignalDetector<msgSize, numPattern, Index>::doDetect()
+{
+	PROFILE_STAGE(prfDetect);
 
 	//printOut();
+	if (mcDetected && mcdecoder->streaming && mcStream())
+		return;
 
 	bool valid;
 	valid = (messageLen == 0 || last == nullptr || (*first ^ *last) < 0); // true if a and b have opposite signs
-	valid &= (messageLen == maxMsgSize) ? false : true;
+	valid &= (messageLen == msgSize) ? false : true;
 	valid &= (*first > -maxPulse);  // if low maxPulse detected, start processMessage()
 
 
@@ -160,11 +231,14 @@ inline void SignalDetectorClass::doDetect()
 
 		// Try output
 		processMessage();
+		if (mcDetected && mcdecoder->streaming && mcStream())
+			return;		// Buffer was full in the middle of a manchester signal, it goes on with this pulse
 
 		// processMessage was not able to find anything useful in our buffer. As the pulses are not valid, we reset and start new buffering. Also a check if pattern has opposit sign is done here again to prevent failuer adding after a move
 		if ((success == false && !mcDetected) || (messageLen > 0 && last != nullptr && (*first ^ *last) >= 0)) {
 			if (last != nullptr && (*first ^ *last) >= 0 ) //&& *last != 0
 			{
+				COUNT_DECODER(invalidResets);
 				/*
 				SDC_PRINT(" nv reset");
 				char buf[20];
@@ -178,7 +252,7 @@ inline void SignalDetectorClass::doDetect()
 			valid = true;
 		}
 		
-		if (messageLen == maxMsgSize )
+		if (messageLen == msgSize )
 		{
 			DBG_PRINT(millis());
 			DBG_PRINTLN(F(" mb f a t proc ")); // message buffer full after try proccessMessage
@@ -186,7 +260,7 @@ inline void SignalDetectorClass::doDetect()
 		}
 		
 	}
-	else if (messageLen == minMessageLen) {
+	else if (messageLen == minMessageLen && msPart == 0) {	// A streamed MS message stays in syncfound
 		state = detecting;  // Set state to detecting, because we have more than minMessageLen data gathered, so this is no noise
 		if (_rssiCallback != nullptr) 
 			rssiValue = _rssiCallback();
@@ -198,21 +272,34 @@ inline void SignalDetectorClass::doDetect()
 	if (fidx >= 0) {
 		// Upd pattern
 		updPattern(fidx);
+		if (churn > 0 && --churn < noiseGateOpen)
+			noiseGate = false;
 	}
 	else {
 
 		// Add pattern
-		if (patternLen == maxNumPattern)
+		if (patternLen == numPattern)
+		{
+			churn = sd_min(churn + noiseChurnStep, 255);
+			if (churn >= noiseGateClose)
+				noiseGate = true;
+		}
+		if (patternLen == numPattern && noiseGate && state != syncfound && !mcDetected && msPart == 0)
+		{
+			// Noise, nothing in the buffer is worth a processMessage
+#if decoderCounters
+			counters.noiseResets++;
+			counters.noisePulses += messageLen;
+#endif
+			reset();
+		}
+		else if (patternLen == numPattern)
 		{
-			calcHisto();
 			if (histo[pattern_pos] > 2)
 			{
 				processMessage();
-				calcHisto();
-
-
 			}
-			for (uint8_t i = messageLen - 1 ; i >= 0 && histo[pattern_pos] > 0 && messageLen>0; --i)
+			for (Index i = messageLen - 1 ; i >= 0 && histo[pattern_pos] > 0 && messageLen>0; --i)
 			{
 				if (message[i] == pattern_pos) // Finde den letzten Verweis im Array auf den Index der gleich ueberschrieben wird
 				{
@@ -226,22 +313,28 @@ inline void SignalDetectorClass::doDetect()
 		}
 
 		fidx = pattern_pos;
+		// patternIdx only changes if a new slot is used or the replaced pattern had the other sign
+		const bool idxChanged = fidx >= patternLen || pattern[fidx] == 0 || (pattern[fidx] ^ *first) < 0;
 		addPattern();
+		if (msPart > 0 && (fidx == clock || fidx == sync))
+			msPart = 0;		// Clock or sync of a streamed MS message was replaced, the rest is detected again
 
-		if (pattern_pos == maxNumPattern)
+		if (pattern_pos == numPattern)
 		{
 			pattern_pos = 0;  // Wenn der Positions Index am Ende angelegt ist, gehts wieder bei 0 los und wir ueberschreiben alte pattern
-			patternLen = maxNumPattern;
+			patternLen = numPattern;
 			mcDetected = false;  // When changing a pattern, we need to redetect a manchester signal and we are not in a buffer full mode scenario
 
 		}
 		if (pattern_pos > patternLen) patternLen = pattern_pos;
-
+		if (idxChanged) updPatternIndex();
 	}
 
 	// Add data to buffer
 	addData(fidx);
-	//histo[fidx ]++;  // need changes in unittests
+#if DEBUGDETECT >= 1
+	checkHisto();
+#endif
 
 #if DEBUGDETECT > 3
 		DBG_PRINT("Pulse: "); DBG_PRINT(*first);
@@ -258,24 +351,44 @@ inline void SignalDetectorClass::doDetect()
 
 }
 
-bool SignalDetectorClass::decode(const int * pulse)
+template<uint16_t msgSize, uint8_t numPattern, class Index>
+bool SignalDetector<msgSize, numPattern, Index>::decode(const int * pulse)
 {
-	success = false;
+	return decode(pulse, 1) > 0;
+}
+
+template<uint16_t msgSize, uint8_t numPattern, class Index>
+size_t SignalDetector<msgSize, numPattern, Index>::decode(const int * pulses, const size_t n)
+{
+	size_t found = 0;
+
+	// Only needed once per batch, addData keeps last up to date for the following pulses
 	if (messageLen > 0)
 		last = &pattern[message[messageLen - 1]];
 	else
 		last = nullptr;
 
-	*first = *pulse;
-	
-	doDetect();
-	return success;
+	for (size_t i = 0; i < n; i++)
+	{
+		success = false;
+		*first = pulses[i];
+		doDetect();
+		if (success) found++;
+	}
+	return found;
 }
 
 
-void SignalDetectorClass::compress_pattern()
+template<uint16_t msgSize, uint8_t numPattern, class Index>
+void SignalDetector<msgSize, numPattern, Index>::compress_pattern()
 {
-	calcHisto();
+	PROFILE_STAGE(prfCompress);
+	// Merged patterns are collected in remap (old -> new index) and the message is translated once at the end
+	uint8_t remap[16];
+	bool merged = false;
+	for (uint8_t i = 0; i < 16; i++)
+		remap[i] = i;
+
 	for (uint8_t idx = 0; idx<patternLen-1; idx++)
 	{
 		if (histo[idx] == 0)
@@ -294,16 +407,8 @@ void SignalDetectorClass::compress_pattern()
 
 			if (inTol(pattern[idx2], pattern[idx], tol))  // Pattern are very equal, so we can combine them
 			{
-				uint8_t change_count = 0;
-				// Change val -> ref_val in message array
-				for (uint8_t i = 0; i<messageLen && change_count < histo[idx2]; i++)
-				{
-					if (message[i] == idx2)
-					{
-						message.changeValue(i, idx);
-						change_count++;
-					}
-				}
+				remap[idx2] = idx;	// idx2 is empty afterwards and never a merge target, so there are no chains
+				merged = true;
 
 #if DEBUGDETECT>2
 				DBG_PRINT("compr: "); DBG_PRINT(idx2); DBG_PRINT("->"); DBG_PRINT(idx); DBG_PRINT(";");
@@ -318,6 +423,7 @@ void SignalDetectorClass::compress_pattern()
 				pattern[idx] = ((long(pattern[idx]) * histo[idx]) + (long(pattern[idx2]) * histo[idx2])) / sum;
 				histo[idx] += histo[idx2];
 				pattern[idx2] = histo[idx2]= 0;
+				updPatternWindow(idx);		// findpatt matches around the merged value
 
 #if DEBUGDETECT>2
 				DBG_PRINT(" idx:"); DBG_PRINT(pattern[idx]);
@@ -328,6 +434,13 @@ void SignalDetectorClass::compress_pattern()
 			}
 		}
 	}
+	if (merged)
+	{
+		message.remapValues(remap);
+		if (last != nullptr)	// The last value of the message was changed too, a batch keeps using last
+			last = &pattern[remap[last - pattern]];
+	}
+	updPatternIndex();
 	/*
 	if (!checkMBuffer())
 	{
@@ -346,36 +459,37 @@ void SignalDetectorClass::compress_pattern()
 	*/
 }
 
-void SignalDetectorClass::processMessage()
+template<uint16_t msgSize, uint8_t numPattern, class Index>
+void SignalDetector<msgSize, numPattern, Index>::processMessage()
 {
+	PROFILE_STAGE(prfProcess);
 	yield();
-	char buf[22] = {};
-	uint8_t n = 0;
+	COUNT_DECODER(processCalls);
 
-	if (mcDetected == true || messageLen >= minMessageLen) {
+	if (mcDetected == true || messageLen >= minMessageLen || (msPart > 0 && messageLen > 0)) {
 		success = false;
-		m_overflow = (messageLen == maxMsgSize) ? true : false;
+		m_overflow = (messageLen == msgSize) ? true : false;
 
 #if DEBUGDETECT >= 1
 		DBG_PRINTLN("Message received:");
 #endif
 
-		if (!mcDetected)
+		if (!mcDetected && msPart == 0)	// A streamed MS message keeps the pattern indices, clock and sync of its first part
 		{
 			compress_pattern();
 			//calcHisto();
-			getClock();
-			if (state == clockfound && MSenabled) getSync();
-		}
-		else {
-			calcHisto();
+			if (!MSenabled || !matchFingerprint())
+			{
+				getClock();
+				if (state == clockfound && MSenabled) getSync();
+			}
 		}
 
 #if DEBUGDETECT >= 1
 		printOut();
 #endif
 
-		if (state == syncfound && messageLen >= minMessageLen)// Messages mit clock / Sync Verhaeltnis pruefen
+		if (state == syncfound && (messageLen >= minMessageLen || msPart > 0))// Messages mit clock / Sync Verhaeltnis pruefen
 		{
 #if DEBUGDECODE >0
 			SDC_PRINT(" MS check: ");
@@ -405,7 +519,8 @@ void SignalDetectorClass::processMessage()
 			}
 			if (mend > messageLen) mend = messageLen;  // Reduce mend if we are behind messageLen
 													   //if (!m_endfound) mend=messageLen;  // Reduce mend if we are behind messageLen
-			calcHisto(mstart, mend);	// Recalc histogram due to shortened message
+			Index msgHisto[numPattern];
+			calcHisto(msgHisto, mstart, mend);	// Histogram of the shortened message, only used patterns are printed
 
 #if DEBUGDECODE > 1
 			DBG_PRINT("Index: ");
@@ -415,11 +530,12 @@ void SignalDetectorClass::processMessage()
 			DBG_PRINT(" - MEFound: "); DBG_PRINTLN(m_endfound);
 			DBG_PRINT(" - MEnd: "); DBG_PRINTLN(mend);
 #endif // DEBUGDECODE
-			if (m_endfound && (mend - mstart) < minMessageLen) {
+			const bool streamed = msPart > 0;	// Parts of the message have been printed already, any rest completes it
+			if (m_endfound && (mend - mstart) < minMessageLen && !streamed) {
 				state = clockfound; // step back back to clockfound state, because it is to short for our ms signals
 				goto MUOutput;
 			}
-			if ((m_endfound && (mend - mstart) >= minMessageLen) || (!m_endfound && messageLen < maxMsgSize && (messageLen - mstart) >= minMessageLen))
+			if ((m_endfound && (streamed || (mend - mstart) >= minMessageLen)) || (!m_endfound && messageLen < msgSize && (streamed || (messageLen - mstart) >= minMessageLen)))
 			{
 
 #ifdef DEBUGDECODE
@@ -430,122 +546,22 @@ void SignalDetectorClass::processMessage()
 				//postamble = "";
 
 				/*				Output raw message Data				*/
-				SDC_PRINT(MSG_START);
-				if (MredEnabled) {
-					int patternInt;
-					uint8_t patternLow;
-					uint8_t patternIdx;
-					
-					SDC_PRINT("Ms");  SDC_PRINT(SERIAL_DELIMITER);
-					for (uint8_t idx = 0; idx < patternLen; idx++)
-					{
-						if (pattern[idx] == 0 || histo[idx] == 0) continue;
-						patternIdx = idx;
-						patternInt = pattern[idx];
-
-						if (patternInt < 0) {
-							patternIdx = idx | 0xA0;    // Bit5 = 1 (Vorzeichen negativ)
-							patternInt = -patternInt;
-						}
-						else {
-							patternIdx = idx | 0x80;    // Bit5 = 0 (Vorzeichen positiv)
-						}
-						
-						patternLow = lowByte(patternInt);
-						if (bitRead(patternLow, (uint8_t)7) == 0) {
-							bitSet(patternLow, (uint8_t)7);
-						}
-						else {
-							bitSet(patternIdx, (uint8_t)4);   // wenn bei patternLow Bit7 gesetzt ist, dann bei patternIdx Bit4 = 1
-						}
-						SDC_PRINT(patternIdx);
-						SDC_PRINT(patternLow);
-						SDC_PRINT(highByte(patternInt) | 0x80);
-						SDC_PRINT(SERIAL_DELIMITER);
-					}
-
-					//uint8_t n;
-					if ((mend & 1) == 1) {   // zwei Nibble im letzten Byte übergeben
-						SDC_PRINT("D");
-					}
-					else {
-						SDC_PRINT("d");     // ein Nibble im letzten Byte übergeben
-					}
-					if ((mstart & 1) == 1) {  // ungerade Startposition
-						mstart--;
-						
-						message.getByte(mstart / 2, &n);
-						n = (n & 15) | 128;             // high nibble = 8 als Kennzeichen für ungeraden mstart
-
-						SDC_PRINT(n);
- 						mstart += 2;
-					}
-					for (uint8_t i = mstart; i <= mend; i=i+2) {					
-						message.getByte(i/2,&n);
-						SDC_PRINT(n);
-					}
-
-					n = sprintf(buf, ";C%X;S%X;", clock, sync);
-					SDC_PRINT(buf);
-					if (_rssiCallback != nullptr)
-					{
-						n = sprintf(buf, "R%X;", rssiValue);
-						SDC_PRINT(buf);
-					}
-			    }
-				else {
-					SDC_PRINT("MS");  SDC_PRINT(SERIAL_DELIMITER);
-					for (uint8_t idx = 0; idx < patternLen; idx++)
-					{
-						if (pattern[idx] == 0 || histo[idx] == 0) continue;
-						
-						//SDC_PRINT('P'); SDC_PRINT(idx); SDC_PRINT('='); SDC_PRINT(itoa(pattern[idx], buf, 10)); SDC_PRINT(SERIAL_DELIMITER);
-						n = sprintf(buf, "P%i=%i;", idx,pattern[idx]);
-						SDC_PRINT(buf);
-
-					}
-					SDC_PRINT("D=");
-
-					for (uint8_t i = mstart; i <= mend; i++)
-					{
-						sprintf(buf, "%d", message[i]);
-						SDC_PRINT(buf);
-					}
-					/*
-					SDC_PRINT(SERIAL_DELIMITER);
-					SDC_PRINT("CP="); SDC_PRINT(itoa(clock, buf, 10));     SDC_PRINT(SERIAL_DELIMITER);     // ClockPulse
-					SDC_PRINT("SP="); SDC_PRINT(itoa(sync, buf, 10));      SDC_PRINT(SERIAL_DELIMITER);     // SyncPulse
-					SDC_PRINT("R=");  SDC_PRINT(itoa(rssiValue, buf, 10)); SDC_PRINT(SERIAL_DELIMITER);     // Signal Level (RSSI)					
-					*/
-					n = sprintf(buf, ";CP=%i;SP=%i;", clock, sync);
-					SDC_PRINT(buf);
-					if (_rssiCallback != nullptr)
-					{
-						n = sprintf(buf, "R=%i;", rssiValue);
-						SDC_PRINT(buf);
-					}
-				}
-
-				if (m_overflow) {
-					SDC_PRINT("O");  SDC_PRINT(SERIAL_DELIMITER);
-				}
+				const bool msMove = (messageLen - mend) >= minMessageLen && MsMoveCount > 0;
+				if (streamed) msPart++;
+				printMS(msgHisto, msMove);
+				msPart = 0;
 				m_truncated = false;
 				
-				if ((messageLen - mend) >= minMessageLen && MsMoveCount > 0) {
+				if (msMove) {
 					//SDC_PRINT(F("MS move. messageLen ")); SDC_PRINT(messageLen); SDC_PRINT(" "); SDC_PRINTLN(MsMoveCount)
 					MsMoveCount--;
 					bufferMove(mend+1);
 					//SDC_PRINT(F("MS move. messageLen ")); SDC_PRINTLN(messageLen);
 					mstart = 0;
-					//SDC_PRINT("m"); SDC_PRINT(MsMoveCount); SDC_PRINT(SERIAL_DELIMITER);
-					n = sprintf(buf, "m%i;", MsMoveCount);
-					SDC_PRINT(buf);
 				}
-				SDC_PRINT(MSG_END);
-				SDC_PRINT(char(0xA));
 				success = true;
 			}
-			else if (m_endfound == false && mstart > 0 && mend + 1 >= maxMsgSize) // Start found, but no end. We remove everything bevore start and hope to find the end later
+			else if (m_endfound == false && mstart > 0 && mend + 1 >= msgSize) // Start found, but no end. We remove everything bevore start and hope to find the end later
 			{
 				//SDC_PRINT("copy");
 #ifdef DEBUGDECODE
@@ -555,7 +571,32 @@ void SignalDetectorClass::processMessage()
 				mstart = 0;
 				//m_truncated = true;  // Flag that we truncated the message array and want to receiver some more data
 			} 
-			else if (m_endfound && mend < maxMsgSize) {  // Start and end found, but end is not at end of buffer, so we remove only what was checked
+			else if (m_endfound == false && mend + 1 >= msgSize && (streamed || messageLen - mstart >= minMessageLen) && clockEnd(mstart) == messageLen) // Start at the begin of the full buffer, but no end. The complete clock / data pairs are printed as a part, the rest goes to the next part
+			{
+				mend = mstart + ((messageLen - mstart - 1) & ~1) - 1;	// Keeps one or two pulses, the pattern table stays with the buffer
+				calcHisto(msgHisto, mstart, mend);
+				msPart++;
+				printMS(msgHisto, false);
+				bufferMove(mend + 1);
+				mstart = 0;
+				success = true;	// don't process other message types
+			}
+			else if (streamed) // A high pulse which is not the clock ended the message, the part before it is the last one
+			{
+				mend = clockEnd(mstart);
+				if (mend > mstart) {
+					mend--;
+					calcHisto(msgHisto, mstart, mend);
+					msPart++;
+					printMS(msgHisto, false);
+					mend++;
+				}
+				msPart = 0;
+				bufferMove(mend);
+				mstart = 0;
+				success = true;	// don't process other message types
+			}
+			else if (m_endfound && mend < msgSize) {  // Start and end found, but end is not at end of buffer, so we remove only what was checked
 #ifdef DEBUGDECODE
 				DBG_PRINT(" move msg ");;
 #endif
@@ -589,13 +630,13 @@ MUOutput:
 			//preamble = "";
 			//postamble = "";
 
-			if (MCenabled)
+			if (MCenabled && fingerprint < 0)	// A known MS signal is no manchester signal
 			{
 				//DBG_PRINT(" mc: ");
 				//SDC_PRINT(" try mc ");
 
 				//static ManchesterpatternDecoder mcdecoder(this);			// Init Manchester Decoder class
-				if (mcdecoder == nullptr) { mcdecoder = new ManchesterpatternDecoder(this); }
+				if (mcdecoder == nullptr) { mcdecoder = &manchester; }
 				if (mcDetected == false)
 				{
 					mcdecoder->reset();
@@ -613,6 +654,8 @@ MUOutput:
 
 //#if DEBUGDECODE == 1 // todo kommentar entfernen
 #if DEBUGDECODE == 1 // todo kommentar entfernen
+					char buf[22];
+					uint8_t n;
 					SDC_WRITE(MSG_START);
 					SDC_PRINT("DMC");
 					SDC_WRITE(SERIAL_DELIMITER);
@@ -629,7 +672,7 @@ MUOutput:
 					SDC_PRINT("D=");
 
 
-					for (uint8_t i = 0; i < messageLen; ++i)
+					for (Index i = 0; i < messageLen; ++i)
 					{
 						SDC_PRINT(itoa(message[i], buf, 10));
 					}
@@ -648,35 +691,7 @@ MUOutput:
 #endif
 					if (mcdecoder->doDecode())
 					{
-						SDC_PRINT(MSG_START);
-						SDC_PRINT("MC");
-						n = sprintf(buf, ";LL=%i;LH=%i", pattern[mcdecoder->longlow], pattern[mcdecoder->longhigh]);
-						SDC_PRINT(buf);
-						n = sprintf(buf, ";SL=%i;SH=%i;", pattern[mcdecoder->shortlow], pattern[mcdecoder->shorthigh]);
-						SDC_PRINT(buf);
-
-						/*
-						SDC_PRINT("LL="); SDC_PRINT(pattern[mcdecoder->longlow]); SDC_PRINT(SERIAL_DELIMITER);
-						SDC_PRINT("LH="); SDC_PRINT(pattern[mcdecoder->longhigh]); SDC_PRINT(SERIAL_DELIMITER);
-						SDC_PRINT("SL="); SDC_PRINT(pattern[mcdecoder->shortlow]); SDC_PRINT(SERIAL_DELIMITER);
-						SDC_PRINT("SH="); SDC_PRINT(pattern[mcdecoder->shorthigh]); SDC_PRINT(SERIAL_DELIMITER);
-						*/
-						SDC_PRINT("D=");  mcdecoder->printMessageHexStr();
-
-						n = sprintf(buf, ";C=%i;L=%i;", mcdecoder->clock, mcdecoder->ManchesterBits.valcount);
-						SDC_PRINT(buf);
-						if (_rssiCallback != nullptr)
-						{
-							n = sprintf(buf, "R=%i;", rssiValue);
-							SDC_PRINT(buf);
-						}						/*
-						SDC_PRINT(SERIAL_DELIMITER);
-						SDC_PRINT("C="); SDC_PRINT(mcdecoder->clock); SDC_PRINT(SERIAL_DELIMITER);
-						SDC_PRINT("L="); SDC_PRINT(mcdecoder->ManchesterBits.valcount); SDC_PRINT(SERIAL_DELIMITER);
-						SDC_PRINT("R=");  SDC_PRINT(rssiValue); SDC_PRINT(SERIAL_DELIMITER);     // Signal Level (RSSI)
-						*/
-						SDC_PRINT(MSG_END);
-						SDC_PRINT(char(0xA));
+						printMC();
 #ifdef DEBUGDECODE
 						DBG_PRINTLN("");
 #endif
@@ -685,15 +700,7 @@ MUOutput:
 						success = true;
 					}
 					else if (mcDetected == true) {
-						if (m_truncated == true) {
-							//SDC_PRINT(" mc true");
-							success = true;   // Prevents MU Processing
-						} else {
-							// message buffer is untouched till now, but we will reset the the message buffer now to preserve anything else
-							message.reset();
-							messageLen = message.valcount;
-							m_truncated = true; // Preserve anything else like pattern and so on.
-						}
+						mcStreamBegin();	// Buffer is full, the rest of the signal is decoded without buffering it again
 					}
 				}
 
@@ -705,104 +712,7 @@ MUOutput:
 #if DEBUGDECODE > 1
 				DBG_PRINT(" MU found: ");
 #endif // DEBUGDECODE
-				SDC_PRINT(MSG_START);
-				if (MredEnabled) {
-					int patternInt;
-					uint8_t patternLow;
-					uint8_t patternIdx;
-					
-					SDC_PRINT("Mu");  SDC_PRINT(SERIAL_DELIMITER);
-					calcHisto();
-					for (uint8_t idx = 0; idx < patternLen; idx++)
-					{
-						if (pattern[idx] == 0 || histo[idx] == 0) continue;
-						patternIdx = idx;
-						patternInt = pattern[idx];
-
-						if (patternInt < 0) {
-							patternIdx = idx | 0xA0;    // Bit5 = 1 (Vorzeichen negativ)
-							patternInt = -patternInt;
-						}
-						else {
-							patternIdx = idx | 0x80;    // Bit5 = 0 (Vorzeichen positiv)
-						}
-						
-						patternLow = lowByte(patternInt);
-						if (bitRead(patternLow, (uint8_t)7) == 0) {
-							bitSet(patternLow, (uint8_t)7);
-						}
-						else {
-							bitSet(patternIdx, (uint8_t)4);   // wenn bei patternLow Bit7 gesetzt ist, dann bei patternIdx Bit4 = 1
-						}
-						SDC_PRINT(patternIdx);
-						SDC_PRINT(patternLow);
-						SDC_PRINT(highByte(patternInt) | 0x80);
-						SDC_PRINT(SERIAL_DELIMITER);
-					}
-
-					if ((messageLen & 1) == 1) {  // ein Nibble im letzten Byte übergeben ungerade 
-						SDC_PRINT("d");
-					}
-					else {
-						SDC_PRINT("D");			// zwei Nibble im letzten Byte übergeben ungerade 
-					}
-
-					for (uint8_t i = 0; i <= message.bytecount; i++) {
-						message.getByte(i, &n);
-						SDC_PRINT(n);
-					}
-
-					n = sprintf(buf, ";C%X;", clock);
-					SDC_PRINT(buf);
-					if (_rssiCallback != nullptr)
-					{
-						n = sprintf(buf, "R%X;", rssiValue);
-						SDC_PRINT(buf);
-					}
-
-				}
-				else {
-				
-					SDC_PRINT("MU");  SDC_PRINT(SERIAL_DELIMITER);
-					calcHisto();
-
-					for (uint8_t idx = 0; idx < patternLen; idx++)
-					{
-						if (pattern[idx] == 0 || histo[idx] == 0) continue; 
-						//SDC_PRINT('P'); SDC_PRINT(idx); SDC_PRINT('='); SDC_PRINT(itoa(pattern[idx], buf, 10)); SDC_PRINT(SERIAL_DELIMITER);
-						n = sprintf(buf, "P%i=%i;", idx, pattern[idx]);
-						SDC_PRINT(buf);
-
-					}
-					SDC_PRINT("D=");
-
-					for (uint8_t i = 0; i < messageLen; ++i) 
-					{
-						sprintf(buf, "%d", message[i]); 
-						SDC_PRINT(buf);
-					}
-					//String postamble;
-					/*
-					SDC_PRINT(SERIAL_DELIMITER);
-					SDC_PRINT("CP="); SDC_PRINT(clock);     SDC_PRINT(SERIAL_DELIMITER);    // ClockPulse, (not valid for manchester)
-					SDC_PRINT("R=");  SDC_PRINT(rssiValue); SDC_PRINT(SERIAL_DELIMITER);     // Signal Level (RSSI)
-					*/
-					n = sprintf(buf, ";CP=%i;", clock);
-					SDC_PRINT(buf);
-					if (_rssiCallback != nullptr)
-					{
-						n = sprintf(buf, "R=%i;", rssiValue);
-						SDC_PRINT(buf);
-					}
-				}
-
-
-				if (m_overflow) {
-					SDC_PRINT("O");  SDC_PRINT(SERIAL_DELIMITER);
-				}
-
-				SDC_PRINT(MSG_END);
-				SDC_PRINT(char(0xA));
+				printMU();
 				
 				m_truncated = false;
 				success = true;
@@ -827,7 +737,7 @@ MUOutput:
 					}
 				}
 			}
-			for (uint8_t i = 0; i < messageLen && dp <2000; i++)
+			for (Index i = 0; i < messageLen && dp <2000; i++)
 			{
 				if (message[i] == dp) // Finde den letzten Verweis im Array auf den Index der gleich ueberschrieben wird
 				{
@@ -853,12 +763,58 @@ MUOutput:
 	//SDC_PRINTLN("process finished");
 }
 
+/*
+*	A manchester signal which is longer than the message buffer: doDecode locked the clock (longlow .. shorthigh) and decoded the buffer.
+*	The following pulses are not buffered and scanned again, mcStream passes each of them to the decoder as it arrives and the
+*	message is printed with the first pulse which does not fit, the end of the transmission.
+*/
+template<uint16_t msgSize, uint8_t numPattern, class Index>
+void SignalDetector<msgSize, numPattern, Index>::mcStreamBegin()
+{
+	bool fits = true;
+	for (Index i = 0; i < messageLen && fits; i++)	// Pulses doDecode left in the buffer
+		fits = mcdecoder->addPulse(message[i]);
+
+	message.reset();
+	messageLen = message.valcount;
+	for (uint8_t i = 0; i < numPattern; ++i)
+		histo[i] = 0;
+	m_truncated = true;	// Preserve anything else like pattern and so on.
+	last = nullptr;
 
+	if (fits)
+		mcdecoder->streaming = true;
+	else
+		mcStreamEnd();
+}
 
+template<uint16_t msgSize, uint8_t numPattern, class Index>
+bool SignalDetector<msgSize, numPattern, Index>::mcStream()
+{
+	const int8_t fidx = findpatt(*first);
+	if (fidx >= 0 && mcdecoder->addPulse(fidx))
+	{
+		updPattern(fidx);
+		return true;
+	}
+	mcStreamEnd();
+	return false;		// The pulse is processed as the begin of a new signal
+}
 
+template<uint16_t msgSize, uint8_t numPattern, class Index>
+void SignalDetector<msgSize, numPattern, Index>::mcStreamEnd()
+{
+	const bool found = mcdecoder->ManchesterBits.valcount >= mcdecoder->minbitlen;
+	if (found)
+		printMC();
+	reset();
+	mcdecoder->reset();
+	success = found;
+}
 
 
-void SignalDetectorClass::reset()
+template<uint16_t msgSize, uint8_t numPattern, class Index>
+void SignalDetector<msgSize, numPattern, Index>::reset()
 {
 	patternLen = 0;
 	pattern_pos = 0;
@@ -867,8 +823,9 @@ void SignalDetectorClass::reset()
 	//	bitcnt = 0;
 	state = searching;
 	clock = sync = -1;
-	for (uint8_t i = 0; i<maxNumPattern; ++i)
+	for (uint8_t i = 0; i<numPattern; ++i)
 		histo[i] = pattern[i] = 0;
+	patternIdxCnt = patternPosCnt = 0;
 	success = false;
 	tol = 150; //
 	tolFact = 0.25;
@@ -876,6 +833,8 @@ void SignalDetectorClass::reset()
 	m_truncated = false;
 	m_overflow = false;
 	mcDetected = false;
+	msPart = 0;
+	fingerprint = -1;
 	//SDC_PRINTLN("reset");
 	mend = 0;
 	//DBG_PRINT(":sdres:");
@@ -883,13 +842,74 @@ void SignalDetectorClass::reset()
 	MsMoveCount = 3;
 }
 
-const status SignalDetectorClass::getState()
+template<uint16_t msgSize, uint8_t numPattern, class Index>
+SignalDetector<msgSize, numPattern, Index> &SignalDetector<msgSize, numPattern, Index>::operator=(const SignalDetector &src)
+{
+	if (this == &src)
+		return *this;
+	clock = src.clock;
+	MUenabled = src.MUenabled;
+	MCenabled = src.MCenabled;
+	MSenabled = src.MSenabled;
+	MredEnabled = src.MredEnabled;
+	MbinEnabled = src.MbinEnabled;
+	MdedupEnabled = src.MdedupEnabled;
+	outputFormats = src.outputFormats;
+	MsMoveCount = src.MsMoveCount;
+	memcpy(histo, src.histo, sizeof(histo));
+	manchester = src.manchester;
+	manchester.pdec = this;
+	mcdecoder = src.mcdecoder == &src.manchester ? &manchester : src.mcdecoder;	// An injected decoder is shared
+	messageLen = src.messageLen;
+	mstart = src.mstart;
+	mend = src.mend;
+	success = src.success;
+	m_truncated = src.m_truncated;
+	m_overflow = src.m_overflow;
+	tol = src.tol;
+	state = src.state;
+	memcpy(buffer, src.buffer, sizeof(buffer));
+	first = buffer;
+	last = src.last != nullptr ? pattern + (src.last - src.pattern) : nullptr;
+	message = src.message;
+	tolFact = src.tolFact;
+	memcpy(pattern, src.pattern, sizeof(pattern));
+	memcpy(patternLo, src.patternLo, sizeof(patternLo));
+	memcpy(patternHi, src.patternHi, sizeof(patternHi));
+	memcpy(patternIdx, src.patternIdx, sizeof(patternIdx));
+	patternPosCnt = src.patternPosCnt;
+	patternIdxCnt = src.patternIdxCnt;
+	patternLen = src.patternLen;
+	pattern_pos = src.pattern_pos;
+	sync = src.sync;
+	fingerprint = src.fingerprint;
+	churn = src.churn;
+	noiseGate = src.noiseGate;
+	mcDetected = src.mcDetected;
+	msPart = src.msPart;
+	mcMinBitLen = src.mcMinBitLen;
+	rssiValue = src.rssiValue;
+	_rssiCallback = src._rssiCallback;
+	_streamCallback = src._streamCallback;
+	frame = src.frame;
+	msgTag = src.msgTag;
+	repeats = src.repeats;
+	msgHash = src.msgHash;
+#if decoderCounters
+	counters = src.counters;
+#endif
+	return *this;
+}
+
+template<uint16_t msgSize, uint8_t numPattern, class Index>
+const status SignalDetector<msgSize, numPattern, Index>::getState()
 {
 	return status();
 }
 
 
-const bool SignalDetectorClass::inTol(const int val, const int set, const int tolerance)
+template<uint16_t msgSize, uint8_t numPattern, class Index>
+const bool SignalDetector<msgSize, numPattern, Index>::inTol(const int val, const int set, const int tolerance)
 {
 	
 	// tolerance = tolerance == 0 ? tol : tolerance;
@@ -897,7 +917,8 @@ const bool SignalDetectorClass::inTol(const int val, const int set, const int to
 	return (abs(val - set) <= tolerance);
 }
 
-void SignalDetectorClass::printOut()
+template<uint16_t msgSize, uint8_t numPattern, class Index>
+void SignalDetector<msgSize, numPattern, Index>::printOut()
 {
 #ifdef DEBUG
 	DBG_PRINTLN("");
@@ -926,7 +947,7 @@ void SignalDetectorClass::printOut()
 
 
 	DBG_PRINTLN(); DBG_PRINT("Signal: ");
-	uint8_t idx;
+	Index idx;
 	for (idx = 0; idx<messageLen; ++idx) {
 		const char c = message.getValue(idx) + '0';
 		DBG_PRINT(c);
@@ -949,7 +970,8 @@ void SignalDetectorClass::printOut()
 #endif
 }
 
-const size_t SignalDetectorClass::write(const uint8_t *buf, size_t size)
+template<uint16_t msgSize, uint8_t numPattern, class Index>
+const size_t SignalDetector<msgSize, numPattern, Index>::write(const uint8_t *buf, size_t size)
 {
 	if (_streamCallback == nullptr)
 		return 0;
@@ -957,7 +979,8 @@ const size_t SignalDetectorClass::write(const uint8_t *buf, size_t size)
 }
 
 
-const size_t SignalDetectorClass::write(const char *str) {
+template<uint16_t msgSize, uint8_t numPattern, class Index>
+const size_t SignalDetector<msgSize, numPattern, Index>::write(const char *str) {
 	if (str == nullptr)
 		return 0;
 	return write((const uint8_t*)str, strlen(str));
@@ -965,25 +988,608 @@ const size_t SignalDetectorClass::write(const char *str) {
 
 
 
-const size_t SignalDetectorClass::write(uint8_t b)
+template<uint16_t msgSize, uint8_t numPattern, class Index>
+const size_t SignalDetector<msgSize, numPattern, Index>::write(uint8_t b)
 {
 	return write(&b, 1);
 }
 
-int8_t SignalDetectorClass::findpatt(const int val)
+// Identifies repeats of a message: pattern indices, pattern values rounded to 128 us and the data
+template<uint16_t msgSize, uint8_t numPattern, class Index>
+uint16_t SignalDetector<msgSize, numPattern, Index>::messageHash(const char type, const Index *usedHisto, const Index first, const Index last)
+{
+	uint16_t hash = crc16(0xFFFF, type);
+	hash = crc16(crc16(hash, clock), sync);
+	for (uint8_t idx = 0; idx < patternLen; idx++)
+	{
+		if (pattern[idx] == 0 || usedHisto[idx] == 0) continue;
+		const int rounded = pattern[idx] / 128;
+		hash = crc16(crc16(crc16(hash, idx), lowByte(rounded)), highByte(rounded));
+	}
+	for (uint16_t i = first; i <= last; i++)
+		hash = crc16(hash, message[i]);
+	return hash;
+}
+
+template<uint16_t msgSize, uint8_t numPattern, class Index>
+void SignalDetector<msgSize, numPattern, Index>::endMessage(const bool binary)
+{
+	if (MdedupEnabled && msPart == 0 && repeats.fold(frame, msgHash, binary, msgTag))
+		return;
+	if (binary)
+		frame.endBinary();
+	else
+		frame.end(msgTag);
+}
+
+template<uint16_t msgSize, uint8_t numPattern, class Index>
+void SignalDetector<msgSize, numPattern, Index>::printPatterns(const Index *usedHisto, const bool reduced)
+{
+	for (uint8_t idx = 0; idx < patternLen; idx++)
+	{
+		if (pattern[idx] == 0 || usedHisto[idx] == 0) continue;
+		if (reduced) {
+			uint8_t patternIdx;
+			int patternInt = pattern[idx];
+
+			if (patternInt < 0) {
+				patternIdx = idx | 0xA0;    // Bit5 = 1 (Vorzeichen negativ)
+				patternInt = -patternInt;
+			}
+			else {
+				patternIdx = idx | 0x80;    // Bit5 = 0 (Vorzeichen positiv)
+			}
+
+			uint8_t patternLow = lowByte(patternInt);
+			if (bitRead(patternLow, (uint8_t)7) == 0) {
+				bitSet(patternLow, (uint8_t)7);
+			}
+			else {
+				bitSet(patternIdx, (uint8_t)4);   // wenn bei patternLow Bit7 gesetzt ist, dann bei patternIdx Bit4 = 1
+			}
+			frame.add(patternIdx);
+			frame.add(patternLow);
+			frame.add(highByte(patternInt) | 0x80);
+		}
+		else {
+			frame.add('P'); frame.addInt(idx); frame.add('='); frame.addInt(pattern[idx]);
+		}
+		frame.add(SERIAL_DELIMITER);
+	}
+}
+
+template<uint16_t msgSize, uint8_t numPattern, class Index>
+void SignalDetector<msgSize, numPattern, Index>::printMS(const Index *msgHisto, const bool msMove)
+{
+	PROFILE_STAGE(prfOutput);
+	const uint8_t formats = messageFormats();
+	COUNT_DECODER(msMsgs);
+	if (MdedupEnabled)
+		msgHash = messageHash('S', msgHisto, mstart, mend);
+	for (uint8_t format = fmtVerbose; format <= fmtBinary; format++) {
+		if (formats & (1 << format)) {
+			frame.formats = 1 << format;
+			printMS(MessageFormat(format), msgHisto, msMove);
+		}
+	}
+}
+
+template<uint16_t msgSize, uint8_t numPattern, class Index>
+void SignalDetector<msgSize, numPattern, Index>::printMS(const MessageFormat format, const Index *msgHisto, const bool msMove)
+{
+	if (format == fmtBinary) {
+		printBinary('S', msgHisto, mstart, mend, msMove);
+		return;
+	}
+	frame.add(MSG_START);
+	if (format == fmtReduced) {
+		uint8_t n;
+		Index start = mstart;
+
+		frame.add("Ms;");
+		printPatterns(msgHisto, format == fmtReduced);
+		if ((mend & 1) == 1) {   // zwei Nibble im letzten Byte bergeben
+			frame.add('D');
+		}
+		else {
+			frame.add('d');     // ein Nibble im letzten Byte bergeben
+		}
+		if ((start & 1) == 1) {  // ungerade Startposition
+			start--;
+			message.getByte(start / 2, &n);
+			n = (n & 15) | 128;             // high nibble = 8 als Kennzeichen fr ungeraden mstart
+			frame.add(n);
+			start += 2;
+		}
+		for (Index i = start; i <= mend; i = i + 2) {
+			message.getByte(i / 2, &n);
+			frame.add(n);
+		}
+
+		frame.add(";C"); frame.addHex(clock); frame.add(";S"); frame.addHex(sync); frame.add(SERIAL_DELIMITER);
+		if (_rssiCallback != nullptr)
+		{
+			frame.add('R'); frame.addHex(rssiValue); frame.add(SERIAL_DELIMITER);
+		}
+	}
+	else {
+		frame.add("MS;");
+		printPatterns(msgHisto, format == fmtReduced);
+		frame.add("D=");
+		for (Index i = mstart; i <= mend; i++)
+			frame.addInt(message[i]);
+
+		frame.add(";CP="); frame.addInt(clock); frame.add(";SP="); frame.addInt(sync); frame.add(SERIAL_DELIMITER);
+		if (_rssiCallback != nullptr)
+		{
+			frame.add("R="); frame.addInt(rssiValue); frame.add(SERIAL_DELIMITER);
+		}
+	}
+	if (m_overflow) {
+		frame.add("O;");
+	}
+	if (msMove) {
+		frame.add('m'); frame.addInt(MsMoveCount - 1); frame.add(SERIAL_DELIMITER);
+	}
+	if (msPart > 1) {
+		frame.add("c="); frame.addInt(msPart - 1); frame.add(SERIAL_DELIMITER);
+	}
+	endMessage(false);
+}
+
+template<uint16_t msgSize, uint8_t numPattern, class Index>
+void SignalDetector<msgSize, numPattern, Index>::printMU()
+{
+	PROFILE_STAGE(prfOutput);
+	const uint8_t formats = messageFormats();
+	COUNT_DECODER(muMsgs);
+	if (MdedupEnabled)
+		msgHash = messageHash('U', histo, 0, messageLen - 1);
+	for (uint8_t format = fmtVerbose; format <= fmtBinary; format++) {
+		if (formats & (1 << format)) {
+			frame.formats = 1 << format;
+			printMU(MessageFormat(format));
+		}
+	}
+}
+
+template<uint16_t msgSize, uint8_t numPattern, class Index>
+void SignalDetector<msgSize, numPattern, Index>::printMU(const MessageFormat format)
+{
+	if (format == fmtBinary) {
+		printBinary('U', histo, 0, messageLen - 1, false);
+		return;
+	}
+	frame.add(MSG_START);
+	if (format == fmtReduced) {
+		uint8_t n;
+
+		frame.add("Mu;");
+		printPatterns(histo, format == fmtReduced);
+		if ((messageLen & 1) == 1) {  // ein Nibble im letzten Byte bergeben ungerade 
+			frame.add('d');
+		}
+		else {
+			frame.add('D');			// zwei Nibble im letzten Byte bergeben ungerade 
+		}
+		for (Index i = 0; i <= message.bytecount; i++) {
+			message.getByte(i, &n);
+			frame.add(n);
+		}
+
+		frame.add(";C"); frame.addHex(clock); frame.add(SERIAL_DELIMITER);
+		if (_rssiCallback != nullptr)
+		{
+			frame.add('R'); frame.addHex(rssiValue); frame.add(SERIAL_DELIMITER);
+		}
+	}
+	else {
+		frame.add("MU;");
+		printPatterns(histo, format == fmtReduced);
+		frame.add("D=");
+		for (Index i = 0; i < messageLen; ++i)
+			frame.addInt(message[i]);
+
+		frame.add(";CP="); frame.addInt(clock); frame.add(SERIAL_DELIMITER);
+		if (_rssiCallback != nullptr)
+		{
+			frame.add("R="); frame.addInt(rssiValue); frame.add(SERIAL_DELIMITER);
+		}
+	}
+	if (m_overflow) {
+		frame.add("O;");
+	}
+	endMessage(false);
+}
+
+template<uint16_t msgSize, uint8_t numPattern, class Index>
+void SignalDetector<msgSize, numPattern, Index>::printMC()
+{
+	PROFILE_STAGE(prfOutput);
+	const uint8_t formats = messageFormats();
+	COUNT_DECODER(mcMsgs);
+	if (MdedupEnabled) {
+		const int8_t used[4] = { mcdecoder->longlow, mcdecoder->longhigh, mcdecoder->shortlow, mcdecoder->shorthigh };
+		msgHash = crc16(0xFFFF, 'C');
+		for (uint8_t i = 0; i < 4; i++) {
+			const int rounded = pattern[used[i]] / 128;
+			msgHash = crc16(crc16(msgHash, lowByte(rounded)), highByte(rounded));
+		}
+		const uint16_t bitCnt = mcdecoder->ManchesterBits.valcount;
+		msgHash = crc16(crc16(msgHash, lowByte(bitCnt)), highByte(bitCnt));
+		for (Index idx = 0; idx < (bitCnt + 7) / 8; idx++)
+			msgHash = crc16(msgHash, mcdecoder->getMCByte(idx));
+	}
+	if (formats & ~(1 << fmtBinary)) {
+		frame.formats = formats & ~(1 << fmtBinary);
+		printMCText();
+	}
+	if (formats & (1 << fmtBinary)) {
+		frame.formats = 1 << fmtBinary;
+		printBinaryMC();
+	}
+}
+
+template<uint16_t msgSize, uint8_t numPattern, class Index>
+void SignalDetector<msgSize, numPattern, Index>::printMCText()
+{
+	frame.add(MSG_START);
+	frame.add("MC;LL="); frame.addInt(pattern[mcdecoder->longlow]);
+	frame.add(";LH="); frame.addInt(pattern[mcdecoder->longhigh]);
+	frame.add(";SL="); frame.addInt(pattern[mcdecoder->shortlow]);
+	frame.add(";SH="); frame.addInt(pattern[mcdecoder->shorthigh]);
+	frame.add(";D="); mcdecoder->printMessageHexStr();
+	frame.add(";C="); frame.addInt(mcdecoder->clock);
+	frame.add(";L="); frame.addInt(mcdecoder->ManchesterBits.valcount); frame.add(SERIAL_DELIMITER);
+	if (_rssiCallback != nullptr)
+	{
+		frame.add("R="); frame.addInt(rssiValue); frame.add(SERIAL_DELIMITER);
+	}
+	endMessage(false);
+}
+
+template<uint16_t msgSize, uint8_t numPattern, class Index>
+void SignalDetector<msgSize, numPattern, Index>::printBinary(const char type, const Index *usedHisto, const Index first, const Index last, const bool msMove)
+{
+	uint8_t mask = 0;
+	uint8_t patternCnt = 0;
+	for (uint8_t idx = 0; idx < patternLen; idx++)
+	{
+		if (pattern[idx] == 0 || usedHisto[idx] == 0) continue;
+		mask |= 1 << idx;
+		patternCnt++;
+	}
+	const uint8_t valCnt = last - first + 1;
+	const uint8_t tagLen = (msgTag != nullptr) ? strlen(msgTag) : 0;
+
+	uint8_t flags = 0;
+	if (m_overflow) flags |= MSG_BIN_OVERFLOW;
+	if (_rssiCallback != nullptr) flags |= MSG_BIN_RSSI;
+	if (msMove) flags |= MSG_BIN_MOVED | ((MsMoveCount - 1) << 4);
+	if (tagLen > 0) flags |= MSG_BIN_TAG;
+	if (type == 'S' && msPart > 1) flags |= MSG_BIN_CONTINUED;
+
+	frame.beginBinary(2 + 1 + patternCnt * 2 + 1 + (type == 'S') + 1 + (valCnt + 1) / 2
+		+ ((flags & MSG_BIN_RSSI) ? 1 : 0) + ((flags & MSG_BIN_CONTINUED) ? 1 : 0) + (tagLen > 0 ? tagLen + 1 : 0));
+	frame.addChecked(uint8_t(type));
+	frame.addChecked(flags);
+	frame.addChecked(mask);
+	for (uint8_t idx = 0; idx < patternLen; idx++)
+	{
+		if (mask & (1 << idx))
+			frame.addChecked(int16_t(pattern[idx]));
+	}
+	frame.addChecked(uint8_t(clock));
+	if (type == 'S')
+		frame.addChecked(uint8_t(sync));
+	frame.addChecked(valCnt);
+	for (uint16_t i = first; i <= last; i += 2)
+	{
+		uint8_t b = message[i] << 4;
+		if (i < last)
+			b |= message[i + 1];
+		frame.addChecked(b);
+	}
+	if (flags & MSG_BIN_RSSI)
+		frame.addChecked(rssiValue);
+	if (flags & MSG_BIN_CONTINUED)
+		frame.addChecked(uint8_t(msPart - 1));
+	if (tagLen > 0) {
+		frame.addChecked(tagLen);
+		for (uint8_t i = 0; i < tagLen; i++)
+			frame.addChecked(uint8_t(msgTag[i]));
+	}
+	endMessage(true);
+}
+
+template<uint16_t msgSize, uint8_t numPattern, class Index>
+void SignalDetector<msgSize, numPattern, Index>::printBinaryMC()
+{
+	const uint16_t bitCnt = mcdecoder->ManchesterBits.valcount;
+	const uint8_t byteCnt = (bitCnt + 7) / 8;
+	const uint8_t tagLen = (msgTag != nullptr) ? strlen(msgTag) : 0;
+
+	uint8_t flags = 0;
+	if (m_overflow) flags |= MSG_BIN_OVERFLOW;
+	if (_rssiCallback != nullptr) flags |= MSG_BIN_RSSI;
+	if (tagLen > 0) flags |= MSG_BIN_TAG;
+
+	frame.beginBinary(2 + 5 * 2 + 2 + byteCnt + ((flags & MSG_BIN_RSSI) ? 1 : 0) + (tagLen > 0 ? tagLen + 1 : 0));
+	frame.addChecked(uint8_t('C'));
+	frame.addChecked(flags);
+	frame.addChecked(int16_t(pattern[mcdecoder->longlow]));
+	frame.addChecked(int16_t(pattern[mcdecoder->longhigh]));
+	frame.addChecked(int16_t(pattern[mcdecoder->shortlow]));
+	frame.addChecked(int16_t(pattern[mcdecoder->shorthigh]));
+	frame.addChecked(int16_t(mcdecoder->clock));
+	frame.addChecked(bitCnt);
+	for (Index idx = 0; idx < byteCnt; idx++)
+	{
+		uint8_t b = mcdecoder->getMCByte(idx);
+		if (idx == byteCnt - 1 && (bitCnt & 7) != 0)
+			b &= 0xFF << (8 - (bitCnt & 7));		// unused bits of the last byte are 0
+		frame.addChecked(b);
+	}
+	if (flags & MSG_BIN_RSSI)
+		frame.addChecked(rssiValue);
+	if (tagLen > 0) {
+		frame.addChecked(tagLen);
+		for (uint8_t i = 0; i < tagLen; i++)
+			frame.addChecked(uint8_t(msgTag[i]));
+	}
+	endMessage(true);
+}
+
+//============================== MessageFrame =========================================
+
+void MessageFrame::add(const char *str)
+{
+	while (*str)
+		add(uint8_t(*str++));
+}
+
+void MessageFrame::addInt(const int val)
+{
+	char digits[10];
+	uint8_t n = 0;
+	unsigned int u = val;
+	if (val < 0) {
+		add('-');
+		u = 0U - u;
+	}
+	do {
+		digits[n++] = '0' + u % 10;
+		u /= 10;
+	} while (u > 0);
+	while (n > 0)
+		add(digits[--n]);
+}
+
+void MessageFrame::addHex(unsigned int val, const uint8_t digits)
+{
+	char hex[8];
+	uint8_t n = 0;
+	do {
+		hex[n++] = "0123456789ABCDEF"[val & 0xF];
+		val >>= 4;
+	} while (val > 0 || n < digits);
+	while (n > 0)
+		add(hex[--n]);
+}
+
+void MessageFrame::end(const char *tag)
+{
+	if (tag != nullptr)
+		add(tag);
+	add(MSG_END);
+	add(char(0xA));
+	flush();
+}
+
+void MessageFrame::beginBinary(const uint8_t length)
+{
+	add(MSG_BIN);
+	crc = 0xFFFF;
+	addChecked(length);
+}
+
+void MessageFrame::endBinary()
+{
+	const uint16_t sum = crc;
+	add(highByte(sum));
+	add(lowByte(sum));
+	flush();
+}
+
+void MessageFrame::flush(const bool more)
+{
+	if (len > 0)
+		pass(buf, len, more ? formats | fmtMore : formats);
+	len = 0;
+	parted = more;
+}
+
+void MessageFrame::pass(const uint8_t *data, const uint8_t n, const uint8_t fmts)
+{
+	if (formatOutput != nullptr)
+		formatOutput(data, n, fmts);
+	else if (output != nullptr)
+		output(data, n);
+}
+
+uint8_t MessageFrame::take(uint8_t *dest)
+{
+	const uint8_t n = len;
+	memcpy(dest, buf, n);
+	discard();
+	return n;
+}
+
+//============================== DecoderProfile =========================================
+
+#ifdef PROFILE
+PROFILE_TLS ProfileEntry DecoderProfile::table[prfStageCnt];
+const char *const DecoderProfile::stageName[prfStageCnt] = { "doDetect", "processMessage", "compress_pattern", "getClock", "getSync", "isManchester", "doDecode", "output" };
+#if defined(WIN32) || defined(__linux__)
+const char *const DecoderProfile::unit = "ns";
+#else
+const char *const DecoderProfile::unit = "us";
+#endif
+
+void DecoderProfile::clear()
+{
+	for (uint8_t i = 0; i < prfStageCnt; i++)
+		table[i].count = table[i].total = table[i].max = 0;
+}
+
+void DecoderProfile::dump(Output out)
 {
-	//seq[0] = Laenge  //seq[1] = 1. Eintrag //seq[2] = 2. Eintrag ...
-	// Iterate over patterns (1 dimension of array)
-	tol = abs(val)*0.2;
-	for (uint8_t idx = 0; idx<patternLen; ++idx)
+	for (uint8_t i = 0; i < prfStageCnt; i++)
 	{
-		if ((val ^ pattern[idx]) >> 15)
+		// Copied first, the decoder may add while the line is written
+		const ProfileEntry e = table[i];
+		const char *field[3] = { ": count=", ";total=", ";max=" };
+		const ProfileTicks value[3] = { e.count, e.total, e.max };
+		char line[112];
+		uint8_t n = 0;
+		for (const char *c = stageName[i]; *c; c++) line[n++] = *c;
+		for (uint8_t f = 0; f < 3; f++)
+		{
+			for (const char *c = field[f]; *c; c++) line[n++] = *c;
+			char digits[20];
+			uint8_t d = 0;
+			ProfileTicks v = value[f];
+			do {
+				digits[d++] = '0' + v % 10;
+				v /= 10;
+			} while (v > 0);
+			while (d > 0) line[n++] = digits[--d];
+		}
+		for (const char *c = ";unit="; *c; c++) line[n++] = *c;
+		for (const char *c = unit; *c; c++) line[n++] = *c;
+		line[n++] = ';';
+		line[n++] = char(0xA);
+		out((const uint8_t*)line, n);
+	}
+}
+#endif
+
+//============================== RepeatCache =========================================
+#if repeatSlots > 0
+
+bool RepeatCache::fold(MessageFrame &frame, const uint16_t hash, const bool binary, const char *tag)
+{
+	const unsigned long now = millis();
+	if (used > 0)
+		pass(frame, false);
+
+	Slot *oldest = nullptr;
+	Slot *target = nullptr;
+	for (uint8_t i = 0; i < repeatSlots; i++)
+	{
+		Slot &s = slot[i];
+		if (s.len == 0) {
+			if (target == nullptr) target = &s;
 			continue;
-		if (pattern[idx] != 0 && inTol(val, pattern[idx],tol))  // Skip this iteration, if seq[x] <> pattern[idx][x]
-									   //if (!inTol(seq[x],pattern[idx][x-1]))  // Skip this iteration, if seq[x] <> pattern[idx][x]
+		}
+		if (s.hash == hash && s.formats == frame.formats && s.binary == binary) {
+			if (s.count < 255) s.count++;
+			s.time = now;
+			frame.discard();
+			return true;
+		}
+		if (oldest == nullptr || now - s.time > now - oldest->time)
+			oldest = &s;
+	}
+
+	// Room for the repeat count and the end of the message
+	const uint8_t tail = binary ? 1 + 2 : 6 + (tag != nullptr ? strlen(tag) : 0) + 2;
+	if (frame.parted || frame.len + tail > maxFrameSize)
+		return false;
+	if (target == nullptr) {
+		pass(frame, *oldest);
+		target = oldest;
+	}
+	target->len = frame.take(target->buf);
+	target->hash = hash;
+	target->formats = frame.formats;
+	target->binary = binary;
+	target->tag = tag;
+	target->count = 1;
+	target->time = now;
+	used++;
+	return true;
+}
+
+void RepeatCache::pass(MessageFrame &frame, const bool all)
+{
+	const unsigned long now = millis();
+	while (true)		// Oldest first
+	{
+		Slot *oldest = nullptr;
+		for (uint8_t i = 0; i < repeatSlots; i++)
 		{
-			return idx;
+			const Slot &s = slot[i];
+			if (s.len > 0 && (all || now - s.time > repeatWindow) && (oldest == nullptr || now - s.time > now - oldest->time))
+				oldest = &slot[i];
+		}
+		if (oldest == nullptr)
+			return;
+		pass(frame, *oldest);
+	}
+}
+
+// Completes the held message like MessageFrame::end / endBinary, with the repeat count
+void RepeatCache::pass(MessageFrame &frame, Slot &s)
+{
+	if (s.binary) {
+		if (s.count > 1) {
+			s.buf[1]++;						// length
+			s.buf[3] |= MSG_BIN_REPEAT;		// flags
+			s.buf[s.len++] = s.count;
+		}
+		uint16_t crc = 0xFFFF;
+		for (uint8_t i = 1; i < s.len; i++)
+			crc = crc16(crc, s.buf[i]);
+		s.buf[s.len++] = highByte(crc);
+		s.buf[s.len++] = lowByte(crc);
+	}
+	else {
+		if (s.count > 1) {
+			s.buf[s.len++] = 'r';
+			s.buf[s.len++] = '=';
+			if (s.count >= 100) s.buf[s.len++] = '0' + s.count / 100;
+			if (s.count >= 10) s.buf[s.len++] = '0' + s.count / 10 % 10;
+			s.buf[s.len++] = '0' + s.count % 10;
+			s.buf[s.len++] = SERIAL_DELIMITER;
 		}
+		if (s.tag != nullptr) {
+			for (const char *t = s.tag; *t; t++)
+				s.buf[s.len++] = *t;
+		}
+		s.buf[s.len++] = MSG_END;
+		s.buf[s.len++] = char(0xA);
+	}
+	frame.pass(s.buf, s.len, s.formats);
+	s.len = 0;
+	used--;
+}
+#endif
+
+template<uint16_t msgSize, uint8_t numPattern, class Index>
+int8_t SignalDetector<msgSize, numPattern, Index>::findpatt(const int val)
+{
+	// Only patterns with the same sign as val are checked, in ascending order like before
+#if DEBUGDETECT > 3
+	tol = abs(val) / 5;
+#endif
+	uint8_t i = (val < 0) ? patternPosCnt : 0;
+	const uint8_t end = (val < 0) ? patternIdxCnt : patternPosCnt;
+	for (; i < end; ++i)
+	{
+		const uint8_t idx = patternIdx[i];
+		if (val >= patternLo[idx] && val <= patternHi[idx])
+			return idx;
 	}
 	// sequence was not found in pattern
 	return -1;
@@ -995,14 +1601,36 @@ bool SignalDecoderClass::validSequence(const int * a, const int * b)
 }
 */
 
-void SignalDetectorClass::calcHisto(const uint8_t startpos, uint8_t endpos)
+template<uint16_t msgSize, uint8_t numPattern, class Index>
+void SignalDetector<msgSize, numPattern, Index>::calcHisto()
 {
-	if (messageLen == 0) return;
+	calcHisto(histo, 0, messageLen);
+}
 
-	for (uint8_t i = 0; i<maxNumPattern; ++i)
+template<uint16_t msgSize, uint8_t numPattern, class Index>
+const bool SignalDetector<msgSize, numPattern, Index>::checkHisto()
+{
+	Index recount[numPattern];
+	calcHisto(recount, 0, messageLen);
+	for (uint8_t i = 0; i < numPattern; ++i)
 	{
-		histo[i] = 0;
+		if (recount[i] != histo[i])
+		{
+			DBG_PRINT(__FUNCTION__); DBG_PRINT(" mismatch idx "); DBG_PRINT(i); DBG_PRINT(" "); DBG_PRINT(histo[i]); DBG_PRINT("<>"); DBG_PRINTLN(recount[i]);
+			return false;
+		}
+	}
+	return true;
+}
+
+template<uint16_t msgSize, uint8_t numPattern, class Index>
+void SignalDetector<msgSize, numPattern, Index>::calcHisto(Index *dest, const Index startpos, Index endpos)
+{
+	for (uint8_t i = 0; i<numPattern; ++i)
+	{
+		dest[i] = 0;
 	}
+	if (messageLen == 0) return;
 
 	if (endpos == 0) endpos = messageLen;
 	/*for (uint8_t i = startpos; i < endpos; i++) 
@@ -1014,25 +1642,27 @@ void SignalDetectorClass::calcHisto(const uint8_t startpos, uint8_t endpos)
 	if (startpos % 2 == 1)  // ungerade
 	{
 		message.getByte(bstartpos, &bval);
-		histo[bval & 0XF]++;
+		dest[bval & 0XF]++;
 		bstartpos++;
 	}
-	for (uint8_t i = bstartpos; i<bendpos; ++i)
+	for (Index i = bstartpos; i<bendpos; ++i)
 	{
 		message.getByte(i,&bval);
-		histo[bval >> 4]++;
-		histo[bval & 0xF]++; //Todo: 0x7
+		dest[bval >> 4]++;
+		dest[bval & 0xF]++; //Todo: 0x7
 	}
 	if (endpos % 2 == 1)
 	{
 		message.getByte(bendpos, &bval);
-		histo[bval >> 4]++;
+		dest[bval >> 4]++;
 	}
 	
 }
 
-bool SignalDetectorClass::getClock()
+template<uint16_t msgSize, uint8_t numPattern, class Index>
+bool SignalDetector<msgSize, numPattern, Index>::getClock()
 {
+	PROFILE_STAGE(prfClock);
 	// Durchsuchen aller Musterpulse und prueft ob darin eine clock vorhanden ist
 #if DEBUGDETECT > 3
 	SDC_PRINTLN("  --  Searching Clock in signal -- ");
@@ -1069,8 +1699,10 @@ bool SignalDetectorClass::getClock()
 	return true;
 }
 
-bool SignalDetectorClass::getSync()
+template<uint16_t msgSize, uint8_t numPattern, class Index>
+bool SignalDetector<msgSize, numPattern, Index>::getSync()
 {
+	PROFILE_STAGE(prfSync);
 	// Durchsuchen aller Musterpulse und prueft ob darin ein Sync Faktor enthalten ist. Anschließend wird verifiziert ob dieser Syncpuls auch im Signal nacheinander uebertragen wurde
 	//
 #if DEBUGDETECT > 3
@@ -1081,14 +1713,16 @@ bool SignalDetectorClass::getSync()
 		
 		const uint8_t syncLenMax = 125; 		      //  wenn in den ersten ca 125 Pulsen kein Sync gefunden wird, dann ist es kein MS Signal
 		const uint8_t max_search = sd_min(syncLenMax, messageLen - minMessageLen);
+		const uint8_t passes = messageLen == msgSize ? 2 : 1;	// A message longer than the full buffer has only one sync in it
 
+		for (uint8_t pass = 0; pass < passes; pass++)
 		for (int8_t p = patternLen - 1; p >= 0; --p)  // Schleife fuer langen Syncpuls
 		{
 			uint16_t syncabs = abs(pattern[p]);
 			if ((pattern[p] < 0) &&
 				(syncabs < syncMaxMicros && syncabs / pattern[clock] <= syncMaxFact) &&
 				(syncabs > syncMinFact*pattern[clock]) &&
-				(histo[p] < messageLen*0.08) && (histo[p] > 1)
+				(histo[p] < messageLen*0.08) && (pass == 0 ? histo[p] > 1 : histo[p] == 1)
 				)
 			{
 
@@ -1096,7 +1730,7 @@ bool SignalDetectorClass::getSync()
 				uint8_t c = 0;
 				while (c < max_search)
 				{
-					if (message[c + 1] == p && message[c] == clock) {
+					if (message[c + 1] == p && message[c] == clock && (pass == 0 || clockEnd(c + 2) == messageLen)) {
 						sync = p;
 						state = syncfound;
 						mstart = c;
@@ -1123,6 +1757,86 @@ bool SignalDetectorClass::getSync()
 	return false;
 }
 
+const MsFingerprint msFingerprints[msFingerprintCount] PROGMEM = {
+	//	clock us	sync	high low
+	{ 380,  600,	15, 21,	1, 3 },		// Weather sensors, bits 1:4 / 1:8, sync 1:16 .. 1:20 (NC-WS, s522)
+	{ 280,  420,	28, 34,	2, 3 },		// PT2262 / EV1527 remotes, bits 1:3 / 3:1, sync 1:31
+	{ 200,  300,	38, 44,	2, 3 },		// Remotes with bits 1:4 / 4:1, sync 1:41
+	{ 280,  380,	13, 17,	2, 3 },		// Heidemann doorbells, bits 1:2 / 2:1, sync 1:15
+};
+
+static inline void readFingerprint(MsFingerprint *dest, const MsFingerprint *src)
+{
+#if defined(__AVR__) || defined(ESP8266)
+	memcpy_P(dest, src, sizeof(MsFingerprint));
+#else
+	*dest = *src;
+#endif
+}
+
+template<uint16_t msgSize, uint8_t numPattern, class Index>
+bool SignalDetector<msgSize, numPattern, Index>::matchFingerprint()
+{
+	fingerprint = -1;
+	// The shortest high pattern is the clock, the longest low one the sync
+	int8_t clk = -1;
+	int8_t syn = -1;
+	uint8_t highCnt = 0;
+	uint8_t lowCnt = 0;
+	for (uint8_t i = 0; i < patternLen; i++)
+	{
+		if (histo[i] == 0) continue;
+		if (pattern[i] > 0) {
+			highCnt++;
+			if (clk == -1 || pattern[i] < pattern[clk]) clk = i;
+		}
+		else {
+			lowCnt++;
+			if (syn == -1 || pattern[i] < pattern[syn]) syn = i;
+		}
+	}
+	if (clk == -1 || syn == -1 || (histo[syn] > 1 && histo[syn] >= messageLen*0.08)) return false;
+
+	const int clockLen = pattern[clk];
+	const int factor = (-pattern[syn] + clockLen / 2) / clockLen;
+	MsFingerprint fp;
+	for (uint8_t f = 0; f < msFingerprintCount; f++)
+	{
+		readFingerprint(&fp, &msFingerprints[f]);
+		if (highCnt != fp.highPatterns || lowCnt != fp.lowPatterns || clockLen < fp.clockMin || clockLen > fp.clockMax
+			|| factor < fp.syncMin || factor > fp.syncMax)
+			continue;
+
+		const uint8_t max_search = sd_min(125, messageLen - minMessageLen);	// Like getSync
+		for (uint8_t c = 0; c < max_search; c++)
+		{
+			if (message[c] == clk && message[c + 1] == syn) {
+				clock = clk;
+				sync = syn;
+				mstart = c;
+				state = syncfound;
+				fingerprint = f;
+				COUNT_DECODER(fingerprints[f]);
+				return true;
+			}
+		}
+		return false;
+	}
+	return false;
+}
+
+// Position of the first high pulse from pos on which is not the clock, messageLen if there is none
+template<uint16_t msgSize, uint8_t numPattern, class Index>
+Index SignalDetector<msgSize, numPattern, Index>::clockEnd(Index pos)
+{
+	for (; pos < messageLen; pos++)
+	{
+		if (pattern[message[pos]] > 0 && message[pos] != clock)
+			break;
+	}
+	return pos;
+}
+
 /*
 void SignalDetectorClass::printMsgStr(const String * first, const String * second, const String * third)
 {
@@ -1178,7 +1892,8 @@ reset();
 *
 * (documentation goes here)
 */
-ManchesterpatternDecoder::~ManchesterpatternDecoder()
+template<uint16_t msgSize, uint8_t numPattern, class Index>
+ManchesterDecoder<msgSize, numPattern, Index>::~ManchesterDecoder()
 {
 	//delete ManchesterBits->
 
@@ -1190,7 +1905,8 @@ ManchesterpatternDecoder::~ManchesterpatternDecoder()
 *
 * Reset internal vars to defaults. Called after error or when finished
 */
-void ManchesterpatternDecoder::reset()
+template<uint16_t msgSize, uint8_t numPattern, class Index>
+void ManchesterDecoder<msgSize, numPattern, Index>::reset()
 {
 #ifdef DEBUGDECODE
 	DBG_PRINT("mcrst:");
@@ -1202,6 +1918,9 @@ void ManchesterpatternDecoder::reset()
 	
 	mc_start_found = false;
 	mc_sync = false;
+	streaming = false;
+	pendingShort = false;
+	bit = 0;
 
 	clock = 0;
 	//minbitlen = 20; // Set defaults
@@ -1211,7 +1930,8 @@ void ManchesterpatternDecoder::reset()
 *
 * (documentation goes here)
 */
-void ManchesterpatternDecoder::setMinBitLen(const uint8_t len)
+template<uint16_t msgSize, uint8_t numPattern, class Index>
+void ManchesterDecoder<msgSize, numPattern, Index>::setMinBitLen(const uint8_t len)
 {
 	minbitlen = len;
 }
@@ -1221,7 +1941,8 @@ void ManchesterpatternDecoder::setMinBitLen(const uint8_t len)
 *
 * (documentation goes here)
 */
-const bool ManchesterpatternDecoder::isLong(const uint8_t pulse_idx)
+template<uint16_t msgSize, uint8_t numPattern, class Index>
+const bool ManchesterDecoder<msgSize, numPattern, Index>::isLong(const uint8_t pulse_idx)
 {
 	return (pulse_idx == longlow || pulse_idx == longhigh);
 }
@@ -1231,19 +1952,49 @@ const bool ManchesterpatternDecoder::isLong(const uint8_t pulse_idx)
 * (documentation goes here)
 */
 
-const bool ManchesterpatternDecoder::isShort(const uint8_t pulse_idx)
+template<uint16_t msgSize, uint8_t numPattern, class Index>
+const bool ManchesterDecoder<msgSize, numPattern, Index>::isShort(const uint8_t pulse_idx)
 {
 	return (pulse_idx == shortlow || pulse_idx == shorthigh);
 }
 
+/** @brief (Decodes one pulse of a locked signal, returns false if it does not fit or the bit store is full)
+*
+* (Like doDecode: a long pulse inverts the bit, two short pulses shortlow, shorthigh (bit 0) or shorthigh, shortlow (bit 1) repeat it)
+*/
+template<uint16_t msgSize, uint8_t numPattern, class Index>
+const bool ManchesterDecoder<msgSize, numPattern, Index>::addPulse(const int8_t pulse_idx)
+{
+	if (pendingShort)
+	{
+		pendingShort = false;
+		if (pulse_idx != (bit ? shortlow : shorthigh))
+			return false;
+	}
+	else if (isLong(pulse_idx))
+	{
+		bit = bit ^ 1;
+	}
+	else if (pulse_idx == (bit ? shorthigh : shortlow))
+	{
+		pendingShort = true;
+		return true;
+	}
+	else
+		return false;
+
+	return ManchesterBits.addValue(bit);
+}
+
 /** @brief (Converts decoded manchester bits in a provided string as hex)
 *
 * ()
 */
+template<uint16_t msgSize, uint8_t numPattern, class Index>
 #ifdef NOSTRING		
-const char* ManchesterpatternDecoder::getMessageHexStr()
+const char* ManchesterDecoder<msgSize, numPattern, Index>::getMessageHexStr()
 #else
-void ManchesterpatternDecoder::getMessageHexStr(String *message)
+void ManchesterDecoder<msgSize, numPattern, Index>::getMessageHexStr(String *message)
 #endif
 {
 	char hexStr[] = "00" ; // Not really needed
@@ -1255,7 +2006,7 @@ void ManchesterpatternDecoder::getMessageHexStr(String *message)
 	char *message = (char*)malloc((sizeof(char)*ManchesterBits.valcount / 4) + 2);
 	char *mptr=message;
 #endif
-	uint8_t idx;
+	Index idx;
 	// Bytes are stored from left to right in our buffer. We reverse them for better readability
 	for ( idx = 0; idx <= ManchesterBits.bytecount-1; ++idx) {
 		//SDC_PRINT(getMCByte(idx),HEX);
@@ -1308,29 +2059,20 @@ void ManchesterpatternDecoder::getMessageHexStr(String *message)
 *
 * ()
 */
-void ManchesterpatternDecoder::printMessageHexStr()
+template<uint16_t msgSize, uint8_t numPattern, class Index>
+void ManchesterDecoder<msgSize, numPattern, Index>::printMessageHexStr()
 {
-	//char hexStr[] = "00"; // Not really needed
-
-	char cbuffer[3];
-	uint8_t idx;
+	Index idx;
 	// Bytes are stored from left to right in our buffer. We reverse them for better readability
 	for (idx = 0; idx <= ManchesterBits.bytecount - 1; ++idx) {
-		sprintf(cbuffer, "%02X", getMCByte(idx));
-		//SDC_PRINT(hexStr);
-		pdec->write(cbuffer);
+		pdec->frame.addHex(getMCByte(idx), 2);
 	}
 
-	sprintf(cbuffer, "%01X", getMCByte(idx) >> 4 & 0xf);
-	//pdec->write(hexStr);
+	pdec->frame.addHex(getMCByte(idx) >> 4 & 0xf);
 	if (ManchesterBits.valcount % 8 > 4 || ManchesterBits.valcount % 8 == 0)
 	{
-		sprintf(cbuffer +1, "%01X", getMCByte(idx) & 0xF);
-		//SDC_PRINT(hexStr);
-		
+		pdec->frame.addHex(getMCByte(idx) & 0xF);
 	}
-	//pdec->msgPort->print(cbuffer);
-	pdec->write(cbuffer);
 }
 
 
@@ -1339,10 +2081,11 @@ void ManchesterpatternDecoder::printMessageHexStr()
 * (documentation goes here)
 */
 
+template<uint16_t msgSize, uint8_t numPattern, class Index>
 #ifdef NOSTRING		
-const char * ManchesterpatternDecoder::getMessagePulseStr()
+const char * ManchesterDecoder<msgSize, numPattern, Index>::getMessagePulseStr()
 #else
-void ManchesterpatternDecoder::getMessagePulseStr(String* str)
+void ManchesterDecoder<msgSize, numPattern, Index>::getMessagePulseStr(String* str)
 #endif
 {
 #ifdef NOSTRING		
@@ -1373,7 +2116,8 @@ void ManchesterpatternDecoder::getMessagePulseStr(String* str)
 * (documentation goes here)
 */
 
-void ManchesterpatternDecoder::printMessagePulseStr()
+template<uint16_t msgSize, uint8_t numPattern, class Index>
+void ManchesterDecoder<msgSize, numPattern, Index>::printMessagePulseStr()
 {
 	//char cbuffer[50];
 	//sprintf(cbuffer,"LL=%u;LH=%u;SL=%u;SH=%u;", pdec->pattern[longlow], pdec->pattern[longhigh], pdec->pattern[shortlow], pdec->pattern[shorthigh]);
@@ -1390,10 +2134,11 @@ void ManchesterpatternDecoder::printMessagePulseStr()
 * (documentation goes here)
 */
 
+template<uint16_t msgSize, uint8_t numPattern, class Index>
 #ifdef NOSTRING		
-const char * ManchesterpatternDecoder::getMessageClockStr()
+const char * ManchesterDecoder<msgSize, numPattern, Index>::getMessageClockStr()
 #else
-void ManchesterpatternDecoder::getMessageClockStr(String* str)
+void ManchesterDecoder<msgSize, numPattern, Index>::getMessageClockStr(String* str)
 #endif
 {
 #ifdef NOSTRING		
@@ -1414,10 +2159,11 @@ void ManchesterpatternDecoder::getMessageClockStr(String* str)
 	#endif
 }
 
+template<uint16_t msgSize, uint8_t numPattern, class Index>
 #ifdef NOSTRING		
-const char* ManchesterpatternDecoder::getMessageLenStr()
+const char* ManchesterDecoder<msgSize, numPattern, Index>::getMessageLenStr()
 #else
-void ManchesterpatternDecoder::getMessageLenStr(String* str)
+void ManchesterDecoder<msgSize, numPattern, Index>::getMessageLenStr(String* str)
 #endif
 {
 #ifndef NOSTRING		
@@ -1435,7 +2181,8 @@ void ManchesterpatternDecoder::getMessageLenStr(String* str)
 * (Returns a comlete byte from the pattern store)
 */
 
-unsigned char ManchesterpatternDecoder::getMCByte(const uint8_t idx) {
+template<uint16_t msgSize, uint8_t numPattern, class Index>
+unsigned char ManchesterDecoder<msgSize, numPattern, Index>::getMCByte(const Index idx) {
 
 	uint8_t c = 0;
 	ManchesterBits.getByte(idx,&c);
@@ -1450,9 +2197,11 @@ unsigned char ManchesterpatternDecoder::getMCByte(const uint8_t idx) {
 * (Call only after ismanchester returned true)
 */
 
-const bool ManchesterpatternDecoder::doDecode() {
+template<uint16_t msgSize, uint8_t numPattern, class Index>
+const bool ManchesterDecoder<msgSize, numPattern, Index>::doDecode() {
+	PROFILE_STAGE(prfMcDecode);
 	//SDC_PRINT("bitcnt:");SDC_PRINTLN(bitcnt);
-	uint8_t i = 0;
+	Index i = 0;
 	pdec->m_truncated = false;
 	pdec->mstart = 0; // Todo: pruefen ob start aus isManchester uebernommen werden kann
 #ifdef DEBUGDECODE
@@ -1463,7 +2212,6 @@ const bool ManchesterpatternDecoder::doDecode() {
 	DBG_PRINTLN("");
 
 #endif
-	static uint8_t bit = 0; // bit state must be preserved if message goes over the buffer 
 	//bool prelongdecoding = false; // Flag that we are in a decoding bevore the 1. long pulse
 	#ifdef DEBUGDECODE
 	char value = NULL;
@@ -1579,7 +2327,7 @@ const bool ManchesterpatternDecoder::doDecode() {
 						DBG_PRINT((int)pdec->message[i], DEC);
 						//DBG_PRINT(pdec->pattern[pdec->message[i]]);
 #endif
-						if (i == maxMsgSize - 1 && i == pdec->messageLen - 1)
+						if (i == msgSize - 1 && i == pdec->messageLen - 1)
 						{
 							pdec->mcDetected = true;
 							//i--; // Process short later again, do not remove it
@@ -1649,7 +2397,7 @@ const bool ManchesterpatternDecoder::doDecode() {
 	DBG_PRINT(":bfin:");
 #endif
 
-	if (i == maxMsgSize && ManchesterBits.valcount > minbitlen / 2)
+	if (i == msgSize && ManchesterBits.valcount > minbitlen / 2)
 	{
 		// We are at end of buffer but have half or more of the minbitlen, we need to catch some more data
 #ifdef DEBUGDECODE
@@ -1660,7 +2408,7 @@ const bool ManchesterpatternDecoder::doDecode() {
 		return false; // Prevents serial output of data we already have in the buffer
 
 			}
-	else if (i == maxMsgSize)
+	else if (i == msgSize)
 	{
 		// We are at end of buffer, but we haven't much mcdata 
 		pdec->mcDetected = false;
@@ -1679,8 +2427,10 @@ const bool ManchesterpatternDecoder::doDecode() {
 * (Check signal based on patternLen, histogram and pattern store for valid manchester style.Provides key indexes for the 4 signal states for later decoding)
 */
 
-const bool ManchesterpatternDecoder::isManchester()
+template<uint16_t msgSize, uint8_t numPattern, class Index>
+const bool ManchesterDecoder<msgSize, numPattern, Index>::isManchester()
 {
+	PROFILE_STAGE(prfManchester);
 	// Durchsuchen aller Musterpulse und prueft ob darin eine clock vorhanden ist
 #if DEBUGDETECT >= 1
 	DBG_PRINTLN("");
@@ -1697,7 +2447,7 @@ const bool ManchesterpatternDecoder::isManchester()
 	int equal_cnt = 0;
 	const uint8_t minHistocnt = round(pdec->messageLen*0.04);
 	//     3     1    0     2
-	uint8_t sortedPattern[maxNumPattern]; // 1300,-1300,-734,..800
+	uint8_t sortedPattern[numPattern]; // 1300,-1300,-734,..800
 	uint8_t p = 0;
 
 	for (uint8_t i = 0; i < pdec->patternLen; i++)
@@ -1819,8 +2569,9 @@ const bool ManchesterpatternDecoder::isManchester()
 						{
 							pdec->mend = z;
 
-							pdec->calcHisto(pdec->mstart, pdec->mend);
-							equal_cnt = pdec->histo[shorthigh] + pdec->histo[longhigh] - pdec->histo[shortlow] - pdec->histo[longlow];
+							Index mcHisto[numPattern];
+							pdec->calcHisto(mcHisto, pdec->mstart, pdec->mend);
+							equal_cnt = mcHisto[shorthigh] + mcHisto[longhigh] - mcHisto[shortlow] - mcHisto[longlow];
 
 #if DEBUGDETECT >= 1
 							DBG_PRINT("equalcnt: pos "); DBG_PRINT(pdec->mstart); DBG_PRINT(" to ") DBG_PRINT(pdec->mend); DBG_PRINT(" count=");  DBG_PRINT(equal_cnt); DBG_PRINT(" ");
@@ -2000,4 +2751,8 @@ const bool ManchesterpatternDecoder::isManchester()
 
 	}
 	return false;
-}
\ No newline at end of file
+}
+
+
+template class SignalDetector<254, 8, uint8_t>;				// SmallSignalDetector
+template class ManchesterDecoder<254, 8, uint8_t>;
@@ -76,17 +76,19 @@ extern WiFiClient serverClient;
  
 #include "bitstore.h"
 #include "FastDelegate.h"
-#define maxNumPattern 8
-#define maxMsgSize 254
 #define minMessageLen 40
 #define syncMinFact 6
 #define syncMaxFact 44
 #define syncMaxMicros 17000
 #define maxPulse 32001  // Magic Pulse Length
+#define noiseChurnStep 8	// Churn added for every pattern replaced in the full pattern table, a matching pulse removes 1
+#define noiseGateClose 96	// Churn which closes the noise gate
+#define noiseGateOpen 32	// Churn below which the noise gate opens again
 
 constexpr const uint8_t SERIAL_DELIMITER = 59;
 constexpr const uint8_t MSG_START = 2;
 constexpr const uint8_t MSG_END = 3;
+constexpr const uint8_t MSG_BIN = 1;		// Start of a binary message (MbinEnabled)
 
 //#define SERIAL_DELIMITER  59 //char(';')
 //#define MSG_START char(0x2)		// this is a non printable Char
@@ -96,32 +98,261 @@ constexpr const uint8_t MSG_END = 3;
 //#define DEBUGDETECT 255  // Very verbose output
 //#define DEBUGDECODE 1
 
+#ifndef maxFrameSize
+#if defined(__AVR__)
+#define maxFrameSize 96		// Longer messages are passed in more than one part
+#else
+#define maxFrameSize 255	// Biggest part the stream callback can take
+#endif
+#endif
+
 enum status { searching, clockfound, syncfound, detecting, mcdecoding };
 
-class ManchesterpatternDecoder;
-class SignalDetectorClass;
+/*
+*	Binary message (MbinEnabled), all int16 / uint16 values little endian:
+*	MSG_BIN, length of the bytes from type up to the crc, type 'S' (MS), 'U' (MU) or 'C' (MC), flags
+*	  flags: bit 0 message buffer overflow (O), bit 1 rssi follows, bit 2 MS message moved (m),
+*	         bit 3 tag follows, bit 4-5 remaining moves (value of m), bit 6 repeat count follows (r),
+*	         bit 7 MS part number follows (c)
+*	MS / MU: pattern mask (bit n set: pattern n follows), int16 for every pattern in the mask, clock index,
+*	         sync index (MS only), number of values, values packed two per byte (first one in the high nibble)
+*	MC:      int16 LL, LH, SL, SH, clock, uint16 number of bits, bits packed 8 per byte (first one in bit 7)
+*	then rssi, part number, tag length and tag, repeat count if flagged and the crc16 (CCITT, 0x1021, start 0xFFFF) of all bytes after
+*	MSG_BIN, high byte first.
+*/
+constexpr const uint8_t MSG_BIN_OVERFLOW = 1;
+constexpr const uint8_t MSG_BIN_RSSI = 2;
+constexpr const uint8_t MSG_BIN_MOVED = 4;
+constexpr const uint8_t MSG_BIN_TAG = 8;
+constexpr const uint8_t MSG_BIN_REPEAT = 64;
+constexpr const uint8_t MSG_BIN_CONTINUED = 128;
+
+/*
+*	Output formats of a message. The stream callback with format (setFormatStreamCallback) gets the formats a part is
+*	valid for as bit mask, bit n for format n, and fmtMore if the message continues in the next part.
+*/
+enum MessageFormat : uint8_t { fmtVerbose = 0, fmtReduced = 1, fmtBinary = 2 };
+constexpr const uint8_t fmtMore = 0x80;
 
-class SignalDetectorClass
+inline uint16_t crc16(uint16_t crc, const uint8_t b)
 {
-	friend class ManchesterpatternDecoder;
+	crc ^= uint16_t(b) << 8;
+	for (uint8_t i = 0; i < 8; i++)
+		crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+	return crc;
+}
+
+/*
+*	Collects the output of one message, so the stream callback is called once per message and the message is
+*	passed in one piece. Messages longer than maxFrameSize are passed whenever the buffer is full.
+*/
+class MessageFrame
+{
+public:
+	typedef fastdelegate::FastDelegate2<const uint8_t*, uint8_t, size_t> Func2pRetuint8t;
+	typedef fastdelegate::FastDelegate3<const uint8_t*, uint8_t, uint8_t, size_t> FormatOutput;
+
+	MessageFrame() : len(0), crc(0xFFFF), formats(0), parted(false) {};
+	void setOutput(Func2pRetuint8t callbackfunction) { output = callbackfunction; }
+	void setFormatOutput(FormatOutput callbackfunction) { formatOutput = callbackfunction; }	// Used instead of output if set
+
+	inline void add(const uint8_t b) {
+		if (len == maxFrameSize) flush(true);
+		buf[len++] = b;
+	}
+	void add(const char *str);
+	void addInt(const int val);								// Decimal like %i
+	void addHex(unsigned int val, const uint8_t digits = 1);	// Uppercase hex with at least digits digits like %X / %02X
+	void end(const char *tag = nullptr);					// Adds tag, MSG_END and newline and passes the frame
+	void flush(const bool more = false);					// Passes the collected part of the message, more: the message is not complete
+	void pass(const uint8_t *data, const uint8_t n, const uint8_t fmts);	// Passes a complete message collected elsewhere
+	uint8_t take(uint8_t *dest);							// Moves the collected part to dest and discards it, returns its length
+	void discard() { len = 0; parted = false; }
+
+	void beginBinary(const uint8_t length);					// Adds MSG_BIN and length, starts the crc
+	inline void addChecked(const uint8_t b) {
+		crc = crc16(crc, b);
+		add(b);
+	}
+	void addChecked(const uint16_t val) { addChecked(lowByte(val)); addChecked(highByte(val)); }
+	void addChecked(const int16_t val) { addChecked(uint16_t(val)); }
+	void endBinary();										// Adds the crc and passes the frame
+
+	uint8_t len;
+	uint16_t crc;
+	uint8_t formats;										// Formats the message in the frame is valid for, passed to formatOutput
+	bool parted;											// Parts of the message in the frame have already been passed
+
+private:
+	uint8_t buf[maxFrameSize];
+	Func2pRetuint8t output = nullptr;
+	FormatOutput formatOutput = nullptr;
+};
+
 
+#ifndef repeatSlots
+#if defined(__AVR__)
+#define repeatSlots 0		// Messages held at the same time for folding repeats (MdedupEnabled), 0: left out
+#else
+#define repeatSlots 4
+#endif
+#endif
+#ifndef repeatWindow
+#define repeatWindow 300	// ms after the last repeat until the held message is passed
+#endif
+
+/*
+*	Folds repeated transmissions into one message (MdedupEnabled). A message is not passed when it is complete, but
+*	held with a hash of its content (pattern indices, rounded pattern values and the data). Every message with the
+*	same hash and formats which follows within repeatWindow ms is counted and discarded. When no repeat came for
+*	repeatWindow ms, the held message is passed with the count: "r=<count>;" in front of the tag in text messages,
+*	MSG_BIN_REPEAT and a count byte in binary ones. A message without repeats is passed unchanged.
+*	Messages which do not fit into one frame and parts of streamed MS messages are never held.
+*/
+#if repeatSlots > 0
+class RepeatCache
+{
 public:
-	SignalDetectorClass() : first(buffer), last(nullptr), message(4) { 
+	RepeatCache() : used(0) { for (uint8_t i = 0; i < repeatSlots; i++) slot[i].len = 0; }
+
+	bool fold(MessageFrame &frame, const uint16_t hash, const bool binary, const char *tag);	// Returns true if the frame was held or counted
+	void pass(MessageFrame &frame, const bool all);			// Passes the held messages without repeats for repeatWindow ms, all: every held message
+	uint8_t used;											// Number of held messages
+
+private:
+	struct Slot {
+		unsigned long time;		// Last repeat
+		uint16_t hash;
+		uint8_t formats;
+		uint8_t count;
+		uint8_t len;			// 0: slot is free
+		bool binary;
+		const char *tag;
+		uint8_t buf[maxFrameSize];
+	};
+	void pass(MessageFrame &frame, Slot &s);
+
+	Slot slot[repeatSlots];
+};
+#else
+class RepeatCache		// Folding is left out, every message is passed when it is complete
+{
+public:
+	bool fold(MessageFrame &, const uint16_t, const bool, const char *) { return false; }
+	void pass(MessageFrame &, const bool) {}
+	static const uint8_t used = 0;
+};
+#endif
+
+
+#ifndef decoderCounters
+#if defined(__AVR__)
+#define decoderCounters 0	// DecoderCounters of every decoder (command c), 0: left out
+#else
+#define decoderCounters 1
+#endif
+#endif
+
+#if decoderCounters
+#define COUNT_DECODER(field) counters.field++
+#else
+#define COUNT_DECODER(field)
+#endif
+
+/*
+*	Fingerprint of a known MS signal: clock pulse, sync as multiple of the clock and the number of high and low patterns
+*	(the sync included) after compress_pattern. A message which matches one of msFingerprints takes its clock and sync
+*	from it, is accepted with a single sync and is not tried as manchester signal.
+*/
+struct MsFingerprint
+{
+	uint16_t clockMin;		// us
+	uint16_t clockMax;
+	uint8_t syncMin;		// sync / clock, rounded
+	uint8_t syncMax;
+	uint8_t highPatterns;
+	uint8_t lowPatterns;
+};
+
+constexpr const uint8_t msFingerprintCount = 4;
+extern const MsFingerprint msFingerprints[msFingerprintCount] PROGMEM;
+
+
+/*
+*	Statistics of a decoder, to tell lost messages caused by the signal from a decoder which cannot keep up.
+*	reset() of the decoder does not change them.
+*/
+struct DecoderCounters
+{
+	uint32_t msMsgs;			// Messages printed, also if repeats are folded
+	uint32_t muMsgs;
+	uint32_t mcMsgs;
+	uint32_t processCalls;		// processMessage invocations
+	uint32_t moves;				// bufferMove calls which moved the message buffer
+	uint32_t invalidResets;		// Buffer discarded after two pulses with the same sign
+	uint32_t noiseResets;		// Buffer discarded by the closed noise gate
+	uint32_t noisePulses;		// Pulses discarded with them
+	uint32_t fingerprints[msFingerprintCount];	// Messages which matched msFingerprints[n]
+	void clear() {
+		msMsgs = muMsgs = mcMsgs = processCalls = moves = invalidResets = noiseResets = noisePulses = 0;
+		for (uint8_t i = 0; i < msFingerprintCount; i++) fingerprints[i] = 0;
+	}
+};
+
+
+template<uint16_t msgSize, uint8_t numPattern, class Index>
+class ManchesterDecoder;
+
+/*
+*	Sizes are template parameters: msgSize values in the message buffer, numPattern patterns and Index, the type of a
+*	position in the message buffer and of the histogram counts. The decoder is instantiated in signalDecoder.cpp
+*	for the profile SmallSignalDetector only.
+*/
+template<uint16_t msgSize, uint8_t numPattern, class Index>
+class SignalDetector
+{
+	friend class ManchesterDecoder<msgSize, numPattern, Index>;
+	static_assert(msgSize % 2 == 0, "Two values are stored in one byte");
+	static_assert(msgSize <= 254, "The number of values of a binary MS / MU message has one byte");
+	static_assert(Index(msgSize) == msgSize, "Index is too small for msgSize");
+	static_assert(numPattern <= 8, "The pattern mask of a binary message has 8 bits");
+
+public:
+	typedef ManchesterDecoder<msgSize, numPattern, Index> McDecoder;
+	static constexpr uint16_t bufferSize = msgSize;
+	static constexpr uint8_t patternCount = numPattern;
+
+	SignalDetector() : manchester(this), first(buffer), last(nullptr) { 
 																		 buffer[0] = 0; reset(); mcMinBitLen = 17; 	
 																		 MsMoveCount = 0; 
 																		 MredEnabled = 1;      // 1 = compress printmsg 
+																		 MbinEnabled = 0;
+																		 MdedupEnabled = 0;
+																		 outputFormats = 0;
 																		 mcdecoder = nullptr;
+																		 churn = 0;
+																		 noiseGate = false;
+#if decoderCounters
+																		 counters.clear();
+#endif
 																		};
+	SignalDetector(const SignalDetector &src) : manchester(this) { *this = src; }
+	SignalDetector &operator=(const SignalDetector &src);	// The copy uses its own buffer and its own manchester decoder
 
 
 	void reset();
 	bool decode(const int* pulse);
+	size_t decode(const int* pulses, const size_t n);	// Decodes a batch of pulses, returns the number of pulses which completed a message
 	const status getState();
 	typedef fastdelegate::FastDelegate0<uint8_t> FuncRetuint8t;
 	typedef fastdelegate::FastDelegate2<const uint8_t*, uint8_t, size_t> Func2pRetuint8t;
 
 	void setRSSICallback(FuncRetuint8t callbackfunction) { _rssiCallback = callbackfunction; }
-	void setStreamCallback(Func2pRetuint8t callbackfunction) { _streamCallback = callbackfunction; }
+	void setStreamCallback(Func2pRetuint8t callbackfunction) { _streamCallback = callbackfunction; frame.setOutput(callbackfunction); }
+	void setFormatStreamCallback(MessageFrame::FormatOutput callbackfunction) { frame.setFormatOutput(callbackfunction); }
+	void setMessageTag(const char *tag) { msgTag = tag; }	// Field added to every message, e.g. the receiver channel
+	uint8_t defaultFormat() const { return MbinEnabled ? fmtBinary : (MredEnabled ? fmtReduced : fmtVerbose); }
+	void passRepeats(const bool all = false) { if (repeats.used > 0) repeats.pass(frame, all); }	// Call regularly, passes folded messages after repeatWindow
 
 
 	//private:
@@ -131,19 +362,23 @@ public:
 	bool MCenabled;
 	bool MSenabled;
 	bool MredEnabled;                       // 1 = compress printMsgRaw
+	bool MbinEnabled;                       // 1 = binary messages, replaces MS/MU/MC text output
+	bool MdedupEnabled;                     // 1 = repeated messages are folded into one with a repeat count (RepeatCache)
+	uint8_t outputFormats;					// bit n: every message is printed in MessageFormat n, 0: only in defaultFormat()
 	uint8_t MsMoveCount;
 	
-	uint8_t histo[maxNumPattern];
-	//uint8_t message[maxMsgSize];
-	ManchesterpatternDecoder *mcdecoder;  // Pointer to mcdecoder object
-
-	uint8_t messageLen;					  // Todo, kann durch message.valcount ersetzt werden
-	uint8_t mstart;						  // Holds starting point for message
-	uint8_t mend;						  // Holds end point for message if detected
+	Index histo[numPattern];				// Number of references to every pattern in message, updated with every change of message
+	//uint8_t message[msgSize];
+	McDecoder *mcdecoder;				  // Manchester decoder in use, set to &manchester by the first manchester trial unless one was injected
+	McDecoder manchester;				  // Part of the detector, the decoder allocates nothing after its construction
+
+	Index messageLen;					  // Todo, kann durch message.valcount ersetzt werden
+	Index mstart;						  // Holds starting point for message
+	Index mend;							  // Holds end point for message if detected
 	bool success;                         // True if a valid coding was found
 	bool m_truncated;					// Identify if message has been truncated
 	bool m_overflow;
-	void bufferMove(const uint8_t start);
+	void bufferMove(const Index start);
 
 	uint16_t tol;                           // calculated tolerance for signal
 											//uint8_t bitcnt;
@@ -151,54 +386,105 @@ public:
 	int buffer[2];                          // Internal buffer to store two pules length
 	int* first;                             // Pointer to first buffer entry
 	int* last;                              // Pointer to last buffer entry
-	BitStore<maxMsgSize / 2> message;       // A store using 4 bit for every value stored. 
+	RingBitStore<msgSize / 2, 4> message;	// A store using 4 bit for every value stored. 
 	float tolFact;                          //
-	int pattern[maxNumPattern];				// 1d array to store the pattern
+	int pattern[numPattern];				// 1d array to store the pattern
+	int patternLo[numPattern];				// Smallest pulse which matches pattern[idx]
+	int patternHi[numPattern];				// Biggest pulse which matches pattern[idx]
+	uint8_t patternIdx[numPattern];			// Used pattern indexes, positive ones first, both parts in ascending order
+	uint8_t patternPosCnt;					// Number of positive patterns in patternIdx
+	uint8_t patternIdxCnt;					// Number of used patterns in patternIdx
 	uint8_t patternLen;                     // counter for length of pattern
 	uint8_t pattern_pos;
 	int8_t sync;							// index to sync in pattern if it exists
+	int8_t fingerprint;						// Entry of msFingerprints the message matched, -1: none
+	/*
+	*	Noise gate: noise fills the pattern table with random widths and every further pulse replaces a pattern, which costs
+	*	a processMessage and a bufferMove each time. churn rises by noiseChurnStep for every replaced pattern and falls by 1
+	*	for every pulse which matched a pattern, reset() does not change it. From noiseGateClose on the gate is closed: a pulse
+	*	which needs a new pattern resets the buffer instead, until churn falls below noiseGateOpen. A message which is
+	*	already detected (sync found, manchester, streamed MS) is never dropped.
+	*/
+	uint8_t churn;
+	bool noiseGate;							// true: closed
 											//String preamble;
 											//String postamble;
 	bool mcDetected;						// MC Signal alread detected flag
+	uint8_t msPart;							// Number of the printed parts of an MS message longer than the buffer, 0: not streamed
 	uint8_t mcMinBitLen;					// min bit Length
 	uint8_t rssiValue=0;					// Holds the RSSI value retrieved via a rssi callback
 	FuncRetuint8t _rssiCallback= nullptr;	// Holds the pointer to a callback Function
 	Func2pRetuint8t _streamCallback=nullptr;// Holds the pointer to a callback Function
+	MessageFrame frame;						// Output of the message which is printed
+	const char *msgTag = nullptr;			// Added in front of MSG_END if set
+	RepeatCache repeats;					// Messages held for folding their repeats
+	uint16_t msgHash;						// Hash of the message which is printed, for repeats
+#if decoderCounters
+	DecoderCounters counters;
+#endif
 	//Stream * msgPort;						// Holds a pointer to a stream object for outputting
 
 
 	void addData(const int8_t value);
 	void addPattern();
 	inline void updPattern(const uint8_t ppos);
+	inline void updPatternWindow(const uint8_t idx);
+	void calcPatternIndex();				// Rebuilds windows and patternIdx, needed after pattern[] or patternLen was changed from outside
+	void updPatternIndex();					// Rebuilds patternIdx after a pattern was added or removed
 
 	void doDetect();
 	void processMessage();
+	void mcStreamBegin();					// Clock of a manchester signal is locked, the following pulses are decoded as they arrive
+	bool mcStream();						// Decodes *first as part of the locked signal, false if it ends the signal
+	void mcStreamEnd();						// Prints the signal if it has minbitlen bits and starts over
 	void compress_pattern();
-	void calcHisto(const uint8_t startpos = 0, uint8_t endpos = 0);
+	void calcHisto();						// Full recount of histo, only needed if message was changed from outside
+	void calcHisto(Index *dest, const Index startpos, Index endpos = 0); // Histogram of message[startpos..endpos) into dest
+	const bool checkHisto();				// Compares the incremental histo with a full recount
 	bool getClock(); // Searches a clock in a given signal
 	bool getSync();	 // Searches clock and sync in given Signal
+	bool matchFingerprint();				// Takes clock and sync from msFingerprints if the message matches an entry
+	Index clockEnd(Index pos);		// First high pulse from pos on which is not the clock
 	//int8_t printMsgRaw(uint8_t m_start, const uint8_t m_end, const String *preamble = NULL, const String *postamble = NULL);
 	//void printMsgStr(const String *first, const String *second, const String *third);
 	const bool inTol(const int val, const int set, const int tolerance); // checks if a value is in tolerance range
 
 	void printOut();
+	uint16_t messageHash(const char type, const Index *usedHisto, const Index first, const Index last);
+	void endMessage(const bool binary);					// Passes the frame or holds it for folding repeats
+	void printPatterns(const Index *usedHisto, const bool reduced);	// Adds the patterns used in the message to frame
+	uint8_t messageFormats() const { return outputFormats ? outputFormats : 1 << defaultFormat(); }
+	/*
+	*	An MS message longer than the buffer is printed in parts: when the buffer is full, the complete clock / data pairs
+	*	are printed (with O;) and removed, clock, sync and the pattern table stay locked for the rest. Parts after the first
+	*	have "c=<n>;" (n = 1, 2, ..), their data continues the data of the part before.
+	*/
+	void printMS(const Index *msgHisto, const bool msMove);	// msMove: the message is moved out after printing
+	void printMS(const MessageFormat format, const Index *msgHisto, const bool msMove);
+	void printMU();
+	void printMU(const MessageFormat format);
+	void printMC();
+	void printMCText();										// Same for verbose and reduced output
+	void printBinary(const char type, const Index *usedHisto, const Index first, const Index last, const bool msMove);
+	void printBinaryMC();
 	const size_t write(const uint8_t *buffer, size_t size);
 	const size_t write(const char *str);
 	const size_t write(uint8_t b);
 
 	int8_t findpatt(const int val);              // Finds a pattern in our pattern store. returns -1 if te pattern is not found
 												 //bool validSequence(const int *a, const int *b);     // checks if two pulses are basically valid in terms of on-off signals
-	const bool checkMBuffer(const uint8_t begin = 0);
+	const bool checkMBuffer(const Index begin = 0);
 
 
 };
 
 
-class ManchesterpatternDecoder
+template<uint16_t msgSize, uint8_t numPattern, class Index>
+class ManchesterDecoder
 {
 public:
-	ManchesterpatternDecoder(SignalDetectorClass *ref_dec) : ManchesterBits(1), longlow(-1), longhigh(-1), shorthigh(-1), shortlow(-1) { pdec = ref_dec; 	reset(); };
-	~ManchesterpatternDecoder();
+	ManchesterDecoder(SignalDetector<msgSize, numPattern, Index> *ref_dec) : longlow(-1), longhigh(-1), shorthigh(-1), shortlow(-1) { pdec = ref_dec; 	reset(); };
+	~ManchesterDecoder();
 	const bool doDecode();
 	void setMinBitLen(const uint8_t len);
 #ifdef NOSTRING
@@ -212,7 +498,7 @@ public:
 	void getMessageClockStr(String* str);
 	void getMessageLenStr(String* str);
 #endif
-	void printMessageHexStr();
+	void printMessageHexStr();			// Adds the data as hex string to the message frame of the decoder
 	void printMessagePulseStr();
 
 	const bool isManchester();
@@ -220,8 +506,8 @@ public:
 #ifndef UNITTEST
 	//private:
 #endif
-	BitStore<50> ManchesterBits;       // A store using 1 bit for every value stored. It's used for storing the Manchester bit data in a efficent way
-	SignalDetectorClass *pdec;
+	BitStore<msgSize / 5, 1> ManchesterBits;	// A store using 1 bit for every value stored. It's used for storing the Manchester bit data in a efficent way
+	SignalDetector<msgSize, numPattern, Index> *pdec;
 	int8_t longlow;
 	int8_t longhigh;
 	int8_t shorthigh;
@@ -231,10 +517,23 @@ public:
 
 	bool mc_start_found = false;
 	bool mc_sync = false;
+	bool streaming = false;				// Clock locked, pulses are passed to addPulse as they arrive instead of buffering them
+	bool pendingShort = false;			// First half of a bit made of two short pulses
+	uint8_t bit = 0;					// Last decoded bit, kept over buffer ends
+
+	const bool addPulse(const int8_t pulse_idx);	// Decodes one more pulse of a locked signal, false if it does not fit
 
 	const bool isLong(const uint8_t pulse_idx);
 	const bool isShort(const uint8_t pulse_idx);
-	unsigned char getMCByte(const uint8_t idx); // Returns one Manchester byte in correct order. This is a helper function to retrieve information out of the buffer
+	unsigned char getMCByte(const Index idx); // Returns one Manchester byte in correct order. This is a helper function to retrieve information out of the buffer
 };
 
+/*
+*	Decoder profile
+*	  SmallSignalDetector: 254 values, 8 patterns, uint8_t positions, fits the ATmega328
+*/
+typedef SignalDetector<254, 8, uint8_t> SmallSignalDetector;
+typedef SmallSignalDetector SignalDetectorClass;
+typedef SignalDetectorClass::McDecoder ManchesterpatternDecoder;
+
 #endif
@@ -0,0 +1,246 @@
+/*
+*   Serial output queue, decouples message output from decoding
+*   Copyright (C) 2026  SIGNALduino contributors
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TXQUEUE_H
+#define TXQUEUE_H
+
+#include "Arduino.h"
+#include "signalDecoder.h"
+
+/*
+*	push() is the stream callback of the decoder and only copies the message into the queue, drain() is called from
+*	the loop and writes only as many bytes as the port takes without blocking.
+*	Every part passed to push() is stored as one entry: length, flags, data. Parts which do not start a message
+*	(a frame longer than maxFrameSize) are flagged as continuation and belong to the entry before.
+*	Producer and consumer both run in the loop, so no locking is needed.
+*
+*	If the queue is full, the drop policy decides:
+*	  txBlock   wait for the port like before
+*	  txDropMU  drop the oldest queued MU message, then the new one if it is an MU message. MS and MC messages are
+*	            never dropped, if the queue only holds those, push() waits for the port.
+*	A message which is already partially written is never dropped.
+*/
+
+enum TxDropPolicy : uint8_t { txBlock = 0, txDropMU = 1 };
+
+template<uint16_t queueSize, class Port>
+class TxQueue
+{
+	static_assert(queueSize > 0 && (queueSize & (queueSize - 1)) == 0, "queueSize must be a power of two");
+	static_assert(queueSize <= 32768, "queueSize is too big");
+
+public:
+	TxQueue(Port &port, const TxDropPolicy policy = txDropMU) : policy(policy), port(port) { flush(); resetCounters(); }
+
+	size_t push(const uint8_t *buf, uint8_t len);	// Stream callback, returns len also if the message is dropped
+	bool drain();									// Writes without blocking, returns true if the queue is empty
+	void finishMessage();							// Waits until no message is partially written, call before writing to the port directly
+	void flush() { head = tail = 0; sent = 0; open = false; dropping = false; }
+	uint16_t count() const { return uint16_t(head - tail); }
+	bool isEmpty() const { return head == tail; }
+
+	TxDropPolicy policy;
+
+	// Statistics
+	uint32_t queuedBytes;		// Bytes passed to push()
+	uint32_t droppedBytes;
+	uint16_t droppedMsgs;
+	uint16_t stalls;			// push() had to wait for the port
+	uint16_t maxCount;			// High watermark in bytes, including entry headers
+	void resetCounters() { queuedBytes = 0; droppedBytes = 0; droppedMsgs = 0; stalls = 0; maxCount = 0; }
+
+private:
+	static const uint16_t mask = queueSize - 1;
+	static const uint8_t hdrSize = 2;
+	static const uint8_t flagMU = 1;
+	static const uint8_t flagCont = 2;
+
+	inline uint8_t at(const uint16_t idx) const { return raw[idx & mask]; }
+	inline uint8_t &at(const uint16_t idx) { return raw[idx & mask]; }
+	bool dropOldestMU(const bool lastIsOpen);
+	void startMessage(const uint8_t *buf, const uint8_t len);
+
+	Port &port;
+	uint8_t raw[queueSize];
+	uint16_t head;			// Next write position
+	uint16_t tail;			// Start of the entry which is written to the port
+	uint8_t sent;			// Bytes of the tail entry already written
+	bool open;				// Last message is not complete yet, next part is a continuation
+	bool openMU;			// Last message is an MU message
+	bool dropping;			// Rest of the open message is dropped
+	uint16_t openRemaining;	// Binary message: bytes still missing
+};
+
+
+template<uint16_t queueSize, class Port>
+void TxQueue<queueSize, Port>::startMessage(const uint8_t *buf, const uint8_t len)
+{
+	open = true;
+	dropping = false;
+	openRemaining = 0;
+	if (buf[0] == MSG_BIN && len >= 2) {
+		openRemaining = buf[1] + 4;		// MSG_BIN, length, type up to the crc, crc
+		openMU = len >= 3 && buf[2] == 'U';
+	}
+	else if (buf[0] == MSG_START) {
+		openMU = len >= 3 && buf[1] == 'M' && (buf[2] == 'U' || buf[2] == 'u');
+	}
+	else {
+		open = false;		// Anything else is passed as it is and never dropped
+		openMU = false;
+	}
+}
+
+template<uint16_t queueSize, class Port>
+size_t TxQueue<queueSize, Port>::push(const uint8_t *buf, uint8_t len)
+{
+	if (len == 0) return 0;
+	const bool isStart = !open;
+	if (isStart)
+		startMessage(buf, len);
+	bool complete = !open;		// Does this part complete the message?
+	if (!complete) {
+		if (openRemaining > 0)
+			complete = (openRemaining = openRemaining > len ? openRemaining - len : 0) == 0;
+		else
+			complete = buf[len - 1] == '\n';
+	}
+	queuedBytes += len;
+
+	const uint16_t need = hdrSize + len;
+	bool stalled = false;
+	while (!dropping && uint16_t(queueSize - count()) < need)
+	{
+		if (policy == txDropMU) {
+			if (dropOldestMU(!isStart))
+				continue;
+			if (openMU && isStart) {
+				dropping = true;
+				droppedMsgs++;
+				break;
+			}
+		}
+		if (!stalled) {
+			stalled = true;
+			stalls++;
+		}
+		if (need > queueSize && isEmpty()) {		// Part does not fit at all, write it directly
+			for (uint8_t n = 0; n < len; ) {
+				if (port.availableForWrite() > 0)
+					n += port.write(buf + n, len - n);
+				else
+					yield();
+			}
+			open = !complete;
+			return len;
+		}
+		if (!drain())
+			yield();
+	}
+	open = !complete;
+	if (dropping) {
+		droppedBytes += len;
+		dropping = open;
+		return len;
+	}
+
+	at(head) = len;
+	at(head + 1) = (openMU ? flagMU : 0) | (isStart ? 0 : flagCont);
+	for (uint8_t i = 0; i < len; i++)
+		at(head + hdrSize + i) = buf[i];
+	head += need;
+	if (count() > maxCount) maxCount = count();
+	return len;
+}
+
+/*
+*	Removes the oldest MU message which is not partially written, with all its continuation entries, and moves the
+*	entries behind it down. Returns false if there is none. lastIsOpen: the last queued message is the one push()
+*	is adding a part to, its remaining parts are dropped as well.
+*/
+template<uint16_t queueSize, class Port>
+bool TxQueue<queueSize, Port>::dropOldestMU(const bool lastIsOpen)
+{
+	uint16_t idx = tail;
+	// The message at the tail is locked if it has been started
+	bool locked = sent > 0 || (idx != head && (at(idx + 1) & flagCont));
+	while (idx != head)
+	{
+		const uint8_t flags = at(idx + 1);
+		if (!(flags & flagCont))
+			locked = locked && idx == tail;
+		if (!locked && !(flags & flagCont) && (flags & flagMU))
+		{
+			uint16_t end = idx;
+			uint32_t bytes = 0;
+			do {
+				bytes += at(end);
+				end += hdrSize + at(end);
+			} while (end != head && (at(end + 1) & flagCont));
+
+			if (end == head && lastIsOpen)
+				dropping = true;
+			uint16_t dst = idx;
+			while (end != head)
+				at(dst++) = at(end++);
+			head = dst;
+			droppedBytes += bytes;
+			droppedMsgs++;
+			return true;
+		}
+		idx += hdrSize + at(idx);
+	}
+	return false;
+}
+
+template<uint16_t queueSize, class Port>
+bool TxQueue<queueSize, Port>::drain()
+{
+	while (head != tail)
+	{
+		const int avail = port.availableForWrite();
+		if (avail <= 0)
+			return false;
+		const uint8_t len = at(tail);
+		const uint16_t start = (tail + hdrSize + sent) & mask;
+		uint16_t n = len - sent;
+		if (n > uint16_t(avail)) n = avail;
+		if (n > queueSize - start) n = queueSize - start;		// Part up to the end of the buffer, the rest follows
+		n = port.write(&raw[start], n);
+		if (n == 0)
+			return false;
+		sent += n;
+		if (sent == len) {
+			tail += hdrSize + len;
+			sent = 0;
+		}
+	}
+	return true;
+}
+
+template<uint16_t queueSize, class Port>
+void TxQueue<queueSize, Port>::finishMessage()
+{
+	while (head != tail && (sent > 0 || (at(tail + 1) & flagCont)))
+	{
+		if (!drain())
+			yield();
+	}
+}
+
+#endif // TXQUEUE_H
@@ -0,0 +1,469 @@
+// main.cpp : Benchmark for the pattern decoder. Replays recorded and synthetic pulse traces through
+// SignalDetectorClass::decode() and compares the results against a stored baseline.
+//
+// Usage: BenchProject [--baseline <file>] [--update-baseline] [--perf <file>] [--tolerance <percent>]
+//                     [--iterations <n>] [--trace <name>] [--batch <n>]
+//
+// With --batch the pulses are handed to decode() in batches of <n> pulses, like the main loop does after
+// draining the FIFO. The decoded output must not depend on the batch size, every run also decodes all traces
+// in batches of 1, 7 and 32 pulses and fails if the outputs differ.
+//
+// The run fails (exit code 1) if the decoded output of a trace differs from the baseline (decoder regression).
+// The baseline holds no timings, they depend on the machine and its load. With --perf the run also fails if the
+// time per pulse is more than <tolerance> percent above the timings in <file>; if the file does not exist, the
+// timings of this run are written to it. Record and compare on the same idle host only.
+//
+// The micro benchmarks (microbench.cpp) time single decoder functions against a reference copy of their
+// previous implementation, a mismatch between both fails the run as well.
+//
+// Built with PROFILE (cmake -DPROFILE=ON) the table of the stage profiler in the decoder is printed as well. It
+// covers all iterations of the timing pass, the timers add to the time per pulse.
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <sstream>
+
+#include <signalDecoder.h>
+#include <decoderProfile.h>
+#include "traces.h"
+#include "microbench.h"
+
+#ifndef BENCH_BASELINE
+#define BENCH_BASELINE "baseline.txt"
+#endif
+
+namespace bench {
+
+	typedef std::chrono::steady_clock benchClock;
+
+	enum Stage { stDoDetect, stProcessMessage, stCompressPattern, stClockSync, stIsManchester, stDoDecode, stCount };
+	static const char *stageNames[stCount] = { "doDetect", "processMessage", "compress_pattern", "getClock/getSync", "isManchester", "doDecode" };
+
+	struct TraceResult
+	{
+		size_t pulses = 0;
+		uint32_t messages = 0;		// Number of MSG_START chars in the output
+		uint32_t successes = 0;		// Number of decode() calls which returned true
+		uint32_t hash = 0;			// FNV-1a over the complete output
+		double nsPerPulse = 0;
+		double stageNs[stCount] = {};
+	};
+
+	struct OutputSink
+	{
+		uint32_t messages;
+		uint32_t hash;
+		void clear() { messages = 0; hash = 2166136261u; }
+	};
+	static OutputSink sink;
+
+	size_t writeCallback(const uint8_t *buf, uint8_t len)
+	{
+		for (uint8_t i = 0; i < len; i++)
+		{
+			if (buf[i] == MSG_START) sink.messages++;
+			sink.hash = (sink.hash ^ buf[i]) * 16777619u;
+		}
+		return len;
+	}
+
+#ifdef PROFILE
+	size_t printLine(const uint8_t *buf, uint8_t len)
+	{
+		return fwrite(buf, 1, len, stdout);
+	}
+#endif
+
+	static void setupDecoder(SignalDetectorClass *dec)
+	{
+		dec->reset();
+		dec->MSenabled = true;
+		dec->MUenabled = true;
+		dec->MCenabled = true;
+		dec->MredEnabled = true;	// Firmware default after initEEPROM
+		dec->setStreamCallback(&writeCallback);
+	}
+
+	static inline double elapsedNs(const benchClock::time_point &start, const benchClock::time_point &end)
+	{
+		return double(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+	}
+
+	//========================= Timing pass ================================================
+
+	static void timeTrace(const PulseTrace &trace, const uint8_t iterations, const size_t batch, TraceResult *result)
+	{
+		double best = 0;
+		for (uint8_t it = 0; it < iterations; it++)
+		{
+			SignalDetectorClass dec;
+			setupDecoder(&dec);
+			sink.clear();
+			uint32_t successes = 0;
+
+			const benchClock::time_point start = benchClock::now();
+			if (batch > 1)
+			{
+				for (size_t i = 0; i < trace.pulses.size(); i += batch)
+					successes += dec.decode(trace.pulses.data() + i, std::min(batch, trace.pulses.size() - i));
+			}
+			else {
+				for (size_t i = 0; i < trace.pulses.size(); i++)
+				{
+					int pulse = trace.pulses[i];
+					if (dec.decode(&pulse))
+						successes++;
+				}
+			}
+			const double ns = elapsedNs(start, benchClock::now());
+			if (it == 0 || ns < best)
+				best = ns;
+
+			result->successes = successes;
+			result->messages = sink.messages;
+			result->hash = sink.hash;
+		}
+		result->pulses = trace.pulses.size();
+		result->nsPerPulse = best / trace.pulses.size();
+	}
+
+	//========================= Profile pass ===============================================
+	// The decoder has no hooks, so the stage split is measured by replaying every stage in isolation on a
+	// copy of the decoder state, taken right before doDetect() would call processMessage().
+
+	static bool willProcess(SignalDetectorClass *dec, const int pulse)
+	{
+		// Mirrors the two places in doDetect() which call processMessage()
+		const int *last = dec->messageLen > 0 ? &dec->pattern[dec->message[dec->messageLen - 1]] : nullptr;
+		bool valid = (dec->messageLen == 0 || last == nullptr || (pulse ^ *last) < 0);
+		valid &= dec->messageLen != SignalDetectorClass::bufferSize;
+		valid &= pulse > -maxPulse;
+		if (!valid)
+			return true;
+
+		if (dec->patternLen == SignalDetectorClass::patternCount && dec->findpatt(pulse) < 0)
+		{
+			uint8_t cnt = 0;
+			for (uint8_t i = 0; i < dec->messageLen; i++)
+				if (dec->message[i] == dec->pattern_pos) cnt++;
+			return cnt > 2;
+		}
+		return false;
+	}
+
+	static void profileSnapshot(SignalDetectorClass &src, TraceResult *result)
+	{
+		benchClock::time_point start;
+		{
+			SignalDetectorClass s(src);
+			start = benchClock::now();
+			s.processMessage();
+			result->stageNs[stProcessMessage] += elapsedNs(start, benchClock::now());
+		}
+
+		SignalDetectorClass s(src);
+		if (!s.mcDetected && s.messageLen < minMessageLen)
+			return;		// processMessage only resets the buffer
+
+		if (!s.mcDetected)
+		{
+			start = benchClock::now();
+			s.compress_pattern();
+			result->stageNs[stCompressPattern] += elapsedNs(start, benchClock::now());
+
+			start = benchClock::now();
+			s.getClock();
+			if (s.state == clockfound && s.MSenabled) s.getSync();
+			result->stageNs[stClockSync] += elapsedNs(start, benchClock::now());
+		}
+		else {
+			s.calcHisto();
+		}
+
+		if (s.state == syncfound || !s.MCenabled)
+			return;
+
+		if (!s.mcDetected)
+		{
+			s.manchester.reset();
+			s.manchester.setMinBitLen(s.mcMinBitLen);
+		}
+		start = benchClock::now();
+		const bool isMC = s.mcDetected || s.manchester.isManchester();
+		result->stageNs[stIsManchester] += elapsedNs(start, benchClock::now());
+		if (isMC)
+		{
+			start = benchClock::now();
+			s.manchester.doDecode();
+			result->stageNs[stDoDecode] += elapsedNs(start, benchClock::now());
+		}
+	}
+
+	static void profileTrace(const PulseTrace &trace, TraceResult *result)
+	{
+		SignalDetectorClass dec;
+		setupDecoder(&dec);
+		sink.clear();
+
+		for (size_t i = 0; i < trace.pulses.size(); i++)
+		{
+			int pulse = trace.pulses[i];
+			if (willProcess(&dec, pulse))
+				profileSnapshot(dec, result);
+			dec.decode(&pulse);
+		}
+
+		// Everything which is not spent in processMessage belongs to doDetect and the per pulse overhead
+		const double total = result->nsPerPulse * result->pulses;
+		result->stageNs[stDoDetect] = total > result->stageNs[stProcessMessage] ? total - result->stageNs[stProcessMessage] : 0;
+	}
+
+	//========================= Baseline ===================================================
+
+	typedef std::map<std::string, TraceResult> Baseline;
+
+	static bool loadBaseline(const std::string &filename, Baseline *baseline)
+	{
+		std::ifstream in(filename.c_str());
+		if (!in)
+			return false;
+		std::string line;
+		while (std::getline(in, line))
+		{
+			if (line.empty() || line[0] == '#')
+				continue;
+			std::istringstream fields(line);
+			std::string name;
+			TraceResult r;
+			fields >> name >> r.pulses >> r.messages >> r.successes >> std::hex >> r.hash;
+			if (fields)
+				(*baseline)[name] = r;
+		}
+		return true;
+	}
+
+	static bool saveBaseline(const std::string &filename, const std::vector<PulseTrace> &traces, const std::vector<TraceResult> &results)
+	{
+		FILE *f = fopen(filename.c_str(), "w");
+		if (f == nullptr)
+			return false;
+		fprintf(f, "# Decoder benchmark baseline, generated by BenchProject --update-baseline\n");
+		fprintf(f, "# trace pulses messages successes outputhash\n");
+		for (size_t i = 0; i < traces.size(); i++)
+			fprintf(f, "%s %zu %u %u %08x\n", traces[i].name.c_str(), results[i].pulses, results[i].messages, results[i].successes, results[i].hash);
+		fclose(f);
+		return true;
+	}
+
+	//========================= Timings (--perf) ===========================================
+
+	typedef std::map<std::string, double> Timings;
+
+	static bool loadTimings(const std::string &filename, Timings *timings)
+	{
+		std::ifstream in(filename.c_str());
+		if (!in)
+			return false;
+		std::string line;
+		while (std::getline(in, line))
+		{
+			if (line.empty() || line[0] == '#')
+				continue;
+			std::istringstream fields(line);
+			std::string name;
+			double ns;
+			fields >> name >> ns;
+			if (fields)
+				(*timings)[name] = ns;
+		}
+		return true;
+	}
+
+	static bool saveTimings(const std::string &filename, const std::vector<PulseTrace> &traces, const std::vector<TraceResult> &results)
+	{
+		FILE *f = fopen(filename.c_str(), "w");
+		if (f == nullptr)
+			return false;
+		fprintf(f, "# Decoder benchmark timings of one host, generated by BenchProject --perf\n");
+		fprintf(f, "# trace ns_per_pulse\n");
+		for (size_t i = 0; i < traces.size(); i++)
+			fprintf(f, "%s %.1f\n", traces[i].name.c_str(), results[i].nsPerPulse);
+		fclose(f);
+		return true;
+	}
+
+}
+
+int main(int argc, char **argv)
+{
+	using namespace bench;
+
+	std::string baselineFile = BENCH_BASELINE;
+	std::string perfFile;
+	std::string filter;
+	bool updateBaseline = false;
+	double tolerance = 25.0;
+	int iterations = 20;
+	int batch = 1;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc) baselineFile = argv[++i];
+		else if (strcmp(argv[i], "--update-baseline") == 0) updateBaseline = true;
+		else if (strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc) tolerance = atof(argv[++i]);
+		else if (strcmp(argv[i], "--perf") == 0 && i + 1 < argc) perfFile = argv[++i];
+		else if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) iterations = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) filter = argv[++i];
+		else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) batch = atoi(argv[++i]);
+		else {
+			printf("Usage: %s [--baseline <file>] [--update-baseline] [--perf <file>] [--tolerance <percent>] [--iterations <n>] [--trace <name>] [--batch <n>]\n", argv[0]);
+			return 2;
+		}
+	}
+	if (iterations < 1) iterations = 1;
+	if (iterations > 255) iterations = 255;
+	if (batch < 1) batch = 1;
+
+	std::vector<PulseTrace> traces = buildTraces();
+	if (!filter.empty())
+	{
+		std::vector<PulseTrace> selected;
+		for (size_t i = 0; i < traces.size(); i++)
+			if (traces[i].name == filter) selected.push_back(traces[i]);
+		traces.swap(selected);
+	}
+
+	std::vector<TraceResult> results(traces.size());
+#ifdef PROFILE
+	DecoderProfile::clear();
+#endif
+	for (size_t i = 0; i < traces.size(); i++)
+		timeTrace(traces[i], uint8_t(iterations), size_t(batch), &results[i]);
+#ifdef PROFILE
+	printf("Stage profiler, timing pass of all traces:\n");
+	DecoderProfile::dump(&printLine);
+	printf("\n");
+#endif
+	for (size_t i = 0; i < traces.size(); i++)
+		profileTrace(traces[i], &results[i]);
+
+	// Throughput
+	printf("%-12s %8s %6s %6s %12s %9s\n", "trace", "pulses", "msgs", "ok", "pulses/s", "ns/pulse");
+	size_t totalPulses = 0;
+	double totalNs = 0;
+	for (size_t i = 0; i < traces.size(); i++)
+	{
+		const TraceResult &r = results[i];
+		printf("%-12s %8zu %6u %6u %12.0f %9.1f\n", traces[i].name.c_str(), r.pulses, r.messages, r.successes, 1e9 / r.nsPerPulse, r.nsPerPulse);
+		totalPulses += r.pulses;
+		totalNs += r.nsPerPulse * r.pulses;
+	}
+	if (totalPulses > 0)
+		printf("%-12s %8zu %6s %6s %12.0f %9.1f\n\n", "total", totalPulses, "", "", 1e9 * totalPulses / totalNs, totalNs / totalPulses);
+
+	// Stage split, processMessage contains the stages right of it
+	printf("%-12s", "trace");
+	for (uint8_t s = 0; s < stCount; s++)
+		printf(" %17s", stageNames[s]);
+	printf("\n");
+	for (size_t i = 0; i < traces.size(); i++)
+	{
+		const TraceResult &r = results[i];
+		const double total = r.nsPerPulse * r.pulses;
+		printf("%-12s", traces[i].name.c_str());
+		for (uint8_t s = 0; s < stCount; s++)
+			printf(" %8.1f ns %5.1f%%", r.stageNs[s] / r.pulses, total > 0 ? 100.0 * r.stageNs[s] / total : 0.0);
+		printf("\n");
+	}
+	printf("\n");
+
+	const bool microFailed = benchFindpatt(traces) + benchMessageStore() + benchCompressPattern(traces) > 0;
+
+	if (updateBaseline)
+	{
+		if (!saveBaseline(baselineFile, traces, results))
+		{
+			printf("Unable to write baseline %s\n", baselineFile.c_str());
+			return 2;
+		}
+		printf("Baseline written to %s\n", baselineFile.c_str());
+		return 0;
+	}
+
+	Baseline baseline;
+	if (!loadBaseline(baselineFile, &baseline))
+	{
+		printf("No baseline found at %s, run with --update-baseline to create one\n", baselineFile.c_str());
+		return 2;
+	}
+
+	Timings timings;
+	const bool perfCheck = !perfFile.empty() && loadTimings(perfFile, &timings);
+	if (!perfFile.empty() && !perfCheck)
+	{
+		if (!saveTimings(perfFile, traces, results))
+		{
+			printf("Unable to write timings %s\n", perfFile.c_str());
+			return 2;
+		}
+		printf("Timings written to %s\n", perfFile.c_str());
+	}
+
+	bool failed = microFailed;
+	for (size_t i = 0; i < traces.size(); i++)
+	{
+		const TraceResult &r = results[i];
+		Baseline::const_iterator b = baseline.find(traces[i].name);
+		if (b == baseline.end())
+		{
+			printf("%-12s not in baseline\n", traces[i].name.c_str());
+			continue;
+		}
+		if (b->second.pulses != r.pulses || b->second.messages != r.messages || b->second.successes != r.successes || b->second.hash != r.hash)
+		{
+			printf("%-12s FAILED decoder output changed: msgs %u -> %u, ok %u -> %u, hash %08x -> %08x\n", traces[i].name.c_str(),
+				b->second.messages, r.messages, b->second.successes, r.successes, b->second.hash, r.hash);
+			failed = true;
+		}
+		else if (!perfCheck || timings.find(traces[i].name) == timings.end())
+		{
+			printf("%-12s OK\n", traces[i].name.c_str());
+		}
+		else {
+			const double ns = timings[traces[i].name];
+			if (r.nsPerPulse > ns * (1.0 + tolerance / 100.0))
+			{
+				printf("%-12s FAILED %.1f ns/pulse, recorded %.1f ns/pulse (+%.0f%% allowed)\n", traces[i].name.c_str(), r.nsPerPulse, ns, tolerance);
+				failed = true;
+			}
+			else
+				printf("%-12s OK %+.1f%% ns/pulse\n", traces[i].name.c_str(), ns > 0 ? 100.0 * (r.nsPerPulse / ns - 1.0) : 0.0);
+		}
+	}
+
+	// The output must not depend on the number of pulses passed to decode() at once
+	static const size_t batchSizes[] = { 1, 7, 32 };
+	for (size_t i = 0; i < traces.size(); i++)
+	{
+		TraceResult single;
+		timeTrace(traces[i], 1, batchSizes[0], &single);
+		for (size_t s = 1; s < sizeof(batchSizes) / sizeof(batchSizes[0]); s++)
+		{
+			TraceResult r;
+			timeTrace(traces[i], 1, batchSizes[s], &r);
+			if (r.messages != single.messages || r.successes != single.successes || r.hash != single.hash)
+			{
+				printf("%-12s FAILED batch %zu decodes differently: msgs %u -> %u, ok %u -> %u, hash %08x -> %08x\n", traces[i].name.c_str(),
+					batchSizes[s], single.messages, r.messages, single.successes, r.successes, single.hash, r.hash);
+				failed = true;
+			}
+		}
+	}
+	if (!failed)
+		printf("Batches of 1, 7 and 32 pulses decode the same\n");
+	return failed ? 1 : 0;
+}
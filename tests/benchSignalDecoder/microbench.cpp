@@ -0,0 +1,308 @@
+#include "microbench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_CYCLES() __rdtsc()
+#else
+#define BENCH_CYCLES() 0ULL
+#endif
+
+#include <signalDecoder.h>
+
+namespace bench {
+
+	typedef std::chrono::steady_clock benchClock;
+
+	size_t writeNothing(const uint8_t *, uint8_t len) { return len; }
+
+	// Sample of the decoder state together with the pulse, which findpatt() gets next
+	struct FindpattSample
+	{
+		SignalDetectorClass dec;
+		int val;
+	};
+
+	// findpatt() up to 3.3.1: float tolerance of 20% of the pulse and a linear scan over all patterns
+	static int8_t findpattFloat(const SignalDetectorClass &dec, const int val)
+	{
+		const uint16_t tol = abs(val)*0.2;
+		for (uint8_t idx = 0; idx < dec.patternLen; ++idx)
+		{
+			if ((val ^ dec.pattern[idx]) >> 15)
+				continue;
+			if (dec.pattern[idx] != 0 && abs(val - dec.pattern[idx]) <= tol)
+				return idx;
+		}
+		return -1;
+	}
+
+	size_t benchFindpatt(const std::vector<PulseTrace> &traces)
+	{
+		const size_t maxSamples = 4096;
+		const uint8_t rounds = 50;
+		size_t mismatches = 0;
+
+		printf("%-12s %12s %12s %12s %12s\n", "findpatt", "float ns", "window ns", "float cyc", "window cyc");
+		for (const PulseTrace &trace : traces)
+		{
+			std::vector<FindpattSample> samples;
+			samples.reserve(maxSamples);
+			SignalDetectorClass dec;
+			dec.reset();
+			dec.MSenabled = dec.MUenabled = dec.MCenabled = true;
+			dec.setStreamCallback(&writeNothing);
+
+			const size_t step = trace.pulses.size() / maxSamples + 1;
+			for (size_t i = 0; i < trace.pulses.size(); i++)
+			{
+				int pulse = trace.pulses[i];
+				if (findpattFloat(dec, pulse) != dec.findpatt(pulse))
+					mismatches++;
+				if (i % step == 0 && samples.size() < maxSamples)
+				{
+					samples.push_back(FindpattSample{ dec, pulse });
+				}
+				dec.decode(&pulse);
+			}
+
+			// Best of several rounds over all samples
+			double nsOld = 0, nsNew = 0;
+			unsigned long long cycOld = 0, cycNew = 0;
+			volatile int sink = 0;
+			for (uint8_t r = 0; r < rounds; r++)
+			{
+				benchClock::time_point start = benchClock::now();
+				unsigned long long cycles = BENCH_CYCLES();
+				int sum = 0;
+				for (FindpattSample &s : samples)
+					sum += findpattFloat(s.dec, s.val);
+				cycles = BENCH_CYCLES() - cycles;
+				double ns = double(std::chrono::duration_cast<std::chrono::nanoseconds>(benchClock::now() - start).count());
+				if (r == 0 || ns < nsOld) { nsOld = ns; cycOld = cycles; }
+
+				start = benchClock::now();
+				cycles = BENCH_CYCLES();
+				for (FindpattSample &s : samples)
+					sum += s.dec.findpatt(s.val);
+				cycles = BENCH_CYCLES() - cycles;
+				ns = double(std::chrono::duration_cast<std::chrono::nanoseconds>(benchClock::now() - start).count());
+				if (r == 0 || ns < nsNew) { nsNew = ns; cycNew = cycles; }
+				sink = sink + sum;
+			}
+			const double n = samples.empty() ? 1.0 : double(samples.size());
+			printf("%-12s %12.2f %12.2f %12.1f %12.1f\n", trace.name.c_str(), nsOld / n, nsNew / n, cycOld / n, cycNew / n);
+		}
+		if (mismatches > 0)
+			printf("findpatt FAILED, %zu pulses matched a different pattern than the float implementation\n", mismatches);
+		printf("\n");
+		return mismatches;
+	}
+
+
+	// Repeated transmission like the decoder sees it: a frame is added pulse by pulse, the message is scanned
+	// once per frame (like getClock / getSync do) and consumed frames are removed from the front of the buffer
+	template<class Store>
+	static uint32_t runMessageStore(Store &store, const std::vector<uint8_t> &values, const uint8_t frameLen)
+	{
+		uint32_t hash = 2166136261u;
+		store.reset();
+		for (size_t i = 0; i < values.size(); i++)
+		{
+			if (!store.addValue(values[i]))
+			{
+				store.moveLeft(frameLen);
+				store.addValue(values[i]);
+			}
+			if ((i + 1) % frameLen != 0)
+				continue;
+			for (int16_t idx = 0; idx < store.valcount; idx++)
+				hash = (hash ^ uint8_t(store[idx])) * 16777619u;
+			if (store.valcount > 3 * frameLen)
+				store.moveLeft(frameLen);
+		}
+		return hash;
+	}
+
+	size_t benchMessageStore()
+	{
+		const uint8_t frameLen = 60;
+		const uint8_t repeats = 10;
+		const uint8_t rounds = 50;
+
+		std::vector<uint8_t> values;
+		XorShift32 rnd(0x5702E);
+		for (uint16_t f = 0; f < 40; f++)
+		{
+			uint8_t frame[frameLen];
+			for (uint8_t i = 0; i < frameLen; i++)
+				frame[i] = uint8_t(rnd.range(0, 7));
+			for (uint8_t r = 0; r < repeats; r++)
+				values.insert(values.end(), frame, frame + frameLen);
+		}
+
+		BitStore<SignalDetectorClass::bufferSize / 2, 4> linear;
+		RingBitStore<SignalDetectorClass::bufferSize / 2, 4> ring;
+		double nsOld = 0, nsNew = 0;
+		unsigned long long cycOld = 0, cycNew = 0;
+		uint32_t hashOld = 0, hashNew = 0;
+		for (uint8_t r = 0; r < rounds; r++)
+		{
+			benchClock::time_point start = benchClock::now();
+			unsigned long long cycles = BENCH_CYCLES();
+			hashOld = runMessageStore(linear, values, frameLen);
+			cycles = BENCH_CYCLES() - cycles;
+			double ns = double(std::chrono::duration_cast<std::chrono::nanoseconds>(benchClock::now() - start).count());
+			if (r == 0 || ns < nsOld) { nsOld = ns; cycOld = cycles; }
+
+			start = benchClock::now();
+			cycles = BENCH_CYCLES();
+			hashNew = runMessageStore(ring, values, frameLen);
+			cycles = BENCH_CYCLES() - cycles;
+			ns = double(std::chrono::duration_cast<std::chrono::nanoseconds>(benchClock::now() - start).count());
+			if (r == 0 || ns < nsNew) { nsNew = ns; cycNew = cycles; }
+		}
+		const double n = double(values.size());
+		printf("%-12s %12s %12s %12s %12s\n", "msg store", "linear ns", "ring ns", "linear cyc", "ring cyc");
+		printf("%-12s %12.2f %12.2f %12.1f %12.1f\n", "repeat10", nsOld / n, nsNew / n, cycOld / n, cycNew / n);
+		if (hashOld != hashNew)
+			printf("msg store FAILED, ring store content differs from BitStore\n");
+		printf("\n");
+		return hashOld != hashNew ? 1 : 0;
+	}
+
+
+	// compress_pattern() up to 3.3.1: the message is rescanned with message[i] / changeValue for every merged pair
+	static void compressPatternRescan(SignalDetectorClass &dec)
+	{
+		for (uint8_t idx = 0; idx < dec.patternLen - 1; idx++)
+		{
+			if (dec.histo[idx] == 0)
+				continue;
+			for (uint8_t idx2 = idx + 1; idx2 < dec.patternLen; idx2++)
+			{
+				if (dec.histo[idx2] == 0 || (dec.pattern[idx] ^ dec.pattern[idx2]) < 0)
+					continue;
+				const int16_t tol = int(((abs(dec.pattern[idx2])*dec.tolFact) + (abs(dec.pattern[idx])*dec.tolFact)) / 2);
+				if (dec.inTol(dec.pattern[idx2], dec.pattern[idx], tol))
+				{
+					uint8_t change_count = 0;
+					for (uint8_t i = 0; i < dec.messageLen && change_count < dec.histo[idx2]; i++)
+					{
+						if (dec.message[i] == idx2)
+						{
+							dec.message.changeValue(i, idx);
+							change_count++;
+						}
+					}
+					int sum = dec.histo[idx] + dec.histo[idx2];
+					dec.pattern[idx] = ((long(dec.pattern[idx]) * dec.histo[idx]) + (long(dec.pattern[idx2]) * dec.histo[idx2])) / sum;
+					dec.histo[idx] += dec.histo[idx2];
+					dec.pattern[idx2] = dec.histo[idx2] = 0;
+				}
+			}
+		}
+		dec.updPatternIndex();
+	}
+
+	static bool sameState(const SignalDetectorClass &a, const SignalDetectorClass &b)
+	{
+		if (memcmp(a.pattern, b.pattern, sizeof(a.pattern)) != 0 || memcmp(a.histo, b.histo, sizeof(a.histo)) != 0)
+			return false;
+		for (int16_t i = 0; i < a.messageLen; i++)
+			if (a.message[i] != b.message[i])
+				return false;
+		return true;
+	}
+
+	size_t benchCompressPattern(const std::vector<PulseTrace> &traces)
+	{
+		const size_t maxSamples = 1024;
+		const uint8_t rounds = 20;
+		size_t mismatches = 0;
+
+		printf("%-12s %8s %12s %12s %12s %12s\n", "compress", "merges", "rescan ns", "remap ns", "rescan cyc", "remap cyc");
+		for (const PulseTrace &trace : traces)
+		{
+			// Every decoder state with a message long enough for processMessage is checked against the rescan
+			// implementation. The timed samples have their most used pattern split into two mergeable ones
+			std::vector<SignalDetectorClass> samples;
+			samples.reserve(maxSamples);
+			SignalDetectorClass dec;
+			dec.reset();
+			dec.MSenabled = dec.MUenabled = dec.MCenabled = true;
+			dec.setStreamCallback(&writeNothing);
+			const size_t step = trace.pulses.size() / maxSamples + 1;
+			size_t merges = 0;
+			for (size_t i = 0; i < trace.pulses.size(); i++)
+			{
+				int pulse = trace.pulses[i];
+				dec.decode(&pulse);
+				if (dec.messageLen < minMessageLen)
+					continue;
+				SignalDetectorClass ref = dec, cur = dec;
+				compressPatternRescan(ref);
+				cur.compress_pattern();
+				if (!sameState(ref, cur)) mismatches++;
+				if (memcmp(ref.pattern, dec.pattern, sizeof(ref.pattern)) != 0)
+					merges++;
+				if (i % step == 0 && dec.patternLen < SignalDetectorClass::patternCount)
+				{
+					// findpatt rarely leaves two mergeable patterns, split the most used one to time the remap
+					SignalDetectorClass split = dec;
+					uint8_t most = 0;
+					for (uint8_t p = 1; p < split.patternLen; p++)
+						if (split.histo[p] > split.histo[most]) most = p;
+					const uint8_t added = split.patternLen++;
+					split.pattern[added] = split.pattern[most] + split.pattern[most] / 16;
+					for (int16_t m = 0, n = 0; m < split.messageLen; m++)
+						if (split.message[m] == most && (n++ & 1))
+							split.message.changeValue(m, added);
+					split.calcHisto();
+					split.calcPatternIndex();
+					samples.push_back(split);
+
+					ref = cur = split;
+					compressPatternRescan(ref);
+					cur.compress_pattern();
+					if (!sameState(ref, cur)) mismatches++;
+				}
+			}
+			std::vector<SignalDetectorClass> work;
+
+			double nsOld = 0, nsNew = 0;
+			unsigned long long cycOld = 0, cycNew = 0;
+			for (uint8_t r = 0; r < rounds; r++)
+			{
+				work = samples;
+				benchClock::time_point start = benchClock::now();
+				unsigned long long cycles = BENCH_CYCLES();
+				for (SignalDetectorClass &s : work)
+					compressPatternRescan(s);
+				cycles = BENCH_CYCLES() - cycles;
+				double ns = double(std::chrono::duration_cast<std::chrono::nanoseconds>(benchClock::now() - start).count());
+				if (r == 0 || ns < nsOld) { nsOld = ns; cycOld = cycles; }
+
+				work = samples;
+				start = benchClock::now();
+				cycles = BENCH_CYCLES();
+				for (SignalDetectorClass &s : work)
+					s.compress_pattern();
+				cycles = BENCH_CYCLES() - cycles;
+				ns = double(std::chrono::duration_cast<std::chrono::nanoseconds>(benchClock::now() - start).count());
+				if (r == 0 || ns < nsNew) { nsNew = ns; cycNew = cycles; }
+			}
+			const double n = samples.empty() ? 1.0 : double(samples.size());
+			printf("%-12s %8zu %12.2f %12.2f %12.1f %12.1f\n", trace.name.c_str(), merges, nsOld / n, nsNew / n, cycOld / n, cycNew / n);
+		}
+		if (mismatches > 0)
+			printf("compress_pattern FAILED, %zu states differ from the rescan implementation\n", mismatches);
+		printf("\n");
+		return mismatches;
+	}
+
+}
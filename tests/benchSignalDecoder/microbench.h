@@ -0,0 +1,13 @@
+#pragma once
+
+#include "traces.h"
+
+namespace bench {
+
+	// Micro benchmarks for single decoder functions, each compares the current implementation against a
+	// reference copy of the previous one and fails if both disagree. Return the number of mismatches.
+	size_t benchFindpatt(const std::vector<PulseTrace> &traces);
+	size_t benchMessageStore();
+	size_t benchCompressPattern(const std::vector<PulseTrace> &traces);
+
+}
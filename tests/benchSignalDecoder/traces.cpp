@@ -0,0 +1,189 @@
+#include "traces.h"
+
+#include <stdlib.h>
+
+namespace bench {
+
+	const int tracePause = -32001;   // maxPulse, same value the cronjob inserts after silence
+	const size_t tracePulses = 120000; // Approximate number of pulses for every trace
+
+	// Recorded signals, taken from real receivers (see tests/testSignalDecoder/tests.cpp)
+	struct RecordedSignal
+	{
+		const char *name;
+		const char *sigdata;
+	};
+
+	static const RecordedSignal recordedSignals[] = {
+		{ "ms_ncws", "MS;P0=-3886;P1=481;P2=-1938;P3=-9200;D=13121012101010101010121012101212121212121210101212121012121212101010101212;" },
+		{ "ms_s522", "MS;P1=-8055;P2=488;P3=-2049;P4=-3956;D=2121232324232323232323242323242323242323232424242324242323232323232323232323232324242324;" },
+		{ "mu_tx3", "MU;P0=1274;P1=-1037;P2=505;P3=-27698;D=010121012101212121010101010101212121012101210121010101010101012101210121010101010123010101012101210121212101010101010121212101210121012101010101010101210121012101010101012301010101210121012121210101010101012121210121012101210101010101010121012101210;" },
+		{ "mu_maverick", "MU;P0=-288;P1=211;P2=467;P3=-4872;P4=-527;D=3131313131313131324242424201410201410201424242424102014102014242410201410242014242424242424242424242424241024201410242014102420142424102014102;" },
+		{ "mc_osv2", "MU;P0=-7452;P1=956;P2=-994;P3=-517;P4=463;D=01212121212121212121212121212121342431342431213421212431342431213424313421212121212124313421243134212121212431342121212121243121342431342431342431342121212121212121212431212134212121212431342431213424312134212431213424312134212431;" },
+		{ "mc_hideki", "MU;P0=-100;P1=943;P2=-1011;P3=-539;P4=437;D=01212134342431243121342434312134342124312124313421213434243434343134343434212434343134243434312431212121342124343434343134342434343430;" },
+	};
+
+
+	void appendPulse(std::vector<int> *pulses, const int pulse)
+	{
+		// The ISR never delivers two pulses with the same sign, they are merged into one level
+		if (!pulses->empty() && (pulses->back() ^ pulse) >= 0)
+		{
+			long sum = long(pulses->back()) + pulse;
+			if (sum > -tracePause) sum = -tracePause;
+			if (sum < tracePause) sum = tracePause;
+			pulses->back() = int(sum);
+			return;
+		}
+		pulses->push_back(pulse);
+	}
+
+	bool appendSigdata(std::vector<int> *pulses, const std::string &sigdata, XorShift32 *rnd, const uint8_t jitterPct)
+	{
+		int buckets[16] = {};
+		size_t startpos = 0;
+		bool dataFound = false;
+		while (startpos < sigdata.length())
+		{
+			size_t endpos = sigdata.find(';', startpos);
+			if (endpos == std::string::npos) endpos = sigdata.length();
+
+			if (sigdata[startpos] == 'P' && endpos - startpos > 3 && sigdata[startpos + 2] == '=')
+			{
+				buckets[(sigdata[startpos + 1] - '0') & 0xF] = atoi(sigdata.c_str() + startpos + 3);
+			}
+			else if (sigdata[startpos] == 'D' && endpos - startpos > 2 && sigdata[startpos + 1] == '=')
+			{
+				for (size_t i = startpos + 2; i < endpos; i++)
+				{
+					int pulse = buckets[(sigdata[i] - '0') & 0xF];
+					if (rnd != nullptr && jitterPct > 0)
+					{
+						const int maxJitter = abs(pulse) * jitterPct / 100;
+						pulse += rnd->range(-maxJitter, maxJitter);
+					}
+					appendPulse(pulses, pulse);
+				}
+				dataFound = true;
+			}
+			startpos = endpos + 1;
+		}
+		return dataFound;
+	}
+
+	void appendManchester(std::vector<int> *pulses, const std::string &hexdata, const int clock)
+	{
+		for (size_t i = 0; i < hexdata.length(); i++)
+		{
+			const char c = hexdata[i];
+			const int8_t b = c - (c <= '9' ? '0' : (c <= 'F' ? 'A' - 10 : 'a' - 10));
+			for (uint8_t bit = 0x8; bit > 0; bit >>= 1)
+			{
+				appendPulse(pulses, (b & bit) ? clock : -clock);
+				appendPulse(pulses, (b & bit) ? -clock : clock);
+			}
+		}
+	}
+
+	static PulseTrace recordedTrace(const RecordedSignal &signal, const uint32_t seed)
+	{
+		PulseTrace trace;
+		XorShift32 rnd(seed);
+		trace.name = signal.name;
+		while (trace.pulses.size() < tracePulses)
+		{
+			// Remotes and sensors repeat their frame a few times, then the air is silent
+			const uint8_t repeats = rnd.range(3, 6);
+			for (uint8_t r = 0; r < repeats; r++)
+				appendSigdata(&trace.pulses, signal.sigdata, &rnd, 3);
+			appendPulse(&trace.pulses, tracePause);
+		}
+		return trace;
+	}
+
+	// PT2262 / EV1527 style remote: clock 350 µs, sync 1:31, 24 data bits
+	static PulseTrace syntheticMS(const uint32_t seed)
+	{
+		PulseTrace trace;
+		XorShift32 rnd(seed);
+		trace.name = "ms_synth";
+		while (trace.pulses.size() < tracePulses)
+		{
+			const uint32_t code = rnd.next() & 0xFFFFFF;
+			for (uint8_t r = 0; r < 5; r++)
+			{
+				appendPulse(&trace.pulses, rnd.range(340, 360));
+				appendPulse(&trace.pulses, -rnd.range(10700, 10900));
+				for (int8_t b = 23; b >= 0; b--)
+				{
+					const bool one = (code >> b) & 1;
+					appendPulse(&trace.pulses, one ? rnd.range(1030, 1070) : rnd.range(340, 360));
+					appendPulse(&trace.pulses, one ? -rnd.range(340, 360) : -rnd.range(1030, 1070));
+				}
+			}
+			appendPulse(&trace.pulses, tracePause);
+		}
+		return trace;
+	}
+
+	// Manchester sensor: clock 490 µs, preamble 0xAAAA, 64 random data bits
+	static PulseTrace syntheticMC(const uint32_t seed)
+	{
+		PulseTrace trace;
+		XorShift32 rnd(seed);
+		trace.name = "mc_synth";
+		static const char hexChars[] = "0123456789ABCDEF";
+		while (trace.pulses.size() < tracePulses)
+		{
+			std::string hexdata = "AAAAAAAA";
+			for (uint8_t i = 0; i < 16; i++)
+				hexdata += hexChars[rnd.next() & 0xF];
+			for (uint8_t r = 0; r < 2; r++)
+			{
+				appendManchester(&trace.pulses, hexdata, 490);
+				appendPulse(&trace.pulses, -rnd.range(9000, 10000));
+			}
+			appendPulse(&trace.pulses, tracePause);
+		}
+		return trace;
+	}
+
+	// Random pulse widths as produced by a cheap receiver without any transmission
+	static PulseTrace syntheticNoise(const uint32_t seed)
+	{
+		PulseTrace trace;
+		XorShift32 rnd(seed);
+		trace.name = "noise";
+		int sign = 1;
+		while (trace.pulses.size() < tracePulses)
+		{
+			appendPulse(&trace.pulses, sign * rnd.range(90, 4000));
+			sign = -sign;
+		}
+		return trace;
+	}
+
+	std::vector<PulseTrace> buildTraces()
+	{
+		std::vector<PulseTrace> traces;
+		uint32_t seed = 0x5D1C0DE;
+		for (const RecordedSignal &signal : recordedSignals)
+			traces.push_back(recordedTrace(signal, seed++));
+
+		traces.push_back(syntheticMS(seed++));
+		traces.push_back(syntheticMC(seed++));
+		traces.push_back(syntheticNoise(seed++));
+
+		// Mixed traffic, as seen on a busy site
+		PulseTrace mixed;
+		mixed.name = "mixed";
+		for (const PulseTrace &trace : traces)
+			for (size_t i = 0; i < trace.pulses.size(); i += 7919)
+				for (size_t j = i; j < i + 2000 && j < trace.pulses.size(); j++)
+					appendPulse(&mixed.pulses, trace.pulses[j]);
+		traces.push_back(mixed);
+
+		return traces;
+	}
+
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace bench {
+
+	// A sequence of signed pulse durations (µs) as delivered by the receive ISR: positive = high, negative = low
+	struct PulseTrace
+	{
+		std::string name;
+		std::vector<int> pulses;
+	};
+
+	// Deterministic pseudo random generator, so every run replays exactly the same pulses
+	class XorShift32
+	{
+	public:
+		XorShift32(uint32_t seed) : state(seed ? seed : 0x2545F491) { }
+		uint32_t next() { state ^= state << 13; state ^= state >> 17; state ^= state << 5; return state; }
+		int range(const int lo, const int hi) { return lo + int(next() % uint32_t(hi - lo + 1)); }
+	private:
+		uint32_t state;
+	};
+
+	void appendPulse(std::vector<int> *pulses, const int pulse);
+	bool appendSigdata(std::vector<int> *pulses, const std::string &sigdata, XorShift32 *rnd = nullptr, const uint8_t jitterPct = 0);
+	void appendManchester(std::vector<int> *pulses, const std::string &hexdata, const int clock);
+
+	std::vector<PulseTrace> buildTraces();
+
+}
@@ -0,0 +1,295 @@
+#include "pulsetrace.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace pulsetrace {
+
+	//========================= Byte order =================================================
+	// The headers are stored little endian byte by byte, independent of the layout of the structs on the host
+
+	static void putLE(uint8_t *p, const uint64_t val, const uint8_t bytes)
+	{
+		for (uint8_t i = 0; i < bytes; i++)
+			p[i] = uint8_t(val >> (8 * i));
+	}
+
+	static uint64_t getLE(const uint8_t *p, const uint8_t bytes)
+	{
+		uint64_t val = 0;
+		for (uint8_t i = 0; i < bytes; i++)
+			val |= uint64_t(p[i]) << (8 * i);
+		return val;
+	}
+
+	static bool hostLittleEndian()
+	{
+		const uint16_t probe = 1;
+		return *(const uint8_t*)&probe == 1;
+	}
+
+	static void encodeFileHeader(const FileHeader &header, uint8_t *out)
+	{
+		memcpy(out, header.magic, sizeof(header.magic));
+		putLE(out + 4, header.version, 2);
+		putLE(out + 6, header.headerSize, 2);
+		putLE(out + 8, header.reserved[0], 4);
+		putLE(out + 12, header.reserved[1], 4);
+	}
+
+	static void decodeFileHeader(const uint8_t *in, FileHeader *header)
+	{
+		memcpy(header->magic, in, sizeof(header->magic));
+		header->version = uint16_t(getLE(in + 4, 2));
+		header->headerSize = uint16_t(getLE(in + 6, 2));
+		header->reserved[0] = uint32_t(getLE(in + 8, 4));
+		header->reserved[1] = uint32_t(getLE(in + 12, 4));
+	}
+
+	static void encodeBlockHeader(const BlockHeader &header, uint8_t *out)
+	{
+		putLE(out, header.timestamp, 8);
+		putLE(out + 8, header.pulseCount, 4);
+		putLE(out + 12, uint16_t(header.rssi), 2);
+		out[14] = header.sourceId;
+		out[15] = header.reserved;
+	}
+
+	static void decodeBlockHeader(const uint8_t *in, BlockHeader *header)
+	{
+		header->timestamp = getLE(in, 8);
+		header->pulseCount = uint32_t(getLE(in + 8, 4));
+		header->rssi = int16_t(uint16_t(getLE(in + 12, 2)));
+		header->sourceId = in[14];
+		header->reserved = in[15];
+	}
+
+	//========================= Reader =====================================================
+
+	Reader::Reader() : data(nullptr), len(0), dataStart(0), pos(0), mapped(false)
+	{
+	}
+
+	Reader::~Reader()
+	{
+		close();
+	}
+
+	bool Reader::open(const char *filename)
+	{
+		close();
+		if (!hostLittleEndian()) { lastError = "pulses are mapped without conversion, big endian hosts are not supported"; return false; }
+#if defined(_WIN32)
+		HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (file == INVALID_HANDLE_VALUE) { lastError = "unable to open file"; return false; }
+		LARGE_INTEGER fileSize;
+		GetFileSizeEx(file, &fileSize);
+		len = size_t(fileSize.QuadPart);
+		HANDLE mapping = len > 0 ? CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL) : NULL;
+		CloseHandle(file);
+		if (mapping != NULL)
+		{
+			data = (const uint8_t*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+			CloseHandle(mapping);
+		}
+#else
+		const int fd = ::open(filename, O_RDONLY);
+		if (fd < 0) { lastError = "unable to open file"; return false; }
+		struct stat st;
+		if (fstat(fd, &st) == 0 && st.st_size > 0)
+		{
+			len = size_t(st.st_size);
+			void *p = mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (p != MAP_FAILED)
+			{
+				madvise(p, len, MADV_SEQUENTIAL);
+				data = (const uint8_t*)p;
+			}
+		}
+		::close(fd);
+#endif
+		if (data == nullptr) { lastError = "unable to map file"; len = 0; return false; }
+		mapped = true;
+
+		FileHeader header;
+		if (len < sizeof(header)) { close(); lastError = "file too short"; return false; }
+		decodeFileHeader(data, &header);
+		if (memcmp(header.magic, fileMagic, sizeof(fileMagic)) != 0) { close(); lastError = "not a pulse trace file"; return false; }
+		if (header.version != fileVersion) { close(); lastError = "unsupported version"; return false; }
+		if (header.headerSize < sizeof(header) || header.headerSize > len) { close(); lastError = "invalid header"; return false; }
+
+		dataStart = pos = header.headerSize;
+		lastError.clear();
+		return true;
+	}
+
+	void Reader::close()
+	{
+		if (data != nullptr && mapped)
+		{
+#if defined(_WIN32)
+			UnmapViewOfFile(data);
+#else
+			munmap((void*)data, len);
+#endif
+		}
+		data = nullptr;
+		len = dataStart = pos = 0;
+		mapped = false;
+	}
+
+	bool Reader::nextBlock(Block *block)
+	{
+		if (data == nullptr || pos >= len)
+			return false;
+		if (len - pos < sizeof(BlockHeader)) { lastError = "truncated block header"; pos = len; return false; }
+
+		decodeBlockHeader(data + pos, &block->header);
+		const size_t payload = size_t(block->header.pulseCount) * sizeof(int16_t);
+		if (len - pos - sizeof(BlockHeader) < payload) { lastError = "truncated block"; pos = len; return false; }
+
+		block->pulses = (const int16_t*)(data + pos + sizeof(BlockHeader));
+		pos += sizeof(BlockHeader) + payload;
+		return true;
+	}
+
+	//========================= Writer =====================================================
+
+	Writer::Writer() : file(nullptr), blockOpen(false), blocks(0)
+	{
+	}
+
+	Writer::~Writer()
+	{
+		close();
+	}
+
+	bool Writer::open(const char *filename)
+	{
+		close();
+		file = fopen(filename, "wb");
+		if (file == nullptr)
+			return false;
+
+		FileHeader header = {};
+		memcpy(header.magic, fileMagic, sizeof(fileMagic));
+		header.version = fileVersion;
+		header.headerSize = sizeof(header);
+		blocks = 0;
+		uint8_t raw[sizeof(FileHeader)];
+		encodeFileHeader(header, raw);
+		return fwrite(raw, sizeof(raw), 1, file) == 1;
+	}
+
+	bool Writer::close()
+	{
+		if (file == nullptr)
+			return true;
+		bool ok = endBlock();
+		ok &= fclose(file) == 0;
+		file = nullptr;
+		return ok;
+	}
+
+	void Writer::beginBlock(const uint64_t timestamp, const int16_t rssi, const uint8_t sourceId)
+	{
+		endBlock();
+		current = BlockHeader();
+		current.timestamp = timestamp;
+		current.rssi = rssi;
+		current.sourceId = sourceId;
+		blockOpen = true;
+	}
+
+	void Writer::addPulse(const int pulse)
+	{
+		if (!blockOpen) beginBlock(0);
+		pending.push_back(clampPulse(pulse));
+	}
+
+	bool Writer::endBlock()
+	{
+		if (!blockOpen)
+			return true;
+		blockOpen = false;
+		const bool ok = writeBlock(current.timestamp, current.rssi, current.sourceId, pending.data(), uint32_t(pending.size()));
+		pending.clear();
+		return ok;
+	}
+
+	bool Writer::writeBlock(const uint64_t timestamp, const int16_t rssi, const uint8_t sourceId, const int16_t *pulses, const uint32_t count)
+	{
+		if (file == nullptr)
+			return false;
+		BlockHeader header = {};
+		header.timestamp = timestamp;
+		header.pulseCount = count;
+		header.rssi = rssi;
+		header.sourceId = sourceId;
+		uint8_t raw[sizeof(BlockHeader)];
+		encodeBlockHeader(header, raw);
+		if (fwrite(raw, sizeof(raw), 1, file) != 1)
+			return false;
+		for (uint32_t i = 0; i < count; i++)
+		{
+			uint8_t pulse[2];
+			putLE(pulse, uint16_t(pulses[i]), 2);
+			if (fwrite(pulse, sizeof(pulse), 1, file) != 1)
+				return false;
+		}
+		blocks++;
+		return true;
+	}
+
+	//========================= Helpers ====================================================
+
+	int16_t clampPulse(const int pulse)
+	{
+		if (pulse > INT16_MAX) return INT16_MAX;
+		if (pulse < -INT16_MAX) return -INT16_MAX;
+		return int16_t(pulse);
+	}
+
+	bool parseSigdata(const char *sigdata, std::vector<int16_t> *pulses, int16_t *rssi)
+	{
+		int16_t buckets[10] = {};
+		bool dataFound = false;
+		const char *part = sigdata;
+		while (*part != '\0')
+		{
+			const char *end = strchr(part, ';');
+			if (end == nullptr) end = part + strlen(part);
+
+			if (part[0] == 'P' && part[1] >= '0' && part[1] <= '9' && part[2] == '=')
+			{
+				buckets[part[1] - '0'] = clampPulse(atoi(part + 3));
+			}
+			else if (part[0] == 'D' && part[1] == '=')
+			{
+				for (const char *c = part + 2; c < end; c++)
+				{
+					if (*c < '0' || *c > '9')
+						return false;		// Reduced (Ms / Mu) or manchester data can't be converted
+					pulses->push_back(buckets[*c - '0']);
+				}
+				dataFound = true;
+			}
+			else if (part[0] == 'R' && part[1] == '=' && rssi != nullptr)
+			{
+				*rssi = int16_t(atoi(part + 2));
+			}
+			part = *end == '\0' ? end : end + 1;
+		}
+		return dataFound;
+	}
+
+}
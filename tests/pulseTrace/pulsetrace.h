@@ -0,0 +1,116 @@
+#pragma once
+// pulsetrace.h : Binary pulse trace files (*.sdt) for replaying recorded receiver traffic on the host.
+//
+// File layout, all values little endian (the headers are converted on every host, the pulses are mapped without
+// conversion, so the Reader rejects big endian hosts):
+//
+//   FileHeader   16 bytes   magic "SDTR", version, header size, reserved
+//   Block 0      16 bytes   BlockHeader: timestamp (µs), pulse count, RSSI, source ID
+//                n * 2      int16 pulse durations in µs, positive = high, negative = low
+//   Block 1      ...
+//
+// A block holds the pulses of one burst (e.g. one received transmission or one capture interval).
+// The timestamp is the start of the first pulse, measured from the start of the recording.
+// Pulses are limited to +/- 32767 µs, longer levels are stored as +/- maxPulse like the receive ISR does.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+namespace pulsetrace {
+
+	const char fileMagic[4] = { 'S', 'D', 'T', 'R' };
+	const uint16_t fileVersion = 1;
+	const int16_t rssiUnknown = INT16_MIN;
+
+	struct FileHeader
+	{
+		char magic[4];
+		uint16_t version;
+		uint16_t headerSize;	// Size of this header, blocks start right after it
+		uint32_t reserved[2];
+	};
+
+	struct BlockHeader
+	{
+		uint64_t timestamp;		// µs since start of recording
+		uint32_t pulseCount;
+		int16_t rssi;			// Raw receiver value or rssiUnknown
+		uint8_t sourceId;		// Receiver / site which recorded the block
+		uint8_t reserved;
+	};
+
+	static_assert(sizeof(FileHeader) == 16, "FileHeader must be packed to 16 bytes");
+	static_assert(sizeof(BlockHeader) == 16, "BlockHeader must be packed to 16 bytes");
+
+	// One block of a mapped trace, pulses point directly into the mapped file
+	struct Block
+	{
+		BlockHeader header;
+		const int16_t *pulses;
+	};
+
+	// Maps a trace file into memory and iterates over its blocks without copying the pulses
+	class Reader
+	{
+	public:
+		Reader();
+		~Reader();
+
+		bool open(const char *filename);
+		void close();
+		bool isOpen() const { return data != nullptr; }
+
+		bool nextBlock(Block *block);			// false at end of file or on a truncated block, see error()
+		void rewind() { pos = dataStart; }
+
+		size_t size() const { return len; }
+		const std::string &error() const { return lastError; }
+
+	private:
+		Reader(const Reader&);
+		Reader &operator=(const Reader&);
+
+		const uint8_t *data;
+		size_t len;
+		size_t dataStart;
+		size_t pos;
+		bool mapped;
+		std::string lastError;
+	};
+
+	// Writes a trace file. Pulses can be added one by one and are collected until endBlock() or the next beginBlock()
+	class Writer
+	{
+	public:
+		Writer();
+		~Writer();
+
+		bool open(const char *filename);
+		bool close();
+
+		void beginBlock(const uint64_t timestamp, const int16_t rssi = rssiUnknown, const uint8_t sourceId = 0);
+		void addPulse(const int pulse);
+		bool endBlock();
+		bool writeBlock(const uint64_t timestamp, const int16_t rssi, const uint8_t sourceId, const int16_t *pulses, const uint32_t count);
+
+		uint32_t blockCount() const { return blocks; }
+
+	private:
+		Writer(const Writer&);
+		Writer &operator=(const Writer&);
+
+		FILE *file;
+		BlockHeader current;
+		bool blockOpen;
+		std::vector<int16_t> pending;
+		uint32_t blocks;
+	};
+
+	int16_t clampPulse(const int pulse);
+
+	// Converts "P0=..;P1=..;D=0123..;" message parts (MS / MU output or test data) into pulses. Returns false if no data part was found
+	bool parseSigdata(const char *sigdata, std::vector<int16_t> *pulses, int16_t *rssi = nullptr);
+
+}
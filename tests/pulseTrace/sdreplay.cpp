@@ -0,0 +1,163 @@
+// sdreplay.cpp : Streams a recorded pulse trace (*.sdt) through SignalDetectorClass, like the firmware main loop does.
+//
+// Usage: sdreplay [--speed <factor>] [--source <id>] [--quiet] [--reduced] <trace.sdt>
+//          Replays the trace at maximum speed, or at <factor> times real time. Decoded messages go to stdout,
+//          the statistics to stderr. With --source only blocks recorded by receiver <id> are replayed.
+//
+//        sdreplay --convert <messages.txt> <trace.sdt> [--source <id>]
+//          Converts a log with one MS / MU message per line (e.g. "MS;P0=-3886;P1=481;D=0101..;") into a trace.
+//          The time between two messages is unknown, the converter inserts a pause of maxPulse.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <thread>
+
+#include <signalDecoder.h>
+#include "pulsetrace.h"
+
+using namespace pulsetrace;
+
+typedef std::chrono::steady_clock replayClock;
+
+static bool quiet = false;
+static uint32_t messages = 0;
+
+size_t writeCallback(const uint8_t *buf, uint8_t len)
+{
+	for (uint8_t i = 0; i < len; i++)
+		if (buf[i] == MSG_START) messages++;
+	if (!quiet)
+		fwrite(buf, 1, len, stdout);
+	return len;
+}
+
+static int convert(const char *inFile, const char *outFile, const uint8_t sourceId)
+{
+	FILE *in = fopen(inFile, "r");
+	if (in == nullptr) { fprintf(stderr, "Unable to open %s\n", inFile); return 2; }
+	Writer writer;
+	if (!writer.open(outFile)) { fprintf(stderr, "Unable to create %s\n", outFile); fclose(in); return 2; }
+
+	char line[4096];
+	std::vector<int16_t> pulses;
+	uint64_t timestamp = 0;
+	uint32_t skipped = 0;
+	while (fgets(line, sizeof(line), in) != nullptr)
+	{
+		const char *msg = strstr(line, "MS;");
+		if (msg == nullptr) msg = strstr(line, "MU;");
+		pulses.clear();
+		int16_t rssi = rssiUnknown;
+		if (msg == nullptr || !parseSigdata(msg + 3, &pulses, &rssi) || pulses.empty())
+		{
+			skipped++;
+			continue;
+		}
+		writer.writeBlock(timestamp, rssi, sourceId, pulses.data(), uint32_t(pulses.size()));
+		for (size_t i = 0; i < pulses.size(); i++)
+			timestamp += uint64_t(abs(pulses[i]));
+		timestamp += maxPulse;
+	}
+	fclose(in);
+	const uint32_t blocks = writer.blockCount();
+	if (!writer.close()) { fprintf(stderr, "Error writing %s\n", outFile); return 2; }
+	fprintf(stderr, "%u blocks written, %u lines skipped\n", blocks, skipped);
+	return 0;
+}
+
+static int replay(const char *traceFile, const double speed, const int sourceFilter, const bool reduced)
+{
+	Reader reader;
+	if (!reader.open(traceFile)) { fprintf(stderr, "%s: %s\n", traceFile, reader.error().c_str()); return 2; }
+
+	SignalDetectorClass dec;
+	dec.reset();
+	dec.MSenabled = true;
+	dec.MUenabled = true;
+	dec.MCenabled = true;
+	dec.MredEnabled = reduced;
+	dec.setStreamCallback(&writeCallback);
+
+	uint64_t pulses = 0;
+	uint32_t blocks = 0;
+	uint64_t traceStart = 0;
+	uint64_t traceTime = 0;		// End of the last replayed pulse in trace time
+	const replayClock::time_point start = replayClock::now();
+
+	Block block;
+	while (reader.nextBlock(&block))
+	{
+		if (sourceFilter >= 0 && block.header.sourceId != sourceFilter)
+			continue;
+		if (blocks++ == 0)
+			traceStart = traceTime = block.header.timestamp;
+
+		// Silence between two blocks, the cronjob feeds maxPulse into the FIFO in this case
+		if (block.header.timestamp >= traceTime + maxPulse)
+		{
+			int pause = -maxPulse;
+			dec.decode(&pause);
+		}
+		traceTime = block.header.timestamp;
+
+		for (uint32_t i = 0; i < block.header.pulseCount; i++)
+		{
+			int pulse = block.pulses[i];
+			traceTime += uint64_t(abs(pulse));
+			if (speed > 0)
+			{
+				const replayClock::time_point due = start + std::chrono::microseconds(uint64_t((traceTime - traceStart) / speed));
+				if (due > replayClock::now() + std::chrono::milliseconds(2))
+					std::this_thread::sleep_until(due);
+			}
+			dec.decode(&pulse);
+		}
+		pulses += block.header.pulseCount;
+	}
+	if (blocks > 0)
+	{
+		// The recording ends with silence, the cronjob would feed maxPulse and the last message gets processed
+		int pause = -maxPulse;
+		dec.decode(&pause);
+	}
+	if (!reader.error().empty())
+		fprintf(stderr, "%s: %s\n", traceFile, reader.error().c_str());
+	fflush(stdout);
+
+	const double seconds = std::chrono::duration<double>(replayClock::now() - start).count();
+	fprintf(stderr, "%u blocks, %llu pulses, %u messages, %.3f s trace time, %.3f s replay time, %.0f pulses/s\n",
+		blocks, (unsigned long long)pulses, messages, (traceTime - traceStart) / 1e6, seconds, seconds > 0 ? pulses / seconds : 0.0);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	double speed = 0;
+	int sourceFilter = -1;
+	bool reduced = false;
+	const char *files[2] = { nullptr, nullptr };
+	uint8_t fileCount = 0;
+	bool convertMode = false;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--speed") == 0 && i + 1 < argc) speed = atof(argv[++i]);
+		else if (strcmp(argv[i], "--source") == 0 && i + 1 < argc) sourceFilter = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--quiet") == 0) quiet = true;
+		else if (strcmp(argv[i], "--reduced") == 0) reduced = true;
+		else if (strcmp(argv[i], "--convert") == 0) convertMode = true;
+		else if (argv[i][0] != '-' && fileCount < 2) files[fileCount++] = argv[i];
+		else { fileCount = 0; break; }
+	}
+
+	if (convertMode && fileCount == 2)
+		return convert(files[0], files[1], sourceFilter >= 0 ? uint8_t(sourceFilter) : 0);
+	if (!convertMode && fileCount == 1)
+		return replay(files[0], speed, sourceFilter, reduced);
+
+	fprintf(stderr, "Usage: %s [--speed <factor>] [--source <id>] [--quiet] [--reduced] <trace.sdt>\n", argv[0]);
+	fprintf(stderr, "       %s --convert <messages.txt> <trace.sdt> [--source <id>]\n", argv[0]);
+	return 2;
+}
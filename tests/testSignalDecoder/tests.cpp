@@ -62,6 +62,14 @@
 #endif
 
 #include "signalDecoder.h"
+#include "pulsetrace.h"
+#include "SPSCFifo.h"
+#include "receiverChannel.h"
+#include "txQueue.h"
+#include "outputHub.h"
+#include <thread>
+#include <algorithm>
+#include <chrono>
 
 namespace arduino { 
 	namespace test
@@ -76,6 +84,29 @@ namespace arduino {
 			return len;
 		}
 
+		size_t frameWrites = 0;
+		size_t countingWriteCallback(const uint8_t *buf, uint8_t len)
+		{
+			frameWrites++;
+			return writeCallback(buf, len);
+		}
+
+		// UART stand in for the output queue, takes room bytes per write and budget bytes in total (-1: no limit)
+		struct FakePort
+		{
+			int room = 0;
+			int budget = -1;
+			std::string out;
+			int availableForWrite() { return budget >= 0 && budget < room ? budget : room; }
+			bool connected() { return true; }
+			size_t write(const uint8_t *buf, size_t len) {
+				if (len > size_t(availableForWrite())) len = availableForWrite();
+				if (budget >= 0) budget -= len;
+				out.append((const char*)buf, len);
+				return len;
+			}
+		};
+
 		bool Tests::DigitalSimulate(const int pulse)
 		{
 			bool state = false;
@@ -223,6 +254,7 @@ namespace arduino {
 		  {
 			  ooDecode.pattern[0] = 908;
 			  ooDecode.patternLen = 1;
+			  ooDecode.calcPatternIndex();
 			  int8_t idx = ooDecode.findpatt(-1061);
 
 			  ASSERT_LT(idx, 0);
@@ -232,6 +264,36 @@ namespace arduino {
 
 		  }
 
+		  TEST_F(Tests, testFindPatternWindow)
+		  {
+			  // The integer windows must accept exactly the pulses which are within 20% of the pulse
+			  for (int p = 90; p <= 32001; p += 97)
+			  {
+				  ooDecode.pattern[0] = p;
+				  ooDecode.pattern[1] = -p;
+				  ooDecode.patternLen = 2;
+				  ooDecode.calcPatternIndex();
+				  for (int val = p / 2; val <= p * 2 && val <= 32001; val++)
+				  {
+					  const uint16_t tol = abs(val)*0.2;
+					  ASSERT_EQ(ooDecode.findpatt(val), ooDecode.inTol(val, p, tol) ? 0 : -1) << "p=" << p << " val=" << val;
+					  ASSERT_EQ(ooDecode.findpatt(-val), ooDecode.inTol(-val, -p, tol) ? 1 : -1) << "p=" << -p << " val=" << -val;
+				  }
+			  }
+
+			  // First matching pattern wins, patterns with an other sign or 0 are never returned
+			  ooDecode.pattern[0] = -1000;
+			  ooDecode.pattern[1] = 1100;
+			  ooDecode.pattern[2] = 0;
+			  ooDecode.pattern[3] = 1000;
+			  ooDecode.patternLen = 4;
+			  ooDecode.calcPatternIndex();
+			  ASSERT_EQ(ooDecode.findpatt(1050), 1);
+			  ASSERT_EQ(ooDecode.findpatt(900), 3);
+			  ASSERT_EQ(ooDecode.findpatt(-1050), 0);
+			  ASSERT_EQ(ooDecode.findpatt(0), -1);
+		  }
+
 		  TEST_F(Tests,testSamesign)
 		  {
 			  bool state;
@@ -291,6 +353,65 @@ namespace arduino {
 			  ASSERT_EQ(ooDecode.histo[2], 0);
 			  ASSERT_EQ(ooDecode.histo[3], 61);
 
+			  for (uint8_t i = 0; i < ooDecode.messageLen; i++)
+				  ASSERT_NE(ooDecode.message[i], 2);	// Merged into pattern 0
+			  ASSERT_TRUE(ooDecode.checkHisto());
+			  ASSERT_EQ(ooDecode.last, &ooDecode.pattern[ooDecode.message[ooDecode.messageLen - 1]]);
+		  }
+
+		  TEST_F(Tests, testCompressPatternWindow)
+		  {
+			  // 1000 and 1150 merge to 1075, a pulse above the window of 1000 matches the merged pattern
+			  for (uint8_t i = 0; i < 30; i++)
+			  {
+				  DigitalSimulate(1000);
+				  DigitalSimulate(-500);
+			  }
+			  ASSERT_EQ(2, ooDecode.patternLen);
+			  ooDecode.pattern[2] = 1150;
+			  ooDecode.patternLen = 3;
+			  for (uint8_t i = 0; i < ooDecode.messageLen; i += 4)
+				  ooDecode.message.changeValue(i, 2);
+			  ooDecode.calcHisto();
+			  ooDecode.calcPatternIndex();
+			  ASSERT_EQ(ooDecode.histo[0], ooDecode.histo[2]);
+			  ASSERT_LT(ooDecode.patternHi[0], 1300);
+
+			  ooDecode.compress_pattern();
+			  ASSERT_EQ(1075, ooDecode.pattern[0]);
+			  ASSERT_EQ(0, ooDecode.pattern[2]);
+			  ASSERT_EQ(0, ooDecode.findpatt(1300));
+			  ASSERT_EQ(0, ooDecode.findpatt(1340));
+			  ASSERT_EQ(-1, ooDecode.findpatt(1400));
+		  }
+
+		  TEST_F(Tests, testCompressPatternMergedMatch)
+		  {
+			  // 1000 and 1270 merge to 1135, pulses around the average are stored as the merged pattern
+			  for (uint8_t i = 0; i < 30; i++)
+			  {
+				  DigitalSimulate(i % 2 ? 1270 : 1000);
+				  DigitalSimulate(-500);
+			  }
+			  ASSERT_EQ(3, ooDecode.patternLen);
+			  ASSERT_EQ(ooDecode.histo[0], ooDecode.histo[2]);
+			  const int slot = ooDecode.pattern[0] == 1000 ? 0 : 2;
+			  ASSERT_EQ(2 - slot, ooDecode.findpatt(1280));
+
+			  ooDecode.compress_pattern();
+			  ASSERT_EQ(1135, ooDecode.pattern[slot]);
+			  ASSERT_EQ(0, ooDecode.pattern[2 - slot]);
+			  ASSERT_EQ(slot, ooDecode.findpatt(1135));
+			  ASSERT_EQ(slot, ooDecode.findpatt(1000));
+			  ASSERT_EQ(slot, ooDecode.findpatt(1280));
+
+			  const uint8_t len = ooDecode.messageLen;
+			  DigitalSimulate(1140);
+			  DigitalSimulate(-500);				// DigitalSimulate passes the pulse before
+			  ASSERT_EQ(len + 2, ooDecode.messageLen);
+			  ASSERT_EQ(slot, ooDecode.message[ooDecode.messageLen - 1]);
+			  ASSERT_EQ(3, ooDecode.patternLen);
+			  ASSERT_EQ(ooDecode.last, &ooDecode.pattern[slot]);
 		  }
 
 		  TEST_F(Tests, testOperatorPredecrement)
@@ -971,7 +1092,7 @@ namespace arduino {
 			bool state;
 			std::string dstr2 = "0B0F9FFA555AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAABAAAA";
 			state = import_mcdata(&dstr2, 0, dstr2.length(), 450);
-			ASSERT_FALSE(mcdecoder.isManchester());
+			ASSERT_TRUE(mcdecoder.isManchester());	// histo is kept up to date while adding data
 			ASSERT_EQ(253, ooDecode.messageLen);
 
 			ooDecode.calcHisto();
@@ -1065,35 +1186,15 @@ namespace arduino {
 			//std::string dstr2 = "0B0F9FFA555AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAABAAAAA";
 			std::string dstr2 = "0B0F9FFA555AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAB63AAA";
 			state = import_mcdata(&dstr2, 0, dstr2.length(), 450);
-			DigitalSimulate(1);
-			ooDecode.printOut();
 			ASSERT_FALSE(state);
-			ASSERT_EQ(4, ooDecode.messageLen);  // 254+3 is the number of pulses.
-			ASSERT_TRUE(ooDecode.mcDetected);  
-			ASSERT_EQ(223, mcdecoder.ManchesterBits.valcount-1);  // 254+3 is the number of pulses. At this time, we have processed only the buffer after bufferoverflow which is equal to 224 bits
-
-			ooDecode.calcHisto();
+			state = DigitalSimulate(1);
 			ooDecode.printOut();
-
-			/*mcdecoder.shorthigh = 0;
-			mcdecoder.shortlow = 1;
-			mcdecoder.longlow = 2;
-			mcdecoder.longhigh = 3;
-			mcdecoder.clock = 450;
-			*/
-
-			bool result = mcdecoder.doDecode();
-			ASSERT_EQ(226, mcdecoder.ManchesterBits.valcount - 1);
-			ASSERT_TRUE(result);
-
-			std::string mcStr;
-			std::string base;
-			mcStr = mcdecoder.getMessageHexStr();
-			ASSERT_STREQ(mcStr.c_str(), dstr2.c_str()); // may not compile or give warning
-														//mcdecoder.reset();
-			ASSERT_EQ(1, mcdecoder.ManchesterBits.getValue(220));
-			ASSERT_EQ(0, mcdecoder.ManchesterBits.getValue(221));
-			ASSERT_EQ(1, mcdecoder.ManchesterBits.getValue(222));
+			ASSERT_TRUE(state);  // The buffer was full, the rest was decoded pulse by pulse and the trailing half bit ended the signal
+			ASSERT_FALSE(ooDecode.mcDetected);
+			ASSERT_FALSE(mcdecoder.streaming);
+			ASSERT_EQ(0, mcdecoder.ManchesterBits.valcount);
+			ASSERT_NE(std::string::npos, outputStr.find("D=" + dstr2 + ";C=449;L=227;"));  // The whole message is printed once
+			ASSERT_EQ(outputStr.find("MC;"), outputStr.rfind("MC;"));
 		}
 
 		TEST_F(Tests, mcOSV11)
@@ -1110,7 +1211,7 @@ namespace arduino {
 
 				state = import_sigdata(&dstr);
 
-				ASSERT_FALSE(mcdecoder.isManchester());
+				ASSERT_TRUE(mcdecoder.isManchester());	// histo is kept up to date while adding data
 				ooDecode.calcHisto();
 				ooDecode.getClock();
 				ooDecode.getSync();
@@ -1459,6 +1560,80 @@ namespace arduino {
 
 
 
+		TEST_F(Tests, msStreamed)
+		{
+			// An MS message with 300 bits does not fit into the buffer, it is printed in parts which add up to the whole message
+			std::vector<int> pulses = { 500, -9000 };
+			for (int i = 0; i < 300; i++)
+			{
+				pulses.push_back(500);
+				pulses.push_back((i * 7) % 3 == 0 ? -2000 : -1000);
+			}
+			pulses.push_back(500);
+			ooDecode.decode(pulses.data(), pulses.size());
+			int gap = -32001;
+			ooDecode.decode(&gap);
+
+			std::vector<int16_t> streamed;
+			uint8_t parts = 0;
+			size_t pos = 0;
+			while ((pos = outputStr.find(MSG_START, pos)) != std::string::npos)
+			{
+				const size_t end = outputStr.find(MSG_END, pos);
+				const std::string msg = outputStr.substr(pos + 1, end - pos - 1);
+				pos = end;
+				ASSERT_EQ(0, msg.find("MS;")) << msg;
+				ASSERT_EQ(parts > 0, msg.find(";c=" + std::to_string(parts) + ";") != std::string::npos) << msg;
+				ASSERT_TRUE(pulsetrace::parseSigdata(msg.c_str() + 3, &streamed));
+				parts++;
+			}
+			ASSERT_EQ(3, parts);
+			ASSERT_EQ(std::vector<int16_t>(pulses.begin(), pulses.end()), streamed);
+			ASSERT_EQ(0, ooDecode.msPart);
+
+			// Binary parts after the first carry their number as the last byte before the crc
+			outputStr.clear();
+			ooDecode.reset();
+			ooDecode.MbinEnabled = true;
+			ooDecode.decode(pulses.data(), pulses.size());
+			ooDecode.decode(&gap);
+			parts = 0;
+			for (pos = 0; pos < outputStr.size(); parts++)
+			{
+				const uint8_t *frame = (const uint8_t*)outputStr.data() + pos;
+				const uint8_t len = frame[1];
+				ASSERT_EQ('S', frame[2]);
+				ASSERT_EQ(parts > 0, (frame[3] & MSG_BIN_CONTINUED) != 0);
+				if (parts > 0)
+					ASSERT_EQ(parts, frame[len + 1]);
+				pos += len + 4;
+			}
+			ASSERT_EQ(3, parts);
+		}
+
+		TEST_F(Tests, msFingerprint)
+		{
+			// A single transmission has only one sync, it is accepted as MS because it matches the first fingerprint
+			std::vector<int16_t> message;
+			ASSERT_TRUE(pulsetrace::parseSigdata("P0=-3886;P1=481;P2=-1938;P3=-9200;D=13121012101010101010121012101212121212121210101212121012121212101010101212;", &message));
+			std::vector<int> pulses(message.begin(), message.end());
+			pulses.push_back(-32001);
+			ooDecode.decode(pulses.data(), pulses.size());
+
+			ASSERT_EQ(0, outputStr.find(std::string(1, MSG_START) + "MS;")) << outputStr;
+			ASSERT_EQ(1u, ooDecode.counters.fingerprints[0]);
+			ASSERT_EQ(nullptr, ooDecode.mcdecoder);		// No manchester trial
+
+			// The same pulses with an unknown clock go the usual way and end up as MU
+			outputStr.clear();
+			ooDecode.reset();
+			for (int &p : pulses)
+				if (p > 0) p = 800;
+			ooDecode.decode(pulses.data(), pulses.size());
+			ASSERT_EQ(0, outputStr.find(std::string(1, MSG_START) + "MU;")) << outputStr;
+			ASSERT_EQ(1u, ooDecode.counters.fingerprints[0]);
+		}
+
 		TEST_F(Tests, muHeidemann)
 		{
 			unsigned int DMSG = 0x610;
@@ -1523,6 +1698,1261 @@ namespace arduino {
 			}
 		}
 
+		TEST_F(Tests, decodeBatch)
+		{
+			std::string dstr = "MS;P0=-3886;P1=481;P2=-1938;P3=-9200;D=13121012101010101010121012101212121212121210101212121012121212101010101212;";
+			std::vector<int16_t> sigdata;
+			ASSERT_TRUE(pulsetrace::parseSigdata(dstr.c_str() + 3, &sigdata));
+			std::vector<int> pulses;
+			for (uint8_t r = 0; r < 4; r++)
+				pulses.insert(pulses.end(), sigdata.begin(), sigdata.end());
+			pulses.push_back(-32001);
+
+			size_t found = 0;
+			for (size_t i = 0; i < pulses.size(); i++)
+				if (ooDecode.decode(&pulses[i])) found++;
+			const std::string singleOutput = outputStr;
+			ASSERT_NE(singleOutput.find("MS;"), std::string::npos);
+
+			for (size_t batch = 2; batch <= pulses.size(); batch += 37)
+			{
+				outputStr.clear();
+				ooDecode.reset();
+				size_t batchFound = 0;
+				for (size_t i = 0; i < pulses.size(); i += batch)
+					batchFound += ooDecode.decode(pulses.data() + i, std::min(batch, pulses.size() - i));
+				ASSERT_EQ(batchFound, found);
+				ASSERT_STREQ(outputStr.c_str(), singleOutput.c_str());
+			}
+		}
+
+		TEST_F(Tests, mcAfterShortMS)
+		{
+			// The sync pulse P5 starts an MS candidate which is too short, the message is checked for manchester with the counts of all its values
+			std::string dstr = "MU;P0=490;P1=-980;P2=980;P3=-490;P5=-9364;P6=1960;D=050121610323010323030123010501212121212121212121212121212121032303030121230303010303212103210303030303030303230303030123030103210303212103210323010323030123010;";
+			import_sigdata(&dstr, false);
+			std::string pstr = "MS;P0=-32001;D=0;";
+			import_sigdata(&pstr, false);
+			ASSERT_NE(outputStr.find("MC;LL=-980;LH=980;SL=-490;SH=490;D=55555555850EB7FC11BAD989;"), std::string::npos) << outputStr;
+		}
+
+		TEST_F(Tests, incrementalHisto)
+		{
+			// Signals followed by noise, so patterns get replaced, compressed and the buffer is moved
+			std::string dstr[] = {
+				"MS;P0=-3886;P1=481;P2=-1938;P3=-9200;D=13121012101010101010121012101212121212121210101212121012121212101010101212;",
+				"MU;P0=1274;P1=-1037;P2=505;P3=-27698;D=010121012101212121010101010101212121012101210121010101010101012101210121010101010123010101012101210121212101010101010121212101210121012101010101010101210121012101010101012301010101210121012121210101010101012121210121012101210101010101010121012101210;",
+			};
+			std::vector<int> pulses;
+			for (const std::string &sig : dstr)
+			{
+				std::vector<int16_t> sigdata;
+				ASSERT_TRUE(pulsetrace::parseSigdata(sig.c_str() + 3, &sigdata));
+				for (uint8_t r = 0; r < 3; r++)
+					pulses.insert(pulses.end(), sigdata.begin(), sigdata.end());
+			}
+			uint32_t rnd = 0x5D1C0DE;
+			for (uint16_t i = 0; i < 2000; i++)
+			{
+				rnd = rnd * 1103515245 + 12345;
+				pulses.push_back(((i & 1) ? -1 : 1) * int(100 + (rnd >> 16) % 4000));
+			}
+
+			for (size_t i = 0; i < pulses.size(); i++)
+			{
+				ooDecode.decode(&pulses[i]);
+				ASSERT_TRUE(ooDecode.checkHisto()) << "pulse " << i;
+			}
+			ASSERT_NE(outputStr.find("MS;"), std::string::npos);
+		}
+
+		TEST_F(Tests, noiseGate)
+		{
+			// Noise closes the gate and is dropped without processMessage, a signal after it opens the gate again
+			std::vector<int> pulses;
+			uint32_t rnd = 0x5D1C0DE;
+			for (uint16_t i = 0; i < 2000; i++)
+			{
+				rnd = rnd * 1103515245 + 12345;
+				pulses.push_back(((i & 1) ? -1 : 1) * int(100 + (rnd >> 16) % 4000));
+			}
+			ooDecode.decode(pulses.data(), pulses.size());
+			const DecoderCounters &dc = ooDecode.counters;
+			ASSERT_TRUE(ooDecode.noiseGate);
+			ASSERT_GT(dc.noiseResets, 100);
+			ASSERT_GT(dc.noisePulses, 1000);
+			ASSERT_LT(dc.processCalls, 10);
+			ASSERT_TRUE(outputStr.empty()) << outputStr;
+
+			std::vector<int16_t> sigdata;
+			ASSERT_TRUE(pulsetrace::parseSigdata("P0=-3886;P1=481;P2=-1938;P3=-9200;D=13121012101010101010121012101212121212121210101212121012121212101010101212;", &sigdata));
+			pulses.clear();
+			for (uint8_t r = 0; r < 4; r++)
+				pulses.insert(pulses.end(), sigdata.begin(), sigdata.end());
+			pulses.push_back(-32001);
+			ooDecode.decode(pulses.data(), pulses.size());
+			ASSERT_FALSE(ooDecode.noiseGate);
+			ASSERT_NE(outputStr.find("MS;"), std::string::npos) << outputStr;
+		}
+
+		TEST_F(Tests, ringBitStore)
+		{
+			// Same content as BitStore after any sequence of add, move and change, also across the buffer end
+			BitStore<20, 4> linear;
+			RingBitStore<20, 4> ring;
+			uint32_t rnd = 0x5D1C0DE;
+			for (uint16_t step = 0; step < 5000; step++)
+			{
+				rnd = rnd * 1103515245 + 12345;
+				const uint8_t value = (rnd >> 16) & 0x7;
+				const uint8_t op = (rnd >> 24) % 16;
+				if (op < 12) {
+					ASSERT_EQ(linear.addValue(value), ring.addValue(value));
+				}
+				else if (op < 14 && linear.valcount > 0) {
+					const uint16_t pos = (rnd >> 8) % linear.valcount;
+					ASSERT_EQ(linear.moveLeft(pos), ring.moveLeft(pos));
+				}
+				else if (linear.valcount > 0) {
+					const uint16_t pos = (rnd >> 8) % linear.valcount;
+					linear.changeValue(pos, value);
+					ring.changeValue(pos, value);
+				}
+
+				ASSERT_EQ(linear.valcount, ring.valcount);
+				ASSERT_EQ(linear.bytecount, ring.bytecount);
+				for (int16_t i = 0; i < linear.valcount; i++)
+					ASSERT_EQ(linear[i], ring[i]) << "step " << step << " pos " << i;
+				for (uint8_t i = 0; linear.valcount > 0 && i <= linear.bytecount; i++)
+				{
+					uint8_t a, b;
+					ASSERT_TRUE(linear.getByte(i, &a));
+					ASSERT_TRUE(ring.getByte(i, &b));
+					ASSERT_EQ(a, b) << "step " << step << " byte " << int(i);
+				}
+			}
+			ASSERT_EQ(ring.getValue(40), -1);
+		}
+
+		TEST_F(Tests, bitStoreAccessors)
+		{
+			const uint8_t values[] = { 1,0,1,1,0,0,0,1,1,1,0,1,0,1,1,0,1,0,0,0,1 };
+			const uint8_t n = sizeof(values);
+			BitStore<3, 1> bits;
+			ASSERT_EQ(bits.addValues(values, n), n);
+			ASSERT_EQ(bits.valcount, n);
+			ASSERT_EQ(bits.bytecount, 2);
+			ASSERT_EQ(bits.datastore[0], 0xB1);
+			ASSERT_EQ(bits.addValues(values, n), 24 - n);	// Full after 24 bits
+
+			uint8_t out[32] = {};
+			ASSERT_EQ(bits.getValues(3, out, 32), 21);		// Clipped to valcount
+			for (uint8_t i = 0; i < n - 3; i++)
+				ASSERT_EQ(out[i], values[i + 3]);
+
+			RingBitStore<6, 4> nibbles;
+			const uint8_t pattern[] = { 1,2,3,4,5,6,7,0,1,2 };
+			ASSERT_EQ(nibbles.addValues(pattern, 10), 10);
+			ASSERT_TRUE(nibbles.moveLeft(5));
+			ASSERT_EQ(nibbles.addValues(pattern, 10), 7);		// Wraps around the buffer end
+			uint8_t i = 0;
+			for (RingBitStore<6, 4>::const_iterator it = nibbles.begin(); it != nibbles.end(); ++it, ++i)
+				ASSERT_EQ(*it, i < 5 ? pattern[i + 5] : pattern[i - 5]);
+			ASSERT_EQ(i, 12);
+			ASSERT_EQ(nibbles.getValues(4, out, 10), 8);
+			ASSERT_EQ(out[0], 2);
+			ASSERT_EQ(out[3], 3);
+		}
+
+		TEST_F(Tests, messageFrame)
+		{
+			// Every message is passed with one call of the stream callback
+			ooDecode.setStreamCallback(&countingWriteCallback);
+			std::string dstr = "MS;P0=-3886;P1=481;P2=-1938;P3=-9200;D=13121012101010101010121012101212121212121210101212121012121212101010101212;";
+			std::vector<int16_t> sigdata;
+			ASSERT_TRUE(pulsetrace::parseSigdata(dstr.c_str() + 3, &sigdata));
+			std::vector<int> pulses;
+			for (uint8_t r = 0; r < 4; r++)
+				pulses.insert(pulses.end(), sigdata.begin(), sigdata.end());
+			pulses.push_back(-32001);
+
+			frameWrites = 0;
+			ASSERT_GT(ooDecode.decode(pulses.data(), pulses.size()), 0);
+			ASSERT_EQ(2, std::count(outputStr.begin(), outputStr.end(), '\n'));
+			ASSERT_EQ(2, frameWrites);
+
+			// Number formatting and messages longer than the frame
+			MessageFrame frame;
+			frame.setOutput(&countingWriteCallback);
+			outputStr.clear();
+			frameWrites = 0;
+			frame.addInt(-32001); frame.add(';'); frame.addInt(0); frame.add(';'); frame.addHex(0xA7); frame.add(';'); frame.addHex(5, 2);
+			frame.end("CH=1;");
+			ASSERT_EQ(1, frameWrites);
+			ASSERT_STREQ("-32001;0;A7;05CH=1;\x03\n", outputStr.c_str());
+
+			outputStr.clear();
+			frameWrites = 0;
+			for (uint16_t i = 0; i < maxFrameSize + 10; i++)
+				frame.add('x');
+			frame.end();
+			ASSERT_EQ(2, frameWrites);
+			ASSERT_EQ(maxFrameSize + 12, outputStr.size());
+		}
+
+		TEST_F(Tests, binaryOutput)
+		{
+			// Binary messages carry the same content as the text messages
+			std::string msStr = "MS;P0=-3886;P1=481;P2=-1938;P3=-9200;D=13121012101010101010121012101212121212121210101212121012121212101010101212;";
+			std::string mcStr = "MU;P0=-7452;P1=956;P2=-994;P3=-517;P4=463;D=01212121212121212121212121212121342431342431213421212431342431213424313421212121212124313421243134212121212431342121212121243121342431342431342431342121212121212121212431212134212121212431342431213424312134212431213424312134212431;CP=1;";
+			std::vector<int16_t> sigdata;
+			std::vector<int> pulses;
+			ASSERT_TRUE(pulsetrace::parseSigdata(msStr.c_str() + 3, &sigdata));
+			pulses.insert(pulses.end(), sigdata.begin(), sigdata.end());
+			pulses.insert(pulses.end(), sigdata.begin(), sigdata.end());
+			pulses.push_back(-32001);
+			ASSERT_TRUE(pulsetrace::parseSigdata(mcStr.c_str() + 3, &sigdata));
+			pulses.insert(pulses.end(), sigdata.begin(), sigdata.end());
+			pulses.push_back(-32001);
+
+			ooDecode.decode(pulses.data(), pulses.size());
+			const std::string text = outputStr;
+			const size_t msPos = text.find("MS;");
+			const size_t mcPos = text.find("MC;");
+			ASSERT_NE(msPos, std::string::npos);
+			ASSERT_NE(mcPos, std::string::npos);
+
+			outputStr.clear();
+			ooDecode.reset();
+			ooDecode.MbinEnabled = true;
+			ooDecode.decode(pulses.data(), pulses.size());
+			const std::string bin = outputStr;
+			ASSERT_LT(bin.size(), text.size() / 2);
+
+			size_t pos = 0;
+			uint8_t types = 0;
+			while (pos < bin.size())
+			{
+				const uint8_t *frame = (const uint8_t*)bin.data() + pos;
+				ASSERT_EQ(MSG_BIN, frame[0]);
+				const uint8_t len = frame[1];
+				ASSERT_LE(pos + len + 4, bin.size());
+				uint16_t crc = 0xFFFF;
+				for (uint8_t i = 1; i < len + 2; i++)
+					crc = crc16(crc, frame[i]);
+				ASSERT_EQ(crc, (frame[len + 2] << 8) | frame[len + 3]);
+				const uint8_t *p = frame + 4;
+				char field[300];
+				std::string expected;
+				if (frame[2] == 'S' || frame[2] == 'U')
+				{
+					expected = frame[2] == 'S' ? "MS;" : "MU;";
+					const uint8_t mask = *p++;
+					for (uint8_t idx = 0; idx < 8; idx++)
+					{
+						if (!(mask & (1 << idx))) continue;
+						sprintf(field, "P%i=%i;", idx, int16_t(p[0] | (p[1] << 8)));
+						expected += field;
+						p += 2;
+					}
+					const uint8_t clock = *p++;
+					const uint8_t sync = frame[2] == 'S' ? *p++ : 0;
+					const uint8_t cnt = *p++;
+					expected += "D=";
+					for (uint8_t i = 0; i < cnt; i++)
+						expected += char('0' + ((i & 1) ? p[i / 2] & 15 : p[i / 2] >> 4));
+					p += (cnt + 1) / 2;
+					sprintf(field, frame[2] == 'S' ? ";CP=%i;SP=%i;" : ";CP=%i;", clock, sync);
+					expected += field;
+				}
+				else
+				{
+					ASSERT_EQ('C', frame[2]);
+					int16_t v[5];
+					for (uint8_t i = 0; i < 5; i++, p += 2)
+						v[i] = p[0] | (p[1] << 8);
+					const uint16_t bits = p[0] | (p[1] << 8);
+					p += 2;
+					sprintf(field, "MC;LL=%i;LH=%i;SL=%i;SH=%i;D=", v[0], v[1], v[2], v[3]);
+					expected = field;
+					for (uint16_t i = 0; i < (bits + 3) / 4; i++)
+					{
+						sprintf(field, "%X", (i & 1) ? p[i / 2] & 15 : p[i / 2] >> 4);
+						expected += field;
+					}
+					p += (bits + 7) / 8;
+					sprintf(field, ";C=%i;L=%i;", v[4], bits);
+					expected += field;
+				}
+				if (frame[3] & MSG_BIN_OVERFLOW) expected += "O;";
+				if (frame[3] & MSG_BIN_MOVED) {
+					sprintf(field, "m%i;", frame[3] >> 4);
+					expected += field;
+				}
+				ASSERT_EQ(frame + len + 2, p);
+				ASSERT_NE(text.find(MSG_START + expected + MSG_END), std::string::npos) << expected;
+				types |= frame[2] == 'S' ? 1 : (frame[2] == 'C' ? 2 : 4);
+				pos += len + 4;
+			}
+			ASSERT_EQ(3, types & 3);
+		}
+
+		TEST_F(Tests, txQueueOrder)
+		{
+			// Messages come out unchanged and in order, the port takes only a few bytes per call
+			FakePort port;
+			TxQueue<64, FakePort> queue(port, txBlock);
+			const std::string ms = "\x02MS;P0=-3886;P1=481;D=0101;\x03\n";
+			const std::string mu1 = "\x02MU;P0=-500;P1=";
+			const std::string mu2 = "500;D=0101;\x03\n";
+			queue.push((const uint8_t*)ms.data(), ms.size());
+			queue.push((const uint8_t*)mu1.data(), mu1.size());
+			queue.push((const uint8_t*)mu2.data(), mu2.size());
+			ASSERT_EQ(ms.size() + mu1.size() + mu2.size() + 6, queue.count());
+			ASSERT_FALSE(queue.drain());		// port is busy
+			ASSERT_TRUE(port.out.empty());
+
+			port.room = 5;
+			queue.drain();
+			ASSERT_TRUE(queue.isEmpty());
+			ASSERT_EQ(ms + mu1 + mu2, port.out);
+			ASSERT_EQ(ms.size() + mu1.size() + mu2.size(), queue.queuedBytes);
+			ASSERT_EQ(0, queue.droppedBytes);
+			ASSERT_EQ(0, queue.stalls);
+
+			// Entries wrap around the end of the buffer
+			port.out.clear();
+			for (uint8_t i = 0; i < 10; i++)
+			{
+				queue.push((const uint8_t*)ms.data(), ms.size());
+				port.room = 7;
+				queue.drain();
+			}
+			std::string expected;
+			for (uint8_t i = 0; i < 10; i++) expected += ms;
+			ASSERT_EQ(expected, port.out);
+		}
+
+		TEST_F(Tests, txQueueDropMU)
+		{
+			FakePort port;
+			TxQueue<64, FakePort> queue(port);
+			const std::string ms = "\x02MS;P0=-3886;D=01;\x03\n";		// 20 bytes
+			const std::string mu = "\x02Mu;P0=-500;D=0101;\x03\n";		// 21 bytes
+			const std::string mc = "\x02MC;LL=-1000;D=AB;\x03\n";		// 20 bytes
+			queue.push((const uint8_t*)mu.data(), mu.size());
+			queue.push((const uint8_t*)ms.data(), ms.size());
+			queue.push((const uint8_t*)mc.data(), mc.size());		// oldest MU is dropped
+			ASSERT_EQ(1, queue.droppedMsgs);
+			ASSERT_EQ(mu.size(), queue.droppedBytes);
+			queue.push((const uint8_t*)mu.data(), mu.size());		// no room, new MU is dropped
+			ASSERT_EQ(2, queue.droppedMsgs);
+			ASSERT_EQ(0, queue.stalls);
+
+			// MS / MC are never dropped, push waits for the port
+			port.room = 2;
+			queue.push((const uint8_t*)ms.data(), ms.size());
+			ASSERT_EQ(1, queue.stalls);
+			ASSERT_EQ(2, queue.droppedMsgs);
+			queue.drain();
+			ASSERT_EQ(ms + mc + ms, port.out);
+			ASSERT_EQ(2 * mu.size() + 2 * ms.size() + mc.size(), queue.queuedBytes);
+			ASSERT_EQ(2 * mu.size(), queue.droppedBytes);
+			ASSERT_EQ(2 + mu.size() + 2 + ms.size(), queue.maxCount);
+
+			// A message which is partially written is kept
+			port.out.clear();
+			port.room = 0;
+			queue.resetCounters();
+			queue.push((const uint8_t*)mu.data(), mu.size());
+			queue.push((const uint8_t*)mu.data(), mu.size());
+			port.room = 1;
+			port.budget = 1;
+			queue.drain();
+			port.budget = -1;
+			port.room = 0;
+			queue.push((const uint8_t*)ms.data(), ms.size());		// drops the second MU, not the one being written
+			ASSERT_EQ(1, queue.droppedMsgs);
+			port.room = 100;
+			queue.drain();
+			ASSERT_EQ(mu + ms, port.out);
+		}
+
+		TEST_F(Tests, txQueueDropContinued)
+		{
+			// A message passed in more than one part is dropped as a whole, binary messages as well
+			FakePort port;
+			TxQueue<64, FakePort> queue(port);
+			uint8_t bin[44] = { MSG_BIN, 4, 'U' };
+			const std::string ms = "\x02MS;P0=-3886;P1=481;P2=-1938;D=0101;\x03\n";
+			queue.push(bin, 3);
+			queue.push(bin + 3, 5);
+			queue.push((const uint8_t*)ms.data(), 20);
+			queue.push((const uint8_t*)ms.data() + 20, ms.size() - 20);
+			ASSERT_EQ(0, queue.droppedMsgs);
+			bin[1] = 40;
+			queue.push(bin, 20);		// older binary MU is dropped
+			ASSERT_EQ(1, queue.droppedMsgs);
+			queue.push(bin + 20, 24);	// no room: the message itself is dropped with its first part
+			ASSERT_EQ(2, queue.droppedMsgs);
+			ASSERT_EQ(8 + sizeof(bin), queue.droppedBytes);
+
+			port.room = 100;
+			queue.push((const uint8_t*)ms.data(), ms.size());
+			queue.drain();
+			ASSERT_EQ(ms + ms, port.out);
+		}
+
+		TEST_F(Tests, txQueueDecoder)
+		{
+			// Decoder output through the queue equals the direct output
+			std::string dstr = "MS;P0=-3886;P1=481;P2=-1938;P3=-9200;D=13121012101010101010121012101212121212121210101212121012121212101010101212;";
+			std::vector<int16_t> sigdata;
+			ASSERT_TRUE(pulsetrace::parseSigdata(dstr.c_str() + 3, &sigdata));
+			std::vector<int> pulses;
+			for (uint8_t r = 0; r < 20; r++)
+				pulses.insert(pulses.end(), sigdata.begin(), sigdata.end());
+			pulses.push_back(-32001);
+
+			ooDecode.decode(pulses.data(), pulses.size());
+			ASSERT_FALSE(outputStr.empty());
+
+			FakePort port;
+			port.room = 3;
+			TxQueue<128, FakePort> queue(port, txBlock);
+			ooDecode.reset();
+			ooDecode.setStreamCallback(fastdelegate::MakeDelegate(&queue, &TxQueue<128, FakePort>::push));
+			for (size_t i = 0; i < pulses.size(); i += 16)
+			{
+				ooDecode.decode(pulses.data() + i, std::min<size_t>(16, pulses.size() - i));
+				queue.drain();
+			}
+			port.room = 1000;
+			queue.drain();
+			ASSERT_EQ(outputStr, port.out);
+			ASSERT_EQ(0, queue.droppedBytes);
+		}
+
+		TEST_F(Tests, outputHubSlowClient)
+		{
+			// A client which takes nothing loses old messages, the other one gets every message
+			typedef OutputHub<1024, 2, FakePort> Hub;
+			Hub hub;
+			FakePort fast, slow;
+			fast.room = 7;
+			hub.attach(0, &fast);
+			hub.attach(1, &slow);
+			ASSERT_EQ(1 << fmtVerbose, hub.formats());
+
+			std::string all;
+			std::vector<std::string> msgs;
+			for (uint16_t i = 0; i < 100; i++)
+			{
+				std::string m = "\x02MS;P0=-" + std::to_string(3000 + i) + ";P1=481;D=0101010101;CP=1;SP=0;\x03\n";
+				hub.push((const uint8_t*)m.data(), m.size(), 1 << fmtVerbose);
+				hub.drain();
+				all += m;
+				msgs.push_back(m);
+			}
+			fast.room = 1000;
+			hub.drain();
+			ASSERT_EQ(all, fast.out);
+			ASSERT_EQ(0, hub.dropped(0));
+			ASSERT_GT(hub.dropped(1), 0);
+			ASSERT_EQ(0, hub.droppedMsgs);
+			ASSERT_LE(hub.maxCount, 1024);
+
+			slow.room = 5;
+			for (uint8_t i = 0; i < 100; i++) hub.drain();
+			ASSERT_EQ(0, hub.count());		// every part is released
+			std::string expected;
+			for (size_t i = hub.dropped(1); i < msgs.size(); i++)
+				expected += msgs[i];
+			ASSERT_EQ(expected, slow.out);	// newest messages, none cut
+
+			// A message which is partially written is not dropped
+			slow.out.clear();
+			slow.room = 3;
+			slow.budget = 3;
+			const std::string first = msgs[0];
+			hub.push((const uint8_t*)first.data(), first.size(), 1 << fmtVerbose);
+			hub.drain();
+			slow.budget = 0;
+			for (size_t i = 1; i < msgs.size(); i++)
+				hub.push((const uint8_t*)msgs[i].data(), msgs[i].size(), 1 << fmtVerbose);
+			slow.budget = -1;
+			slow.room = 1000;
+			hub.drain();
+			ASSERT_EQ(first, slow.out.substr(0, first.size()));
+
+			hub.detach(1);
+			hub.drain();
+			ASSERT_EQ(0, hub.count());
+		}
+
+		TEST_F(Tests, outputHubFormats)
+		{
+			// Every client gets the messages in its own format, equal to the output of a decoder with this format
+			std::string msStr = "MS;P0=-3886;P1=481;P2=-1938;P3=-9200;D=13121012101010101010121012101212121212121210101212121012121212101010101212;";
+			std::string muStr = "MU;P0=-7452;P1=956;P2=-994;P3=-517;P4=463;D=01212121212121212121212121212121342431342431213421212431342431213424313421212121212124313421243134212121212431342121212121243121342431342431342431342121212121212121212431212134212121212431342431213424312134212431213424312134212431;CP=1;";
+			std::vector<int16_t> sigdata;
+			std::vector<int> pulses;
+			ASSERT_TRUE(pulsetrace::parseSigdata(msStr.c_str() + 3, &sigdata));
+			pulses.insert(pulses.end(), sigdata.begin(), sigdata.end());
+			pulses.insert(pulses.end(), sigdata.begin(), sigdata.end());
+			pulses.push_back(-32001);
+			ASSERT_TRUE(pulsetrace::parseSigdata(muStr.c_str() + 3, &sigdata));
+			pulses.insert(pulses.end(), sigdata.begin(), sigdata.end());
+			pulses.push_back(-32001);
+
+			std::string expected[3];
+			for (uint8_t f = fmtVerbose; f <= fmtBinary; f++)
+			{
+				outputStr.clear();
+				ooDecode.reset();
+				ooDecode.MredEnabled = f == fmtReduced;
+				ooDecode.MbinEnabled = f == fmtBinary;
+				ooDecode.decode(pulses.data(), pulses.size());
+				expected[f] = outputStr;
+			}
+			ASSERT_NE(expected[fmtVerbose], expected[fmtReduced]);
+
+			typedef OutputHub<1024, 3, FakePort> Hub;
+			Hub hub;
+			FakePort port[3];
+			for (uint8_t i = 0; i < 3; i++) {
+				port[i].room = 11;
+				hub.attach(i, &port[i]);
+			}
+			hub.defaultFormat = ooDecode.defaultFormat();
+			hub.setFormat(0, fmtVerbose);
+			hub.setFormat(1, fmtReduced);		// client 2 follows the decoder config (binary)
+			hub.drain();
+			ASSERT_EQ(7, hub.formats());
+
+			outputStr.clear();
+			ooDecode.reset();
+			ooDecode.outputFormats = hub.formats();
+			ooDecode.setFormatStreamCallback(fastdelegate::MakeDelegate(&hub, &Hub::push));
+			for (size_t i = 0; i < pulses.size(); i += 32)
+			{
+				ooDecode.decode(pulses.data() + i, std::min<size_t>(32, pulses.size() - i));
+				hub.drain();
+			}
+			for (uint8_t i = 0; i < 100; i++) hub.drain();
+			ASSERT_TRUE(outputStr.empty());		// stream callback is not used
+			for (uint8_t f = fmtVerbose; f <= fmtBinary; f++)
+				ASSERT_EQ(expected[f], port[f].out);
+			ASSERT_EQ(0, hub.count());
+
+			// A new format is used from the next message on
+			port[0].out.clear();
+			hub.setFormat(0, fmtBinary);
+			hub.drain();
+			ASSERT_EQ(6, hub.formats());
+			ooDecode.reset();
+			ooDecode.outputFormats = hub.formats();
+			ooDecode.decode(pulses.data(), pulses.size());
+			hub.finishMessage(0);
+			for (uint8_t i = 0; i < 100; i++) hub.drain();
+			ASSERT_EQ(expected[fmtBinary], port[0].out);
+			ASSERT_EQ(expected[fmtReduced] + expected[fmtReduced], port[1].out);
+			ASSERT_EQ(0, hub.count());
+		}
+
+		TEST_F(Tests, repeatFolding)
+		{
+			// Repeats are folded into the first message, which carries the repeat count
+			std::string dstr = "MS;P0=-3886;P1=481;P2=-1938;P3=-9200;D=13121012101010101010121012101212121212121210101212121012121212101010101212;";
+			std::vector<int16_t> sigdata;
+			ASSERT_TRUE(pulsetrace::parseSigdata(dstr.c_str() + 3, &sigdata));
+			std::vector<int> pulses;
+			for (uint8_t r = 0; r < 4; r++)
+				pulses.insert(pulses.end(), sigdata.begin(), sigdata.end());
+			pulses.push_back(-32001);
+
+			ooDecode.decode(pulses.data(), pulses.size());
+			ASSERT_EQ(2, std::count(outputStr.begin(), outputStr.end(), '\n'));
+			std::string expected = outputStr.substr(0, outputStr.find('\n') + 1);
+			expected.insert(expected.size() - 2, "r=2;");
+
+			outputStr.clear();
+			ooDecode.reset();
+			ooDecode.MdedupEnabled = true;
+			ooDecode.decode(pulses.data(), pulses.size());
+			ASSERT_TRUE(outputStr.empty());
+			ooDecode.passRepeats();
+			ASSERT_TRUE(outputStr.empty());		// Within the window
+			ooDecode.passRepeats(true);
+			ASSERT_STREQ(expected.c_str(), outputStr.c_str());
+			ooDecode.passRepeats(true);
+			ASSERT_STREQ(expected.c_str(), outputStr.c_str());
+
+			// Passed after the window, a message without repeats is unchanged
+			outputStr.clear();
+			ooDecode.reset();
+			std::vector<int> once(sigdata.begin(), sigdata.end());
+			once.insert(once.end(), sigdata.begin(), sigdata.end());
+			once.push_back(-32001);
+			ooDecode.decode(once.data(), once.size());
+			ASSERT_TRUE(outputStr.empty());
+			delay(repeatWindow + 20);
+			ooDecode.passRepeats();
+			ASSERT_EQ(1, std::count(outputStr.begin(), outputStr.end(), '\n'));
+			ASSERT_EQ(std::string::npos, outputStr.find("r="));
+
+			// Other messages are held side by side
+			outputStr.clear();
+			ooDecode.reset();
+			std::string mcStr = "MU;P0=-7452;P1=956;P2=-994;P3=-517;P4=463;D=01212121212121212121212121212121342431342431213421212431342431213424313421212121212124313421243134212121212431342121212121243121342431342431342431342121212121212121212431212134212121212431342431213424312134212431213424312134212431;CP=1;";
+			std::vector<int16_t> mcdata;
+			ASSERT_TRUE(pulsetrace::parseSigdata(mcStr.c_str() + 3, &mcdata));
+			std::vector<int> mixed(pulses);
+			for (uint8_t r = 0; r < 3; r++) {
+				mixed.insert(mixed.end(), mcdata.begin(), mcdata.end());
+				mixed.push_back(-32001);
+			}
+			ooDecode.decode(mixed.data(), mixed.size());
+			ASSERT_TRUE(outputStr.empty());
+			ooDecode.passRepeats(true);
+			ASSERT_EQ(2, std::count(outputStr.begin(), outputStr.end(), '\n'));
+			ASSERT_EQ(0, outputStr.find(expected));
+			ASSERT_NE(std::string::npos, outputStr.find("MC;"));
+			ASSERT_NE(std::string::npos, outputStr.find(";r=3;\x03"));
+
+			// Binary messages get a flag and a count byte
+			outputStr.clear();
+			ooDecode.reset();
+			ooDecode.MbinEnabled = true;
+			ooDecode.decode(pulses.data(), pulses.size());
+			ooDecode.passRepeats(true);
+			const uint8_t *frame = (const uint8_t*)outputStr.data();
+			ASSERT_EQ(MSG_BIN, frame[0]);
+			const uint8_t len = frame[1];
+			ASSERT_EQ(len + 4, outputStr.size());
+			uint16_t crc = 0xFFFF;
+			for (uint8_t i = 1; i < len + 2; i++)
+				crc = crc16(crc, frame[i]);
+			ASSERT_EQ(crc, (frame[len + 2] << 8) | frame[len + 3]);
+			ASSERT_TRUE(frame[3] & MSG_BIN_REPEAT);
+			ASSERT_EQ(2, frame[len + 1]);
+		}
+
+		TEST_F(Tests, receiverChannelEdge)
+		{
+			ReceiverChannel<16, 4> channel;
+			channel.begin(0, &writeCallback);
+			int out[16];
+
+			channel.edge(40000, true);			// first edge, duration since start is clamped to maxPulse
+			channel.edge(40500, false);			// 500 high
+			channel.edge(40550, true);			// 50 is below pulseMin, a spike
+			channel.edge(41550, false);			// 1000 high, merged with 500 and the spike
+			channel.edge(41950, true);			// 400 low
+			ASSERT_EQ(2, channel.fifo.count());	// 400 is held until the next pulse
+			ASSERT_EQ(100, channel.timeout(41950 + 100, false));	// time since last edge
+			ASSERT_EQ(0, channel.timeout(41950 + maxPulse, false));	// adds maxPulse
+			ASSERT_EQ(4, channel.fifo.dequeue(out, 16));
+			ASSERT_EQ(-maxPulse, out[0]);
+			ASSERT_EQ(1550, out[1]);
+			ASSERT_EQ(-400, out[2]);
+			ASSERT_EQ(maxPulse, out[3]);
+			ASSERT_EQ(1, channel.glitches);
+
+			const unsigned long t = 41950 + maxPulse;
+			channel.edge(t + 6000, false);		// 6000 high, two spikes within
+			channel.edge(t + 6040, true);
+			channel.edge(t + 6500, false);
+			channel.edge(t + 6520, true);
+			channel.edge(t + 7000, false);
+			ASSERT_EQ(0, channel.timeout(t + 7000 + maxPulse, true));
+			ASSERT_EQ(2, channel.fifo.dequeue(out, 16));
+			ASSERT_EQ(7000, out[0]);
+			ASSERT_EQ(-maxPulse, out[1]);
+			ASSERT_EQ(3, channel.glitches);
+
+			channel.glitchMin = 10;				// Spikes longer than glitchMin are pulses
+			const unsigned long t2 = t + 7000 + maxPulse;
+			channel.edge(t2 + 100, true);
+			channel.edge(t2 + 150, false);
+			ASSERT_EQ(0, channel.timeout(t2 + 150 + maxPulse, true));
+			ASSERT_EQ(3, channel.fifo.dequeue(out, 16));
+			ASSERT_EQ(-100, out[0]);
+			ASSERT_EQ(50, out[1]);
+			ASSERT_EQ(-maxPulse, out[2]);
+			ASSERT_EQ(3, channel.glitches);
+		}
+
+		TEST_F(Tests, receiverChannelGlitches)
+		{
+			// Spikes within a signal are merged into the pulses around them, the signal decodes like the clean one
+			std::string dstr = "MS;P0=-3886;P1=481;P2=-1938;P3=-9200;D=13121012101010101010121012101212121212121210101212121012121212101010101212;";
+			std::vector<int16_t> sigdata;
+			ASSERT_TRUE(pulsetrace::parseSigdata(dstr.c_str() + 3, &sigdata));
+			typedef ReceiverChannel<64, 16> Channel;
+			Channel channel[2];
+			for (uint8_t c = 0; c < 2; c++)
+			{
+				channel[c].begin(c, &writeCallback);
+				channel[c].decoder.MSenabled = channel[c].decoder.MUenabled = channel[c].decoder.MCenabled = true;
+				channel[c].decoder.MredEnabled = false;
+			}
+
+			std::string output[2];
+			for (uint8_t c = 0; c < 2; c++)
+			{
+				unsigned long now = 100000;
+				uint16_t spikes = 0;
+				outputStr.clear();
+				for (uint8_t r = 0; r < 4; r++)
+				{
+					for (size_t i = 0; i < sigdata.size(); i++)
+					{
+						const int p = sigdata[i];
+						const unsigned long d = p < 0 ? -p : p;
+						if (c == 1 && d > 1000) {		// Spike of the other level within every long pulse
+							channel[c].edge(now + d / 2, p < 0);
+							channel[c].edge(now + d / 2 + 30, p > 0);
+							spikes++;
+						}
+						now += d;
+						channel[c].edge(now, p < 0);
+						channel[c].processBatch();
+					}
+				}
+				channel[c].timeout(now + maxPulse, sigdata.back() > 0);
+				while (channel[c].processBatch() >= 0);
+				output[c] = outputStr;
+				ASSERT_EQ(spikes, channel[c].glitches);
+			}
+			ASSERT_NE(std::string::npos, output[0].find("MS;")) << output[0];
+			ASSERT_STREQ(output[0].c_str(), output[1].c_str());
+			ASSERT_EQ(channel[0].pulseCount, channel[1].pulseCount);
+			ASSERT_EQ(channel[0].decoder.counters.invalidResets, channel[1].decoder.counters.invalidResets);
+		}
+
+		TEST_F(Tests, receiverChannelCounters)
+		{
+			ReceiverChannel<16, 16> channel;
+			channel.begin(0, &writeCallback);
+			channel.decoder.MSenabled = channel.decoder.MUenabled = channel.decoder.MCenabled = true;
+			channel.decoder.MsMoveCount = 3;
+			std::string dstr = "MS;P0=-3886;P1=481;P2=-1938;P3=-9200;D=13121012101010101010121012101212121212121210101212121012121212101010101212;";
+			std::vector<int16_t> sigdata;
+			ASSERT_TRUE(pulsetrace::parseSigdata(dstr.c_str() + 3, &sigdata));
+			std::vector<int> pulses;
+			for (uint8_t r = 0; r < 4; r++)
+				pulses.insert(pulses.end(), sigdata.begin(), sigdata.end());
+			pulses.push_back(-maxPulse);
+			const int invalid[] = { 500, -400, 500, -400, 600 };		// Same sign, the buffer is discarded
+			pulses.insert(pulses.end(), invalid, invalid + 5);
+
+			for (size_t i = 0; i < pulses.size(); i++) {
+				ASSERT_TRUE(channel.fifo.enqueue(pulses[i]));
+				channel.processBatch();
+			}
+			const DecoderCounters &dc = channel.decoder.counters;
+			ASSERT_EQ(pulses.size(), channel.received());
+			ASSERT_EQ(2, dc.msMsgs);
+			ASSERT_EQ(0, dc.muMsgs);
+			ASSERT_EQ(0, dc.mcMsgs);
+			ASSERT_GE(dc.processCalls, 2);
+			ASSERT_GE(dc.moves, 1);
+			ASSERT_EQ(1, dc.invalidResets);
+			ASSERT_EQ(1, channel.fifo.highWatermark());
+
+			for (uint8_t i = 0; i < 20; i++)
+				channel.fifo.enqueue(500);
+			ASSERT_EQ(4, channel.fifo.overflows());
+			ASSERT_EQ(16, channel.fifo.highWatermark());
+			ASSERT_EQ(pulses.size() + 16, channel.received());
+
+			channel.resetCounters();
+			ASSERT_EQ(16, channel.received());
+			ASSERT_EQ(0, channel.fifo.overflows());
+			ASSERT_EQ(0, dc.msMsgs);
+			ASSERT_EQ(0, dc.processCalls);
+			channel.decoder.decode(pulses.data(), pulses.size());
+			channel.decoder.reset();		// Keeps the counters
+			ASSERT_EQ(2, dc.msMsgs);
+		}
+
+		TEST_F(Tests, pulseSourceReplay)
+		{
+			typedef ReceiverChannel<16, 4> Channel;
+			Channel channel;
+			channel.begin(0, &writeCallback);
+			ReplaySource<Channel> source(channel, 2);
+			channel.setSource(&source);
+			const int16_t pulses[] = { 500, -400, 50, -1000, 32767 };	// 50 is below pulseMin and merged, 32767 is clamped
+			source.load(pulses, 5);
+			int out[16];
+
+			source.poll();								// Not started
+			ASSERT_TRUE(channel.fifo.isEmpty());
+			ASSERT_TRUE(channel.enable());
+			source.poll();								// 2 pulses per poll, the second one is held
+			ASSERT_EQ(1, channel.fifo.count());
+			channel.idle();								// Pulses left, the level still changes
+			ASSERT_EQ(1, channel.fifo.count());
+			while (!source.done())
+				source.poll();
+			channel.idle();								// Adds maxPulse of the level after the last pulse
+			ASSERT_EQ(4, channel.fifo.dequeue(out, 16));
+			ASSERT_EQ(500, out[0]);
+			ASSERT_EQ(-1450, out[1]);
+			ASSERT_EQ(maxPulse, out[2]);
+			ASSERT_EQ(-maxPulse, out[3]);
+			ASSERT_EQ(500 + 400 + 50 + 1000 + 32767 + maxPulse, source.now());
+
+			channel.disable();
+			source.load(pulses, 5);
+			ASSERT_EQ(-1, channel.processBatch());		// Stopped, nothing is passed
+			ASSERT_TRUE(channel.fifo.isEmpty());
+		}
+
+		TEST_F(Tests, pulseSourceTrace)
+		{
+			// A trace replayed by the host pulse source must decode like the same pulses put into the FIFO directly
+			std::string dstr = "MS;P0=-3886;P1=481;P2=-1938;P3=-9200;D=13121012101010101010121012101212121212121210101212121012121212101010101212;";
+			std::vector<int16_t> sigdata;
+			ASSERT_TRUE(pulsetrace::parseSigdata(dstr.c_str() + 3, &sigdata));
+			std::vector<int16_t> burst;
+			for (uint8_t r = 0; r < 4; r++)
+				burst.insert(burst.end(), sigdata.begin(), sigdata.end());
+
+			const char *filename = "pulsesource_trace.sdt";
+			pulsetrace::Writer writer;
+			ASSERT_TRUE(writer.open(filename));
+			ASSERT_TRUE(writer.writeBlock(0, pulsetrace::rssiUnknown, 0, burst.data(), uint32_t(burst.size())));
+			ASSERT_TRUE(writer.writeBlock(2000000, pulsetrace::rssiUnknown, 0, burst.data(), uint32_t(burst.size())));
+			ASSERT_TRUE(writer.close());
+
+			typedef ReceiverChannel<64, 16> Channel;
+			Channel channel[2];
+			for (uint8_t c = 0; c < 2; c++)
+			{
+				channel[c].begin(c, &writeCallback);
+				channel[c].decoder.MSenabled = channel[c].decoder.MUenabled = channel[c].decoder.MCenabled = true;
+				channel[c].decoder.MredEnabled = channel[c].decoder.MbinEnabled = channel[c].decoder.MdedupEnabled = false;
+				channel[c].decoder.MsMoveCount = 3;
+			}
+
+			// Reference: the pulses of both bursts, each followed by the pause the timer adds
+			const int pause = burst.back() < 0 ? maxPulse : -maxPulse;
+			for (uint8_t b = 0; b < 2; b++)
+			{
+				for (size_t i = 0; i <= burst.size(); i++)
+				{
+					ASSERT_TRUE(channel[0].fifo.enqueue(i < burst.size() ? burst[i] : pause));
+					channel[0].processBatch();
+				}
+			}
+			const std::string expected = outputStr;
+			ASSERT_NE(expected.find("MS;"), std::string::npos);
+			outputStr.clear();
+
+			ReplaySource<Channel> source(channel[1]);
+			channel[1].setSource(&source);
+			ASSERT_TRUE(channel[1].enable());
+			pulsetrace::Reader reader;
+			ASSERT_TRUE(reader.open(filename));
+			pulsetrace::Block block;
+			while (reader.nextBlock(&block))
+			{
+				source.load(block.pulses, block.header.pulseCount);
+				while (channel[1].processBatch() >= 0 || !source.done());
+				channel[1].idle();							// Silence after the burst
+				while (channel[1].processBatch() >= 0);
+			}
+			reader.close();
+			remove(filename);
+
+			ASSERT_STREQ(expected.c_str(), outputStr.c_str());
+			ASSERT_EQ(channel[0].pulseCount, channel[1].pulseCount);
+			ASSERT_EQ(channel[0].messageCount, channel[1].messageCount);
+		}
+
+		TEST_F(Tests, receiverChannels)
+		{
+			// Two receivers with different signals, each pulse stream is produced by its own thread (the receive ISR)
+			std::string dstr = "MS;P0=-3886;P1=481;P2=-1938;P3=-9200;D=13121012101010101010121012101212121212121210101212121012121212101010101212;";
+			std::vector<int16_t> sigdata;
+			ASSERT_TRUE(pulsetrace::parseSigdata(dstr.c_str() + 3, &sigdata));
+			const int pData[] = { 142,-446,-1056,972,-10304,250,-340 };
+			const uint8_t s_Stream[] = { 5,4,5,2,3,6,5,2,3,6,5,2,5,2,5,2,3,6,5,2,3,6,5,2,5,2,5,2,3,6,5,2,3,6,5,2,3,6,5,2,3,6,5,2,5,2,5,2,3,6 };
+
+			std::vector<int> pulses[2];
+			for (uint16_t k = 0; k < 500; k++)
+			{
+				for (uint8_t r = 0; r < 4; r++)
+					pulses[0].insert(pulses[0].end(), sigdata.begin(), sigdata.end());
+				pulses[0].push_back(-maxPulse);
+				for (uint8_t r = 0; r < 6; r++)
+					for (uint8_t i = 0; i < sizeof(s_Stream); i++)
+						pulses[1].push_back(pData[s_Stream[i]]);
+				pulses[1].push_back(-maxPulse);
+			}
+
+			// Output of a single decoder without channel tag
+			std::string expected[2];
+			size_t expectedFound[2];
+			for (uint8_t c = 0; c < 2; c++)
+			{
+				outputStr.clear();
+				ooDecode.reset();
+				expectedFound[c] = ooDecode.decode(pulses[c].data(), pulses[c].size());
+				ASSERT_GT(expectedFound[c], 0);
+				expected[c] = outputStr;
+			}
+			outputStr.clear();
+
+			ReceiverChannel<256, 32> channel[2];
+			for (uint8_t c = 0; c < 2; c++)
+			{
+				channel[c].begin(c, &writeCallback, true);
+				channel[c].decoder.MSenabled = channel[c].decoder.MUenabled = channel[c].decoder.MCenabled = true;
+				channel[c].decoder.MredEnabled = false;
+				channel[c].reset();
+			}
+
+			const auto start = std::chrono::steady_clock::now();
+			std::thread producer0([&channel, &pulses]() {
+				for (size_t i = 0; i < pulses[0].size(); i++)
+					while (!channel[0].fifo.enqueue(pulses[0][i])) std::this_thread::yield();
+			});
+			std::thread producer1([&channel, &pulses]() {
+				for (size_t i = 0; i < pulses[1].size(); i++)
+					while (!channel[1].fifo.enqueue(pulses[1][i])) std::this_thread::yield();
+			});
+
+			while (channel[0].pulseCount < pulses[0].size() || channel[1].pulseCount < pulses[1].size())
+			{
+				bool busy = false;
+				for (uint8_t c = 0; c < 2; c++)
+					if (channel[c].processBatch() >= 0) busy = true;
+				if (!busy) std::this_thread::yield();
+			}
+			producer0.join();
+			producer1.join();
+			const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+			// Split the shared output by channel tag, without the tag every channel must give the output of a single decoder
+			std::string received[2];
+			size_t pos = 0;
+			while (pos < outputStr.size())
+			{
+				const size_t end = outputStr.find('\n', pos);
+				ASSERT_NE(end, std::string::npos);
+				std::string msg = outputStr.substr(pos, end + 1 - pos);
+				const size_t tag = msg.find("CH=");
+				ASSERT_NE(tag, std::string::npos);
+				ASSERT_EQ(tag + 5, msg.find(MSG_END));
+				const uint8_t c = msg[tag + 3] - '0';
+				ASSERT_LT(c, 2);
+				received[c] += msg.erase(tag, 5);
+				pos = end + 1;
+			}
+			for (uint8_t c = 0; c < 2; c++)
+			{
+				ASSERT_EQ(expectedFound[c], channel[c].messageCount);
+				ASSERT_EQ(pulses[c].size(), channel[c].pulseCount);
+				ASSERT_TRUE(channel[c].fifo.isEmpty());
+				ASSERT_STREQ(expected[c].c_str(), received[c].c_str());
+				printf("channel %u: %u pulses, %u messages, %.0f pulses/s\n", c, channel[c].pulseCount, channel[c].messageCount, channel[c].pulseCount / seconds);
+			}
+		}
+
+		TEST_F(Tests, pulseTraceRoundtrip)
+		{
+			std::string dstr = "MS;P0=-3886;P1=481;P2=-1938;P3=-9200;D=13121012101010101010121012101212121212121210101212121012121212101010101212;CP=1;SP=3;R=42;";
+			std::vector<int16_t> pulses;
+			int16_t rssi = pulsetrace::rssiUnknown;
+			ASSERT_TRUE(pulsetrace::parseSigdata(dstr.c_str() + 3, &pulses, &rssi));
+			ASSERT_EQ(pulses.size(), 74);
+			ASSERT_EQ(rssi, 42);
+
+			const char *filename = "pulsetrace_roundtrip.sdt";
+			pulsetrace::Writer writer;
+			ASSERT_TRUE(writer.open(filename));
+			ASSERT_TRUE(writer.writeBlock(1000, rssi, 3, pulses.data(), uint32_t(pulses.size())));
+			writer.beginBlock(500000);
+			writer.addPulse(-40000);
+			writer.addPulse(300);
+			ASSERT_TRUE(writer.close());
+
+			// The file is little endian on every host
+			FILE *f = fopen(filename, "rb");
+			ASSERT_NE(f, nullptr);
+			uint8_t raw[16 + 16 + 2];
+			ASSERT_EQ(fread(raw, 1, sizeof(raw), f), sizeof(raw));
+			fclose(f);
+			const uint8_t fileHeader[8] = { 'S', 'D', 'T', 'R', 1, 0, 16, 0 };
+			const uint8_t blockHeader[16] = { 0xE8, 0x03, 0, 0, 0, 0, 0, 0, 74, 0, 0, 0, 42, 0, 3, 0 };
+			ASSERT_EQ(memcmp(raw, fileHeader, sizeof(fileHeader)), 0);
+			ASSERT_EQ(memcmp(raw + 16, blockHeader, sizeof(blockHeader)), 0);
+			ASSERT_EQ(raw[32], 0xE1);	// P1=481
+			ASSERT_EQ(raw[33], 0x01);
+
+			pulsetrace::Reader reader;
+			ASSERT_TRUE(reader.open(filename));
+			pulsetrace::Block block;
+			ASSERT_TRUE(reader.nextBlock(&block));
+			ASSERT_EQ(block.header.timestamp, 1000);
+			ASSERT_EQ(block.header.rssi, 42);
+			ASSERT_EQ(block.header.sourceId, 3);
+			ASSERT_EQ(block.header.pulseCount, pulses.size());
+			for (uint32_t i = 0; i < block.header.pulseCount; i++)
+				ASSERT_EQ(block.pulses[i], pulses[i]);
+
+			// The sensor repeats its message, so the data is replayed a few times
+			for (uint8_t r = 0; r < 4; r++)
+			{
+				for (uint32_t i = 0; i < block.header.pulseCount; i++)
+				{
+					int pulse = block.pulses[i];
+					ooDecode.decode(&pulse);
+				}
+			}
+			int pause = -32001;
+			ooDecode.decode(&pause);
+			const std::string traceOutput = outputStr;
+			ASSERT_NE(traceOutput.find("MS;"), std::string::npos);
+
+			ASSERT_TRUE(reader.nextBlock(&block));
+			ASSERT_EQ(block.header.timestamp, 500000);
+			ASSERT_EQ(block.header.rssi, pulsetrace::rssiUnknown);
+			ASSERT_EQ(block.header.pulseCount, 2);
+			ASSERT_EQ(block.pulses[0], -INT16_MAX);
+			ASSERT_EQ(block.pulses[1], 300);
+			ASSERT_FALSE(reader.nextBlock(&block));
+			ASSERT_TRUE(reader.error().empty());
+			reader.close();
+			remove(filename);
+
+			// Replaying the trace must give the same result as importing the string
+			outputStr.clear();
+			ooDecode.reset();
+			for (uint8_t r = 0; r < 4; r++)
+				import_sigdata(&dstr, false);
+			std::string pstr = "MS;P0=-32001;D=0;";
+			import_sigdata(&pstr, false);
+			ASSERT_STREQ(traceOutput.c_str(), outputStr.c_str());
+		}
+
+		TEST_F(Tests, pulseTraceInvalidFile)
+		{
+			const char *filename = "pulsetrace_invalid.sdt";
+			FILE *f = fopen(filename, "wb");
+			ASSERT_NE(f, nullptr);
+			fputs("MS;P0=-3886;P1=481;D=0101;", f);
+			fclose(f);
+
+			pulsetrace::Reader reader;
+			ASSERT_FALSE(reader.open(filename));
+			ASSERT_FALSE(reader.isOpen());
+			ASSERT_FALSE(reader.error().empty());
+			remove(filename);
+
+			ASSERT_FALSE(reader.open("pulsetrace_missing.sdt"));
+		}
+
+
+		TEST_F(Tests, spscFifoOrderAndWrap)
+		{
+			SPSCFifo<int, 8> fifo;
+			ASSERT_TRUE(fifo.isEmpty());
+			for (int i = 0; i < 100; i++)	// Indices wrap around several times
+			{
+				ASSERT_TRUE(fifo.enqueue(i));
+				ASSERT_TRUE(fifo.enqueue(-i));
+				ASSERT_EQ(fifo.count(), 2);
+				ASSERT_EQ(fifo.peek(), i);
+				ASSERT_EQ(fifo.dequeue(), i);
+				ASSERT_EQ(fifo.dequeue(), -i);
+			}
+			ASSERT_TRUE(fifo.isEmpty());
+			ASSERT_EQ(fifo.overflows(), 0);
+			ASSERT_EQ(fifo.highWatermark(), 2);
+		}
+
+		TEST_F(Tests, spscFifoBatchDequeue)
+		{
+			SPSCFifo<int, 16> fifo;
+			int out[16];
+			for (int i = 0; i < 10; i++) fifo.enqueue(i);
+			ASSERT_EQ(fifo.dequeue(out, 4), 4);
+			for (int i = 0; i < 4; i++) ASSERT_EQ(out[i], i);
+
+			for (int i = 10; i < 20; i++) fifo.enqueue(i);		// Wraps around the end of the buffer
+			ASSERT_EQ(fifo.count(), 16);
+			ASSERT_EQ(fifo.dequeue(out, 16), 16);
+			for (int i = 0; i < 16; i++) ASSERT_EQ(out[i], i + 4);
+			ASSERT_EQ(fifo.dequeue(out, 16), 0);
+		}
+
+		TEST_F(Tests, spscFifoOverflow)
+		{
+			SPSCFifo<int16_t, 4> fifo;
+			for (int16_t i = 0; i < 4; i++)
+				ASSERT_TRUE(fifo.enqueue(i));
+			ASSERT_FALSE(fifo.enqueue(4));
+			ASSERT_FALSE(fifo.enqueue(5));
+			ASSERT_EQ(fifo.overflows(), 2);
+			ASSERT_EQ(fifo.highWatermark(), 4);
+			ASSERT_EQ(fifo.dequeue(), 0);		// Oldest elements are kept
+
+			fifo.flush();
+			ASSERT_TRUE(fifo.isEmpty());
+			fifo.resetCounters();
+			ASSERT_EQ(fifo.overflows(), 0);
+			ASSERT_EQ(fifo.highWatermark(), 0);
+
+			SPSCFifo<int, 256> bigFifo;		// Needs 16 bit indices
+			for (int i = 0; i < 256; i++)
+				ASSERT_TRUE(bigFifo.enqueue(i));
+			ASSERT_FALSE(bigFifo.enqueue(256));
+			ASSERT_EQ(bigFifo.count(), 256);
+			ASSERT_EQ(bigFifo.dequeue(), 0);
+		}
+
+		TEST_F(Tests, spscFifoThreaded)
+		{
+			SPSCFifo<int, 64> fifo;
+			const int total = 20000;
+			std::thread producer([&fifo, total]() {
+				for (int i = 0; i < total; i++)
+					while (!fifo.enqueue(i)) std::this_thread::yield();
+			});
+
+			int out[16];
+			int expected = 0;
+			while (expected < total)
+			{
+				const uint8_t n = fifo.dequeue(out, 16);
+				if (n == 0) std::this_thread::yield();
+				for (uint8_t i = 0; i < n; i++)
+					ASSERT_EQ(out[i], expected++);
+			}
+			producer.join();
+			ASSERT_TRUE(fifo.isEmpty());
+		}
+
+		// Output of one decoder, bound to it as stream callback
+		struct DecoderSink
+		{
+			std::string out;
+			size_t write(const uint8_t *buf, uint8_t len)
+			{
+				out.append((const char*)buf, len);
+				return len;
+			}
+		};
+
+		static void decodeTrace(const std::vector<int> &pulses, const bool binary, DecoderSink *sink)
+		{
+			SignalDetectorClass dec;
+			dec.MSenabled = dec.MUenabled = dec.MCenabled = true;
+			dec.MredEnabled = true;
+			dec.MbinEnabled = binary;
+			dec.setStreamCallback(fastdelegate::MakeDelegate(sink, &DecoderSink::write));
+			for (size_t i = 0; i < pulses.size(); i += 16)
+				dec.decode(pulses.data() + i, std::min<size_t>(16, pulses.size() - i));
+		}
+
+		TEST_F(Tests, decoderThreads)
+		{
+			// Decoders share no state: every thread decodes its own trace, the output is the same as in a single thread
+			const char *signals[] = {
+				"P0=-3886;P1=481;P2=-1938;P3=-9200;D=13121012101010101010121012101212121212121210101212121012121212101010101212;",
+				"P0=1274;P1=-1037;P2=505;P3=-27698;D=010121012101212121010101010101212121012101210121010101010101012101210121010101010123010101012101210121212101010101010121212101210121012101010101010101210121012101010101012301010101210121012121210101010101012121210121012101210101010101010121012101210;",
+				"P0=-7452;P1=956;P2=-994;P3=-517;P4=463;D=01212121212121212121212121212121342431342431213421212431342431213424313421212121212124313421243134212121212431342121212121243121342431342431342431342121212121212121212431212134212121212431342431213424312134212431213424312134212431;",
+			};
+			const uint8_t threadCnt = 8;
+			std::vector<int> traces[threadCnt];
+			for (uint8_t t = 0; t < threadCnt; t++)
+			{
+				uint32_t rnd = 0x5D1C0DE + t;
+				for (uint16_t b = 0; b < 60; b++)
+				{
+					rnd = rnd * 1103515245 + 12345;
+					std::vector<int16_t> sigdata;
+					ASSERT_TRUE(pulsetrace::parseSigdata(signals[(rnd >> 16) % 3], &sigdata));
+					for (uint8_t r = 0; r < 3; r++)
+					{
+						for (int16_t p : sigdata)
+						{
+							rnd = rnd * 1103515245 + 12345;
+							traces[t].push_back(p + int((rnd >> 16) % 41) * (p < 0 ? 1 : -1) + 20 * (p < 0 ? -1 : 1));
+						}
+					}
+					traces[t].push_back(traces[t].back() < 0 ? maxPulse : -maxPulse);
+				}
+			}
+
+			DecoderSink expected[threadCnt], sinks[threadCnt];
+			for (uint8_t t = 0; t < threadCnt; t++)
+			{
+				decodeTrace(traces[t], t & 1, &expected[t]);
+				ASSERT_FALSE(expected[t].out.empty());
+			}
+
+			std::vector<std::thread> threads;
+			for (uint8_t t = 0; t < threadCnt; t++)
+				threads.emplace_back(decodeTrace, std::cref(traces[t]), t & 1, &sinks[t]);
+			for (std::thread &thread : threads)
+				thread.join();
+
+			for (uint8_t t = 0; t < threadCnt; t++)
+				ASSERT_TRUE(expected[t].out == sinks[t].out) << "thread " << int(t);
+		}
+
+		TEST_F(Tests, decoderCopy)
+		{
+			// A copy goes on with its own buffer and its own manchester decoder, the original is not changed by it
+			std::vector<int16_t> sigdata;
+			ASSERT_TRUE(pulsetrace::parseSigdata("P0=-7452;P1=956;P2=-994;P3=-517;P4=463;D=01212121212121212121212121212121342431342431213421212431342431213424313421212121212124313421243134212121212431342121212121243121342431342431342431342121212121212121212431212134212121212431342431213424312134212431213424312134212431;", &sigdata));
+			std::vector<int> pulses;
+			for (uint8_t r = 0; r < 4; r++)
+				pulses.insert(pulses.end(), sigdata.begin(), sigdata.end());
+			const size_t half = pulses.size() / 2 + 5;
+
+			DecoderSink sink, copySink, assignedSink;
+			SignalDetectorClass dec;
+			dec.MSenabled = dec.MUenabled = dec.MCenabled = true;
+			dec.setStreamCallback(fastdelegate::MakeDelegate(&sink, &DecoderSink::write));
+			dec.decode(pulses.data(), half);
+			ASSERT_EQ(&dec.manchester, dec.mcdecoder);
+			ASSERT_GT(dec.messageLen, 0);
+
+			SignalDetectorClass copy(dec), assigned;
+			assigned = dec;
+			copy.setStreamCallback(fastdelegate::MakeDelegate(&copySink, &DecoderSink::write));
+			assigned.setStreamCallback(fastdelegate::MakeDelegate(&assignedSink, &DecoderSink::write));
+			for (SignalDetectorClass *d : { &copy, &assigned })
+			{
+				ASSERT_EQ(&d->manchester, d->mcdecoder);
+				ASSERT_EQ(d, d->manchester.pdec);
+				ASSERT_EQ(d->buffer, d->first);
+				ASSERT_EQ(&d->pattern[d->message[d->messageLen - 1]], d->last);
+			}
+
+			int gap = -maxPulse;
+			const std::string before = sink.out;
+			copy.decode(pulses.data() + half, pulses.size() - half);
+			copy.decode(&gap);
+			ASSERT_EQ(before, sink.out);
+			assigned.decode(pulses.data() + half, pulses.size() - half);
+			assigned.decode(&gap);
+			dec.decode(pulses.data() + half, pulses.size() - half);
+			dec.decode(&gap);
+
+			const std::string rest = sink.out.substr(before.size());
+			ASSERT_NE(std::string::npos, rest.find("MC;"));
+			ASSERT_EQ(rest, copySink.out);
+			ASSERT_EQ(rest, assignedSink.out);
+		}
+
 	  //--------------------------------------------------------------------------------------------------
 	  /*
 	  TEST_F(Tests, testDigitalPinString)